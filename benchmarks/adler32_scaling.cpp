@@ -0,0 +1,36 @@
+/* throughput of sel::adler32_parallel against the amount of threads.
+* usage: adler32_scaling [megabytes (default 512)]
+* build: g++ -std=c++20 -O2 -pthread -I../source adler32_scaling.cpp ../source/adler32.cpp ../source/shared.cpp */
+#include "adler32.hpp"
+#include "thread_scaling.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    const std::size_t megabytes {argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512u};
+    constexpr int repetitions {5};
+
+    std::vector<std::uint8_t> bytes(megabytes << 20u);
+    std::mt19937_64 random {12345u};
+    for(std::size_t i = 0u; i + 8u <= bytes.size(); i += 8u) {
+        const std::uint64_t value {random()};
+        std::copy_n(reinterpret_cast<const std::uint8_t*>(&value), 8u, bytes.data() + i);
+    }
+
+    const std::uint32_t serial {sel::adler32(bytes)};
+    std::printf("%zu MiB, %u hardware threads\n", megabytes, thread_scaling::thread_counts().back());
+
+    const bool same {thread_scaling::print_thread_scaling(bytes.size(), 0.0, repetitions,
+        [&](const std::uint32_t threads) { return sel::adler32_parallel(bytes, threads); },
+        [&](const std::uint32_t threads, const std::uint32_t result) {
+            if(result != serial) { std::printf("%u threads: the checksum differs from the serial one\n", threads); }
+            return result == serial;
+        })};
+
+    return same ? 0 : 1;
+}
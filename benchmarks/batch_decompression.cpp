@@ -0,0 +1,54 @@
+/* many small independent streams: decompress_deflate on each of them, a reused Decompressor, and
+* decompress_deflate_batch against the amount of threads.
+* usage: batch_decompression [streams (default 10000)] [max kilobytes per stream (default 64)]
+* build: g++ -std=c++20 -O2 -pthread -I../source batch_decompression.cpp ../source/batch.cpp ../source/decompressor.cpp ../source/zlib.cpp ../source/gzip.cpp ../source/compressor.cpp ../source/deflate.cpp ../source/adler32.cpp ../source/crc32.cpp ../source/shared.cpp */
+#include "batch.hpp"
+#include "decompressor.hpp"
+#include "compressor.hpp"
+#include "thread_scaling.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    const std::size_t stream_count {argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000u};
+    const std::size_t max_kilobytes {argc > 2 ? std::max<std::size_t>(std::strtoull(argv[2], nullptr, 10), 1u) : 64u};
+
+    // payloads of 1KB up to the maximum, text-like so that they have dynamic blocks
+    std::mt19937 random {12345u};
+    std::vector<std::vector<std::uint8_t>> streams(stream_count);
+    std::size_t total_size {0u};
+    for(std::vector<std::uint8_t>& stream : streams) {
+        const std::vector<std::uint8_t> data {thread_scaling::make_text_like(1024u + random() % (max_kilobytes * 1024u - 1023u), random)};
+        stream = sel::compress_deflate(data, 6u);
+        total_size += data.size();
+    }
+    const std::vector<std::span<const std::uint8_t>> inputs(streams.begin(), streams.end());
+
+    const double free_function_seconds {thread_scaling::seconds_of([&] {
+        for(const std::span<const std::uint8_t> input : inputs) { static_cast<void>(sel::decompress_deflate(input)); }
+    })};
+    sel::Decompressor decompressor;
+    const double decompressor_seconds {thread_scaling::seconds_of([&] {
+        for(const std::span<const std::uint8_t> input : inputs) { static_cast<void>(decompressor.decompress_deflate(input)); }
+    })};
+
+    std::printf("%zu streams, %zu bytes decompressed\n", stream_count, total_size);
+    std::printf("decompress_deflate on each stream: %.1f MB/s\n", static_cast<double>(total_size) / free_function_seconds / 1e6);
+    std::printf("decompress_deflate_batch against a reused Decompressor (serial)\n");
+
+    const bool succeeded {thread_scaling::print_thread_scaling(total_size, decompressor_seconds, 1,
+        [&](const std::uint32_t threads) { return sel::decompress_deflate_batch(inputs, threads); },
+        [&](const std::uint32_t threads, const sel::Batch_result& result) {
+            const bool failed {result.data.size() != total_size
+                or std::any_of(result.errors.begin(), result.errors.end(), [](const sel::Error error) { return error != sel::Error::none; })};
+            if(failed) { std::printf("%u threads: the batch failed\n", threads); }
+            return not failed;
+        })};
+
+    return succeeded ? 0 : 1;
+}
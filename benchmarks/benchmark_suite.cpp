@@ -0,0 +1,765 @@
+/* the benchmarks of the parts whose speed matters the most: reading bits with Bitstream, decompress_deflate
+* on generated corpora, adler32, crc32, the entropy decoding of JPEGs, the LZW decoding of GIFs, the decoding
+* of PNGs and Input_file. Every result has the throughput, the cycles per byte (the ones of
+* impl::read_cycle_counter) of the best run and the allocations of a run. The data is generated from fixed
+* seeds, and with --json the results are always written with the same keys in the same order, so the files of
+* two releases can be compared.
+* usage: benchmark_suite [--json] [--filter <part of the names to run>] [--megabytes <size of each corpus (default 16)>]
+* build: cmake -S .. -B build && cmake --build build --target benchmark_suite
+*    or: g++ -std=c++20 -O2 -pthread -I../source benchmark_suite.cpp ../source/compressor.cpp ../source/deflate.cpp ../source/adler32.cpp ../source/crc32.cpp ../source/gif.cpp ../source/input_file.cpp ../source/jpeg.cpp ../source/png.cpp ../source/zlib.cpp ../source/shared.cpp */
+#include "adler32.hpp"
+#include "compressor.hpp"
+#include "crc32.hpp"
+#include "deflate.hpp"
+#include "gif.hpp"
+#include "input_file.hpp"
+#include "jpeg.hpp"
+#include "png.hpp"
+#include "statistics.hpp"
+#include "zlib.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    std::atomic<std::uint64_t> allocation_count {0u};
+    std::atomic<std::uint64_t> allocated_bytes {0u};
+}
+
+// every allocation of the program is counted, the library's too
+void* operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1u, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(void* pointer {std::malloc(size == 0u ? 1u : size)}) return pointer;
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+
+namespace {
+    struct Result {
+        std::string name;
+        std::size_t bytes {0u}; // processed by each run
+        double megabytes_per_second {0.0};
+        double cycles_per_byte {0.0};
+        std::uint64_t allocations {0u};
+        std::uint64_t allocated_bytes {0u};
+    };
+
+    // keeps the results of the benchmarks from being optimized away
+    volatile std::uint64_t sink {0u};
+
+    /* runs 'function', which processes 'bytes' bytes, at least min_runs times and for at least min_seconds.
+    * The first run only counts the allocations, the fastest of the others is the result */
+    template<typename Function>
+    Result measure(const std::string& name, const std::size_t bytes, Function&& function)
+    {
+        constexpr std::uint32_t min_runs {5u};
+        constexpr double min_seconds {0.5};
+
+        Result result {name, bytes};
+        const std::uint64_t allocations_before {allocation_count.load()};
+        const std::uint64_t bytes_before {allocated_bytes.load()};
+        function();
+        result.allocations = allocation_count.load() - allocations_before;
+        result.allocated_bytes = allocated_bytes.load() - bytes_before;
+
+        double best_seconds {std::numeric_limits<double>::max()};
+        std::uint64_t best_cycles {0u};
+        double total_seconds {0.0};
+        for(std::uint32_t run = 0u; run < min_runs or total_seconds < min_seconds; ++run) {
+            const auto start {std::chrono::steady_clock::now()};
+            const std::uint64_t start_cycles {sel::impl::read_cycle_counter()};
+            function();
+            const std::uint64_t cycles {sel::impl::read_cycle_counter() - start_cycles};
+            const double seconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+
+            total_seconds += seconds;
+            if(seconds < best_seconds) {
+                best_seconds = seconds;
+                best_cycles = cycles;
+            }
+        }
+
+        result.megabytes_per_second = static_cast<double>(bytes) / best_seconds / 1e6;
+        result.cycles_per_byte = static_cast<double>(best_cycles) / static_cast<double>(bytes);
+        return result;
+    }
+
+    // words of a small vocabulary, the common ones much more often, in lines of sentences
+    std::vector<std::uint8_t> make_text(const std::size_t size, std::mt19937& random)
+    {
+        std::vector<std::string> vocabulary;
+        for(std::size_t i = 0u; i < 2000u; ++i) {
+            std::string word;
+            const std::size_t length {2u + random() % 9u};
+            for(std::size_t j = 0u; j < length; ++j) { word.push_back(static_cast<char>('a' + random() % 26u)); }
+            vocabulary.push_back(std::move(word));
+        }
+
+        std::vector<std::uint8_t> text;
+        text.reserve(size + 16u);
+        std::size_t line {0u};
+        while(text.size() < size) {
+            // the square of a uniform number favors the first words
+            const double uniform {static_cast<double>(random()) / static_cast<double>(std::mt19937::max())};
+            const std::string& word {vocabulary[static_cast<std::size_t>(uniform * uniform * static_cast<double>(vocabulary.size() - 1u))]};
+            text.insert(text.end(), word.begin(), word.end());
+            line += word.size() + 1u;
+            if(random() % 12u == 0u) { text.push_back('.'); }
+            if(line > 70u) {
+                text.push_back('\n');
+                line = 0u;
+            }
+            else { text.push_back(' '); }
+        }
+        text.resize(size);
+        return text;
+    }
+
+    std::vector<std::uint8_t> make_random(const std::size_t size, std::mt19937& random)
+    {
+        std::vector<std::uint8_t> data(size);
+        for(std::uint8_t& byte : data) { byte = static_cast<std::uint8_t>(random()); }
+        return data;
+    }
+
+    // runs of a few values, from one byte to a few hundred
+    std::vector<std::uint8_t> make_rle(const std::size_t size, std::mt19937& random)
+    {
+        std::vector<std::uint8_t> data;
+        data.reserve(size + 300u);
+        while(data.size() < size) {
+            const std::size_t run {random() % 4u == 0u ? 1u + random() % 300u : 1u + random() % 8u};
+            data.insert(data.end(), run, static_cast<std::uint8_t>(random() % 16u));
+        }
+        data.resize(size);
+        return data;
+    }
+
+    // 24 bits RGB rows of smooth gradients with a little noise, like a photograph
+    std::vector<std::uint8_t> make_image(const std::size_t size, std::mt19937& random)
+    {
+        constexpr std::size_t width {1024u};
+        std::vector<std::uint8_t> data(size);
+        for(std::size_t i = 0u; i < size; ++i) {
+            const std::size_t pixel {i / 3u};
+            const double x {static_cast<double>(pixel % width)};
+            const double y {static_cast<double>(pixel / width)};
+            const double channel {static_cast<double>(i % 3u)};
+            const double value {128.0 + 60.0 * std::sin(x / 97.0 + channel) + 50.0 * std::cos(y / 53.0 - channel) + static_cast<double>(random() % 7u)};
+            data[i] = static_cast<std::uint8_t>(std::clamp(value, 0.0, 255.0));
+        }
+        return data;
+    }
+
+    // a stream of 2KB pieces that end at byte boundaries, so there are thousands of blocks with their headers
+    std::vector<std::uint8_t> compress_in_small_blocks(std::span<const std::uint8_t> data)
+    {
+        constexpr std::size_t piece_size {2048u};
+        std::vector<std::uint8_t> compressed;
+        sel::impl::compressor::Bit_writer writer {compressed};
+        for(std::size_t start = 0u; start < data.size(); start += piece_size) {
+            const std::size_t end {std::min(start + piece_size, data.size())};
+            sel::impl::compressor::compress(data.first(end), start, sel::impl::compressor::level_parameters[6], end == data.size(), writer);
+        }
+        writer.flush();
+        return compressed;
+    }
+
+    /* a baseline JPEG, YCbCr 4:2:0, whose quantized coefficients are drawn like the ones of a photograph: a
+    * smooth DC and AC coefficients that get rarer and smaller with their frequency */
+    struct Jpeg_image {
+        std::vector<std::uint8_t> data;
+        // of Y, Cb and Cr, laid out like in Jpeg_component
+        std::array<std::vector<std::int16_t>, 3> coefficients;
+    };
+
+    // the lengths of the codes of the example tables of the standard (Annex K), the common symbols get the short ones
+    constexpr std::array<std::uint8_t, 16> jpeg_dc_code_counts {0u, 1u, 5u, 1u, 1u, 1u, 1u, 1u, 1u, 0u, 0u, 0u, 0u, 0u, 0u, 0u};
+    constexpr std::array<std::uint8_t, 16> jpeg_ac_code_counts {0u, 2u, 1u, 3u, 3u, 2u, 4u, 3u, 5u, 5u, 4u, 4u, 0u, 0u, 1u, 125u};
+
+    // the size of the category of 'value' and its bits, which are the ones of value - 1 for a negative value
+    std::uint32_t jpeg_category(const std::int32_t value, std::uint32_t& bits) noexcept
+    {
+        const std::uint32_t magnitude {static_cast<std::uint32_t>(value < 0 ? -value : value)};
+        const std::uint32_t size {static_cast<std::uint32_t>(std::bit_width(magnitude))};
+        bits = static_cast<std::uint32_t>(value < 0 ? value - 1 : value) & ((1u << size) - 1u);
+        return size;
+    }
+
+    /* calls symbol(ac, symbol, size, bits) for each Huffman coded symbol of the scan and restart(index) at each
+    * restart marker, the DC predictors start again after it */
+    template<typename Symbol, typename Restart>
+    void for_each_jpeg_symbol(const Jpeg_image& image, const std::uint32_t mcus_per_line, const std::uint32_t mcu_count, const std::uint32_t restart_interval,
+        Symbol&& symbol, Restart&& restart)
+    {
+        constexpr std::array<std::uint32_t, 3> sampling {2u, 1u, 1u};
+        std::array<std::int32_t, 3> dc_predictors {};
+        for(std::uint32_t mcu = 0u; mcu < mcu_count; ++mcu) {
+            if(restart_interval != 0u and mcu != 0u and mcu % restart_interval == 0u) {
+                restart(mcu / restart_interval - 1u);
+                dc_predictors = {};
+            }
+
+            for(std::size_t c = 0u; c < 3u; ++c) {
+                for(std::uint32_t y = 0u; y < sampling[c]; ++y) {
+                    for(std::uint32_t x = 0u; x < sampling[c]; ++x) {
+                        const std::size_t block_x {mcu % mcus_per_line * sampling[c] + x};
+                        const std::size_t block_y {mcu / mcus_per_line * sampling[c] + y};
+                        const std::int16_t* block {image.coefficients[c].data() + (block_y * mcus_per_line * sampling[c] + block_x) * 64u};
+
+                        std::uint32_t bits;
+                        const std::uint32_t dc_size {jpeg_category(block[0] - dc_predictors[c], bits)};
+                        symbol(false, dc_size, dc_size, bits);
+                        dc_predictors[c] = block[0];
+
+                        // a run of zeros and the size of the coefficient after them, 0xF0 is 16 zeros and 0x00 the end of the block
+                        std::uint32_t run {0u};
+                        for(std::uint32_t k = 1u; k < 64u; ++k) {
+                            const std::int16_t value {block[sel::impl::jpeg::natural_order[k]]};
+                            if(value == 0) {
+                                ++run;
+                                continue;
+                            }
+                            for(; run >= 16u; run -= 16u) { symbol(true, 0xF0u, 0u, 0u); }
+                            const std::uint32_t size {jpeg_category(value, bits)};
+                            symbol(true, (run << 4u) | size, size, bits);
+                            run = 0u;
+                        }
+                        if(run != 0u) { symbol(true, 0x00u, 0u, 0u); }
+                    }
+                }
+            }
+        }
+    }
+
+    // 'width' and 'height' are multiples of 16, the size of the MCUs
+    Jpeg_image make_jpeg(const std::uint32_t width, const std::uint32_t height, const std::uint32_t restart_interval, std::mt19937& random)
+    {
+        Jpeg_image image;
+        const std::uint32_t mcus_per_line {width / 16u};
+        const std::uint32_t mcu_count {mcus_per_line * (height / 16u)};
+        for(std::size_t c = 0u; c < 3u; ++c) {
+            const std::size_t blocks_per_line {c == 0u ? width / 8u : width / 16u};
+            const std::size_t block_lines {c == 0u ? height / 8u : height / 16u};
+            image.coefficients[c].assign(blocks_per_line * block_lines * 64u, 0);
+            for(std::size_t i = 0u; i < blocks_per_line * block_lines; ++i) {
+                std::int16_t* block {image.coefficients[c].data() + i * 64u};
+                const double x {static_cast<double>(i % blocks_per_line)};
+                const double y {static_cast<double>(i / blocks_per_line)};
+                block[0] = static_cast<std::int16_t>(40.0 * std::sin(x / 23.0 + static_cast<double>(c)) + 30.0 * std::cos(y / 17.0) + static_cast<double>(random() % 5u));
+                for(std::uint32_t k = 1u; k < 64u; ++k) {
+                    const double uniform {static_cast<double>(random()) / static_cast<double>(std::mt19937::max())};
+                    if(uniform > 0.7 * std::exp(-static_cast<double>(k) / 7.0)) continue;
+                    const std::uint32_t magnitude {static_cast<std::uint32_t>(1u + random() % (1u + static_cast<std::uint32_t>(24.0 * std::exp(-static_cast<double>(k) / 5.0))))};
+                    block[sel::impl::jpeg::natural_order[k]] = static_cast<std::int16_t>(random() % 2u == 0u ? magnitude : -static_cast<std::int32_t>(magnitude));
+                }
+            }
+        }
+
+        // the symbols of each table by how often they are used, a first pass counts them
+        std::array<std::vector<std::uint32_t>, 2> frequencies {std::vector<std::uint32_t>(12u), std::vector<std::uint32_t>(256u)};
+        for_each_jpeg_symbol(image, mcus_per_line, mcu_count, restart_interval,
+            [&](const bool ac, const std::uint32_t symbol, std::uint32_t, std::uint32_t) { ++frequencies[ac][symbol]; }, [](std::uint32_t) {});
+        std::array<std::vector<std::uint8_t>, 2> symbols;
+        for(std::uint32_t symbol = 0u; symbol < 12u; ++symbol) { symbols[0].push_back(static_cast<std::uint8_t>(symbol)); }
+        symbols[1] = {0x00u, 0xF0u};
+        for(std::uint32_t run = 0u; run < 16u; ++run) {
+            for(std::uint32_t size = 1u; size <= 10u; ++size) { symbols[1].push_back(static_cast<std::uint8_t>((run << 4u) | size)); }
+        }
+
+        // canonical codes: the ones of each length follow the ones of the previous length, shifted by one bit
+        std::array<std::array<std::uint32_t, 256>, 2> codes {};
+        std::array<std::array<std::uint32_t, 256>, 2> code_lengths {};
+        for(std::size_t ac = 0u; ac < 2u; ++ac) {
+            std::stable_sort(symbols[ac].begin(), symbols[ac].end(), [&](const std::uint8_t a, const std::uint8_t b) { return frequencies[ac][a] > frequencies[ac][b]; });
+            const std::array<std::uint8_t, 16>& counts {ac == 0u ? jpeg_dc_code_counts : jpeg_ac_code_counts};
+            std::uint32_t code {0u};
+            std::size_t index {0u};
+            for(std::uint32_t length = 1u; length <= 16u; ++length, code <<= 1u) {
+                for(std::uint32_t i = 0u; i < counts[length - 1u]; ++i, ++code, ++index) {
+                    codes[ac][symbols[ac][index]] = code;
+                    code_lengths[ac][symbols[ac][index]] = length;
+                }
+            }
+        }
+
+        std::vector<std::uint8_t>& data {image.data};
+        const auto write_segment = [&](const std::uint8_t marker, std::initializer_list<std::span<const std::uint8_t>> parts) {
+            std::size_t length {2u};
+            for(const std::span<const std::uint8_t> part : parts) { length += part.size(); }
+            data.insert(data.end(), {0xFFu, marker, static_cast<std::uint8_t>(length >> 8u), static_cast<std::uint8_t>(length)});
+            for(const std::span<const std::uint8_t> part : parts) { data.insert(data.end(), part.begin(), part.end()); }
+        };
+
+        data = {0xFFu, 0xD8u};
+        std::array<std::uint8_t, 65> quantization_table;
+        quantization_table.fill(8u);
+        quantization_table[0] = 0u;
+        write_segment(0xDBu, {quantization_table});
+        const std::uint8_t frame[] {8u, static_cast<std::uint8_t>(height >> 8u), static_cast<std::uint8_t>(height), static_cast<std::uint8_t>(width >> 8u),
+            static_cast<std::uint8_t>(width), 3u, 1u, 0x22u, 0u, 2u, 0x11u, 0u, 3u, 0x11u, 0u};
+        write_segment(0xC0u, {frame});
+        const std::uint8_t dc_class[] {0x00u};
+        const std::uint8_t ac_class[] {0x10u};
+        write_segment(0xC4u, {dc_class, jpeg_dc_code_counts, symbols[0], ac_class, jpeg_ac_code_counts, symbols[1]});
+        if(restart_interval != 0u) {
+            const std::uint8_t interval[] {static_cast<std::uint8_t>(restart_interval >> 8u), static_cast<std::uint8_t>(restart_interval)};
+            write_segment(0xDDu, {interval});
+        }
+        const std::uint8_t scan[] {3u, 1u, 0x00u, 2u, 0x00u, 3u, 0x00u, 0u, 63u, 0u};
+        write_segment(0xDAu, {scan});
+
+        // the bits are written from the most significant one, a 0xFF byte is followed by a stuffed zero byte
+        std::uint64_t buffer {0u};
+        std::uint32_t buffered_bits {0u};
+        const auto write_bits = [&](const std::uint32_t bits, const std::uint32_t amount) {
+            buffer = (buffer << amount) | bits;
+            buffered_bits += amount;
+            for(; buffered_bits >= 8u; buffered_bits -= 8u) {
+                const std::uint8_t byte {static_cast<std::uint8_t>(buffer >> (buffered_bits - 8u))};
+                data.push_back(byte);
+                if(byte == 0xFFu) { data.push_back(0x00u); }
+            }
+        };
+        // the last byte of an interval is padded with ones
+        const auto pad = [&] { if(buffered_bits != 0u) { write_bits((1u << (8u - buffered_bits)) - 1u, 8u - buffered_bits); } };
+        for_each_jpeg_symbol(image, mcus_per_line, mcu_count, restart_interval,
+            [&](const bool ac, const std::uint32_t symbol, const std::uint32_t size, const std::uint32_t bits) {
+                write_bits(codes[ac][symbol], code_lengths[ac][symbol]);
+                write_bits(bits, size);
+            },
+            [&](const std::uint32_t index) {
+                pad();
+                data.insert(data.end(), {0xFFu, static_cast<std::uint8_t>(0xD0u + index % 8u)});
+            });
+        pad();
+        data.insert(data.end(), {0xFFu, 0xD9u});
+        return image;
+    }
+
+    // frames of 256 colors: bands of flat colors with a little noise, like the graphics that GIFs usually have
+    std::vector<std::vector<std::uint8_t>> make_gif_frames(const std::uint32_t width, const std::uint32_t height, const std::size_t frame_count, std::mt19937& random)
+    {
+        std::vector<std::vector<std::uint8_t>> frames(frame_count);
+        for(std::size_t f = 0u; f < frame_count; ++f) {
+            frames[f].resize(std::size_t {width} * height);
+            for(std::size_t i = 0u; i < frames[f].size(); ++i) {
+                const std::size_t x {i % width + f * 5u};
+                const std::size_t y {i / width};
+                frames[f][i] = static_cast<std::uint8_t>(random() % 10u == 0u ? random() : (x / 17u + y / 13u) % 64u);
+            }
+        }
+        return frames;
+    }
+
+    /* a GIF of the frames, with a global color table of 256 colors. The LZW codes grow and the dictionary is
+    * cleared when it's full at the same points as in the usual encoders */
+    std::vector<std::uint8_t> make_gif(const std::uint32_t width, const std::uint32_t height, const std::vector<std::vector<std::uint8_t>>& frames)
+    {
+        std::vector<std::uint8_t> data;
+        const auto write = [&](std::initializer_list<std::uint32_t> bytes) {
+            for(const std::uint32_t byte : bytes) { data.push_back(static_cast<std::uint8_t>(byte)); }
+        };
+        const auto write_16 = [&](const std::uint32_t value) { write({value, value >> 8u}); };
+
+        write({'G', 'I', 'F', '8', '9', 'a'});
+        write_16(width);
+        write_16(height);
+        // a global color table of 2^(7+1) colors, the background color and the pixel aspect ratio
+        write({0xF7u, 0u, 0u});
+        for(std::uint32_t color = 0u; color < 256u; ++color) { write({color, color * 3u, color * 7u}); }
+
+        constexpr std::uint32_t min_code_size {8u};
+        constexpr std::uint32_t clear_code {1u << min_code_size};
+        // the code of the string of a code followed by a symbol, only valid in the generation in which it was added
+        std::vector<std::uint16_t> children(std::size_t {sel::impl::gif::max_codes} << min_code_size);
+        std::vector<std::uint32_t> child_generations(children.size(), 0u);
+        std::uint32_t generation {0u};
+        for(const std::vector<std::uint8_t>& frame : frames) {
+            write({0x2Cu});
+            write_16(0u);
+            write_16(0u);
+            write_16(width);
+            write_16(height);
+            write({0u, min_code_size});
+
+            // the codes go in sub-blocks of up to 255 bytes, each one after its size
+            std::vector<std::uint8_t> codes;
+            std::uint32_t buffer {0u};
+            std::uint32_t buffered_bits {0u};
+            const auto write_code = [&](const std::uint32_t code, const std::uint32_t size) {
+                buffer |= code << buffered_bits;
+                for(buffered_bits += size; buffered_bits >= 8u; buffered_bits -= 8u, buffer >>= 8u) { codes.push_back(static_cast<std::uint8_t>(buffer)); }
+            };
+
+            ++generation;
+            std::uint32_t code_size {min_code_size + 1u};
+            std::uint32_t last_code {clear_code + 1u};
+            write_code(clear_code, code_size);
+            std::uint32_t prefix {frame[0]};
+            for(std::size_t i = 1u; i < frame.size(); ++i) {
+                const std::size_t child {(std::size_t {prefix} << min_code_size) | frame[i]};
+                if(child_generations[child] == generation) {
+                    prefix = children[child];
+                    continue;
+                }
+
+                write_code(prefix, code_size);
+                children[child] = static_cast<std::uint16_t>(++last_code);
+                child_generations[child] = generation;
+                if(last_code >= (1u << code_size)) { ++code_size; }
+                if(last_code == sel::impl::gif::max_codes - 1u) {
+                    write_code(clear_code, code_size);
+                    ++generation;
+                    code_size = min_code_size + 1u;
+                    last_code = clear_code + 1u;
+                }
+                prefix = frame[i];
+            }
+            write_code(prefix, code_size);
+            write_code(clear_code + 1u, code_size);
+            if(buffered_bits != 0u) { codes.push_back(static_cast<std::uint8_t>(buffer)); }
+
+            for(std::size_t start = 0u; start < codes.size(); start += 255u) {
+                const std::size_t size {std::min<std::size_t>(255u, codes.size() - start)};
+                data.push_back(static_cast<std::uint8_t>(size));
+                data.insert(data.end(), codes.begin() + static_cast<std::ptrdiff_t>(start), codes.begin() + static_cast<std::ptrdiff_t>(start + size));
+            }
+            data.push_back(0u);
+        }
+
+        data.push_back(0x3Bu);
+        return data;
+    }
+
+    struct Png_file {
+        std::vector<std::uint8_t> data;
+        std::vector<std::uint8_t> image_data; // the zlib stream that the IDAT chunks split
+        std::vector<std::uint8_t> pixels;
+    };
+
+    std::uint8_t paeth_predictor(const std::uint8_t a, const std::uint8_t b, const std::uint8_t c)
+    {
+        const int p {a + b - c};
+        const int pa {std::abs(p - a)};
+        const int pb {std::abs(p - b)};
+        const int pc {std::abs(p - c)};
+        return pa <= pb and pa <= pc ? a : pb <= pc ? b : c;
+    }
+
+    /* an 8 bits RGB or RGBA PNG of the rows of make_image. The rows go through the five filters in turn, so each
+    * one is measured, and the image data is split in IDAT chunks of 8KB as libpng does */
+    Png_file make_png(const std::uint32_t width, const std::uint32_t height, const std::uint32_t channels, std::mt19937& random)
+    {
+        Png_file png;
+        const std::size_t row_size {std::size_t {width} * channels};
+        png.pixels = make_image(row_size * height, random);
+
+        std::vector<std::uint8_t> filtered;
+        filtered.reserve((row_size + 1u) * height);
+        const std::vector<std::uint8_t> zeros(row_size);
+        for(std::size_t y = 0u; y < height; ++y) {
+            const std::uint8_t* const row {png.pixels.data() + y * row_size};
+            const std::uint8_t* const previous {y == 0u ? zeros.data() : row - row_size};
+            const std::uint32_t filter {static_cast<std::uint32_t>(y % 5u)};
+            filtered.push_back(static_cast<std::uint8_t>(filter));
+            for(std::size_t i = 0u; i < row_size; ++i) {
+                const std::uint8_t left {i >= channels ? row[i - channels] : std::uint8_t {0u}};
+                const std::uint8_t up_left {i >= channels ? previous[i - channels] : std::uint8_t {0u}};
+                const std::uint8_t prediction {filter == 1u ? left : filter == 2u ? previous[i] : filter == 3u ? static_cast<std::uint8_t>((left + previous[i]) / 2u) :
+                    filter == 4u ? paeth_predictor(left, previous[i], up_left) : std::uint8_t {0u}};
+                filtered.push_back(static_cast<std::uint8_t>(row[i] - prediction));
+            }
+        }
+        png.image_data = sel::compress_zlib(filtered, 6u);
+
+        const auto write_32 = [&](const std::uint32_t value) {
+            for(std::uint32_t shift = 32u; shift != 0u; shift -= 8u) { png.data.push_back(static_cast<std::uint8_t>(value >> (shift - 8u))); }
+        };
+        const auto write_chunk = [&](const char (&type)[5], std::span<const std::uint8_t> chunk_data) {
+            write_32(static_cast<std::uint32_t>(chunk_data.size()));
+            const std::size_t start {png.data.size()};
+            png.data.insert(png.data.end(), type, type + 4);
+            png.data.insert(png.data.end(), chunk_data.begin(), chunk_data.end());
+            write_32(sel::crc32(std::span<const std::uint8_t> {png.data}.subspan(start)));
+        };
+
+        png.data = {137u, 80u, 78u, 71u, 13u, 10u, 26u, 10u};
+        const std::uint8_t header[] {static_cast<std::uint8_t>(width >> 24u), static_cast<std::uint8_t>(width >> 16u), static_cast<std::uint8_t>(width >> 8u),
+            static_cast<std::uint8_t>(width), static_cast<std::uint8_t>(height >> 24u), static_cast<std::uint8_t>(height >> 16u),
+            static_cast<std::uint8_t>(height >> 8u), static_cast<std::uint8_t>(height), 8u, static_cast<std::uint8_t>(channels == 4u ? 6u : 2u), 0u, 0u, 0u};
+        write_chunk("IHDR", header);
+        for(std::size_t start = 0u; start < png.image_data.size(); start += 8192u) {
+            write_chunk("IDAT", std::span<const std::uint8_t> {png.image_data}.subspan(start, std::min<std::size_t>(8192u, png.image_data.size() - start)));
+        }
+        write_chunk("IEND", {});
+        return png;
+    }
+
+    // the way PNGs were decoded before decode_png: the image data inflated at once, then unfiltered in a separate pass
+    std::vector<std::uint8_t> decode_png_whole_buffer(const Png_file& png, const std::uint32_t height, const std::uint32_t channels)
+    {
+        const std::vector<std::uint8_t> filtered {sel::decompress_zlib(png.image_data)};
+        const std::size_t row_size {filtered.size() / height - 1u};
+        const std::vector<std::uint8_t> zeros(row_size);
+        std::vector<std::uint8_t> pixels(row_size * height);
+        for(std::size_t y = 0u; y < height; ++y) {
+            const std::uint8_t* const row {filtered.data() + y * (row_size + 1u)};
+            sel::impl::png::unfilter_row(static_cast<sel::impl::png::Filter>(row[0]), row + 1u, pixels.data() + y * row_size,
+                y == 0u ? zeros.data() : pixels.data() + (y - 1u) * row_size, row_size, channels);
+        }
+        return pixels;
+    }
+
+    // bits in amounts that go through every width that decoders use
+    constexpr std::uint32_t bit_amounts[8] {3u, 7u, 13u, 5u, 9u, 1u, 16u, 11u};
+
+    template<sel::impl::Bitstream_format format>
+    void read_bits(std::span<const std::uint8_t> data)
+    {
+        sel::impl::Bitstream<format> bitstream {data};
+        std::uint64_t sum {0u};
+        std::size_t i {0u};
+        while(bitstream.bits_left() >= 16u) {
+            sum += bitstream.read_bits(bit_amounts[i % 8u]);
+            ++i;
+        }
+        sink = sink + sum;
+    }
+
+    // the way the hot loops read: a refill, then a few peeks and consumes without checks
+    template<sel::impl::Bitstream_format format>
+    void peek_bits(std::span<const std::uint8_t> data)
+    {
+        sel::impl::Bitstream<format> bitstream {data};
+        std::uint64_t sum {0u};
+        std::size_t i {0u};
+        while(bitstream.bits_left() >= 64u) {
+            bitstream.refill();
+            for(std::uint32_t j = 0u; j < 4u; ++j) {
+                const std::uint32_t amount {bit_amounts[i % 8u]};
+                sum += bitstream.peek_bits(amount);
+                bitstream.consume_bits(amount);
+                ++i;
+            }
+        }
+        sink = sink + sum;
+    }
+
+    void print_json(const std::vector<Result>& results)
+    {
+        std::printf("{\n  \"suite\": \"selebits\",\n  \"version\": 1,\n  \"results\": [\n");
+        for(std::size_t i = 0u; i < results.size(); ++i) {
+            const Result& result {results[i]};
+            std::printf("    {\"name\": \"%s\", \"bytes\": %zu, \"megabytes_per_second\": %.3f, \"cycles_per_byte\": %.4f, \"allocations\": %llu, \"allocated_bytes\": %llu}%s\n",
+                result.name.c_str(), result.bytes, result.megabytes_per_second, result.cycles_per_byte, static_cast<unsigned long long>(result.allocations),
+                static_cast<unsigned long long>(result.allocated_bytes), i + 1u < results.size() ? "," : "");
+        }
+        std::printf("  ]\n}\n");
+    }
+
+    void print_table(const std::vector<Result>& results)
+    {
+        std::printf("%-28s %12s %10s %12s %12s %14s\n", "benchmark", "bytes", "MB/s", "cycles/byte", "allocations", "allocated");
+        for(const Result& result : results) {
+            std::printf("%-28s %12zu %10.1f %12.3f %12llu %14llu\n", result.name.c_str(), result.bytes, result.megabytes_per_second, result.cycles_per_byte,
+                static_cast<unsigned long long>(result.allocations), static_cast<unsigned long long>(result.allocated_bytes));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool json {false};
+    std::string filter;
+    std::size_t megabytes {16u};
+    for(int i = 1; i < argc; ++i) {
+        if(std::strcmp(argv[i], "--json") == 0) { json = true; }
+        else if(std::strcmp(argv[i], "--filter") == 0 and i + 1 < argc) { filter = argv[++i]; }
+        else if(std::strcmp(argv[i], "--megabytes") == 0 and i + 1 < argc) { megabytes = std::strtoull(argv[++i], nullptr, 10); }
+        else {
+            std::fprintf(stderr, "usage: benchmark_suite [--json] [--filter <part of the names to run>] [--megabytes <size of each corpus>]\n");
+            return 1;
+        }
+    }
+    const std::size_t size {megabytes << 20u};
+    const auto selected = [&](const std::string& name) { return filter.empty() or name.find(filter) != std::string::npos; };
+
+    std::vector<Result> results;
+    std::mt19937 random {12345u};
+    const std::vector<std::uint8_t> random_data {make_random(size, random)};
+
+    using sel::impl::Bitstream_format;
+    if(selected("bitstream/gif/read_bits")) { results.push_back(measure("bitstream/gif/read_bits", size, [&] { read_bits<Bitstream_format::gif>(random_data); })); }
+    if(selected("bitstream/gif/peek_bits")) { results.push_back(measure("bitstream/gif/peek_bits", size, [&] { peek_bits<Bitstream_format::gif>(random_data); })); }
+    if(selected("bitstream/jpg/read_bits")) { results.push_back(measure("bitstream/jpg/read_bits", size, [&] { read_bits<Bitstream_format::jpg>(random_data); })); }
+    if(selected("bitstream/jpg/peek_bits")) { results.push_back(measure("bitstream/jpg/peek_bits", size, [&] { peek_bits<Bitstream_format::jpg>(random_data); })); }
+
+    // the corpora are only generated and compressed if one of their benchmarks runs
+    struct Corpus {
+        const char* name;
+        std::vector<std::uint8_t> (*make)(const std::size_t, std::mt19937&);
+        bool small_blocks;
+    };
+    const Corpus corpora[] {
+        {"text", make_text, false},
+        {"random", make_random, false},
+        {"rle", make_rle, false},
+        {"image", make_image, false},
+        {"small_blocks", make_text, true}
+    };
+    for(const Corpus& corpus : corpora) {
+        const std::string name {std::string {"inflate/"} + corpus.name};
+        if(not selected(name)) continue;
+
+        std::mt19937 corpus_random {12345u};
+        const std::vector<std::uint8_t> data {corpus.make(size, corpus_random)};
+        const std::vector<std::uint8_t> compressed {corpus.small_blocks ? compress_in_small_blocks(data) : sel::compress_deflate(data, 6u)};
+        if(sel::decompress_deflate(compressed) != data) {
+            std::fprintf(stderr, "%s doesn't decompress to its data\n", name.c_str());
+            return 1;
+        }
+        results.push_back(measure(name, data.size(), [&] { sink = sink + sel::decompress_deflate(compressed).size(); }));
+    }
+
+    /* the entropy decoding of a JPEG with a pixel per byte of the corpora, the throughput is the one of the JPEG
+    * data. With restart markers, the intervals can also be decoded by all the hardware threads */
+    struct Jpeg_case {
+        const char* name;
+        std::uint32_t restart_interval; // in MCUs
+        std::uint32_t threads;
+    };
+    const Jpeg_case jpeg_cases[] {
+        {"jpeg/baseline", 0u, 1u},
+        {"jpeg/restarts", 16u, 1u},
+        {"jpeg/restarts/all_threads", 16u, 0u}
+    };
+    for(const Jpeg_case& jpeg_case : jpeg_cases) {
+        if(not selected(jpeg_case.name)) continue;
+
+        constexpr std::uint32_t width {4096u};
+        const std::uint32_t height {static_cast<std::uint32_t>(std::max<std::size_t>(16u, size / width / 16u * 16u))};
+        std::mt19937 jpeg_random {12345u};
+        const Jpeg_image image {make_jpeg(width, height, jpeg_case.restart_interval, jpeg_random)};
+        const sel::Jpeg_coefficients coefficients {sel::decode_jpeg_coefficients(image.data, jpeg_case.threads)};
+        for(std::size_t c = 0u; c < 3u; ++c) {
+            if(coefficients.components[c].coefficients != image.coefficients[c]) {
+                std::fprintf(stderr, "%s doesn't decode to its coefficients\n", jpeg_case.name);
+                return 1;
+            }
+        }
+        results.push_back(measure(jpeg_case.name, image.data.size(), [&] {
+            sink = sink + sel::decode_jpeg_coefficients(image.data, jpeg_case.threads).components.size();
+        }));
+    }
+
+    // the LZW decoding of a GIF of 8 frames with a pixel per byte of the corpora, the frames can be decoded by all the hardware threads
+    for(const std::uint32_t threads : {1u, 0u}) {
+        const std::string name {threads == 1u ? "gif/frames" : "gif/frames/all_threads"};
+        if(not selected(name)) continue;
+
+        constexpr std::uint32_t width {2048u};
+        constexpr std::size_t frame_count {8u};
+        const std::uint32_t height {static_cast<std::uint32_t>(std::clamp<std::size_t>(size / width / frame_count, 1u, 65535u))};
+        std::mt19937 gif_random {12345u};
+        const std::vector<std::vector<std::uint8_t>> frames {make_gif_frames(width, height, frame_count, gif_random)};
+        const std::vector<std::uint8_t> gif {make_gif(width, height, frames)};
+        const sel::Gif_image image {sel::decode_gif(gif, threads)};
+        if(not std::equal(image.frames.begin(), image.frames.end(), frames.begin(), frames.end(), [](const sel::Gif_frame& a, const std::vector<std::uint8_t>& b) { return a.indices == b; })) {
+            std::fprintf(stderr, "%s doesn't decode to its frames\n", name.c_str());
+            return 1;
+        }
+        results.push_back(measure(name, gif.size(), [&] { sink = sink + sel::decode_gif(gif, threads).frames.size(); }));
+    }
+
+    /* the decoding of a PNG with a pixel byte per byte of the corpora, the throughput is the one of the pixels. The
+    * whole buffer case is the same image decoded the way it was before decode_png, for comparison */
+    struct Png_case {
+        const char* name;
+        std::uint32_t channels;
+        bool whole_buffer;
+    };
+    const Png_case png_cases[] {
+        {"png/rgb", 3u, false},
+        {"png/rgba", 4u, false},
+        {"png/rgb/whole_buffer", 3u, true}
+    };
+    for(const Png_case& png_case : png_cases) {
+        if(not selected(png_case.name)) continue;
+
+        constexpr std::uint32_t width {1024u};
+        const std::uint32_t height {static_cast<std::uint32_t>(std::max<std::size_t>(1u, size / width / png_case.channels))};
+        std::mt19937 png_random {12345u};
+        const Png_file png {make_png(width, height, png_case.channels, png_random)};
+        const std::vector<std::uint8_t> pixels {png_case.whole_buffer ? decode_png_whole_buffer(png, height, png_case.channels) : sel::decode_png(png.data).pixels};
+        if(pixels != png.pixels) {
+            std::fprintf(stderr, "%s doesn't decode to its pixels\n", png_case.name);
+            return 1;
+        }
+        results.push_back(measure(png_case.name, png.pixels.size(), [&] {
+            sink = sink + (png_case.whole_buffer ? decode_png_whole_buffer(png, height, png_case.channels) : sel::decode_png(png.data).pixels).size();
+        }));
+    }
+
+    /* opening a file of the size of the corpora with Input_file and going through it once with crc32, mapped and
+    * read into a buffer. The file was just written, so it's in the page cache: this is the cost of the mapping
+    * and its page faults against the one of the copy */
+    for(const sel::Input_mode mode : {sel::Input_mode::map, sel::Input_mode::read}) {
+        const std::string name {mode == sel::Input_mode::map ? "input_file/map" : "input_file/read"};
+        if(not selected(name)) continue;
+
+        const std::filesystem::path path {std::filesystem::temp_directory_path() / "selebits_benchmark_input"};
+        {
+            std::ofstream file {path, std::ios::binary};
+            file.write(reinterpret_cast<const char*>(random_data.data()), static_cast<std::streamsize>(random_data.size()));
+            if(not file) {
+                std::fprintf(stderr, "%s can't write %s\n", name.c_str(), path.string().c_str());
+                return 1;
+            }
+        }
+        if(sel::crc32(sel::Input_file {path, mode}) != sel::crc32(random_data)) {
+            std::fprintf(stderr, "%s doesn't read the file that was written\n", name.c_str());
+            return 1;
+        }
+        results.push_back(measure(name, size, [&] { sink = sink + sel::crc32(sel::Input_file {path, mode}); }));
+        std::filesystem::remove(path);
+    }
+
+    if(selected("adler32/large")) { results.push_back(measure("adler32/large", size, [&] { sink = sink + sel::adler32(random_data); })); }
+    if(selected("adler32/4KB")) {
+        results.push_back(measure("adler32/4KB", size, [&] {
+            for(std::size_t start = 0u; start < random_data.size(); start += 4096u) {
+                sink = sink + sel::adler32(std::span<const std::uint8_t> {random_data}.subspan(start, std::min<std::size_t>(4096u, random_data.size() - start)));
+            }
+        }));
+    }
+    if(selected("crc32/large")) { results.push_back(measure("crc32/large", size, [&] { sink = sink + sel::crc32(random_data); })); }
+    if(selected("crc32/4KB")) {
+        results.push_back(measure("crc32/4KB", size, [&] {
+            for(std::size_t start = 0u; start < random_data.size(); start += 4096u) {
+                sink = sink + sel::crc32(std::span<const std::uint8_t> {random_data}.subspan(start, std::min<std::size_t>(4096u, random_data.size() - start)));
+            }
+        }));
+    }
+
+    if(json) { print_json(results); }
+    else { print_table(results); }
+    return 0;
+}
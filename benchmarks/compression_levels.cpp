@@ -0,0 +1,91 @@
+/* compression ratio and throughput of sel::compress_deflate at every level, and the throughput of
+* decompressing what each level produces.
+* usage: compression_levels [file (default: 16 MiB of generated text-like data)]
+* build: g++ -std=c++20 -O2 -pthread -I../source compression_levels.cpp ../source/compressor.cpp ../source/deflate.cpp ../source/adler32.cpp ../source/shared.cpp */
+#include "compressor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace {
+    // words from a small vocabulary with a skewed distribution, numbers and punctuation, like logs or text
+    std::vector<std::uint8_t> generate_data(const std::size_t size)
+    {
+        constexpr const char* words[] {
+            "the", "of", "and", "to", "in", "is", "that", "for", "it", "as", "was", "with", "be", "by", "on",
+            "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+            "you", "were", "their", "one", "all", "we", "can", "her", "has", "there", "been", "if", "more",
+            "compression", "decompression", "window", "block", "symbol", "literal", "distance", "length"
+        };
+        constexpr std::size_t word_count {std::size(words)};
+
+        std::mt19937 random {12345u};
+        std::geometric_distribution<std::size_t> word_distribution {0.08};
+        std::vector<std::uint8_t> data;
+        data.reserve(size + 64u);
+        while(data.size() < size) {
+            const char* word {words[std::min(word_distribution(random), word_count - 1u)]};
+            data.insert(data.end(), word, word + std::char_traits<char>::length(word));
+
+            const std::uint32_t next {static_cast<std::uint32_t>(random() % 32u)};
+            if(next == 0u) { data.push_back('\n'); }
+            else if(next == 1u) {
+                const std::string number {std::to_string(random() % 100000u)};
+                data.push_back(' ');
+                data.insert(data.end(), number.begin(), number.end());
+                data.push_back(',');
+                data.push_back(' ');
+            }
+            else { data.push_back(' '); }
+        }
+        data.resize(size);
+        return data;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::uint8_t> data;
+    if(argc > 1) {
+        std::ifstream file {argv[1], std::ios::binary};
+        if(not file) {
+            std::printf("can't open %s\n", argv[1]);
+            return 1;
+        }
+        data.assign(std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {});
+    }
+    else { data = generate_data(16u << 20u); }
+
+    std::printf("%zu bytes\n", data.size());
+    std::printf("%6s %12s %8s %14s %16s\n", "level", "compressed", "ratio", "compress MB/s", "decompress MB/s");
+    for(std::uint32_t level = 0u; level <= sel::impl::compressor::max_level; ++level) {
+        const auto compress_start {std::chrono::steady_clock::now()};
+        const std::vector<std::uint8_t> compressed_data {sel::compress_deflate(data, level)};
+        const double compress_seconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - compress_start).count()};
+
+        // the fastest of a few runs, decompression is much faster than compression
+        double decompress_seconds {1e30};
+        std::vector<std::uint8_t> decompressed_data(data.size());
+        for(int i = 0; i < 3; ++i) {
+            const auto decompress_start {std::chrono::steady_clock::now()};
+            const std::size_t size {sel::decompress_deflate(compressed_data, decompressed_data)};
+            decompress_seconds = std::min(decompress_seconds, std::chrono::duration<double>(std::chrono::steady_clock::now() - decompress_start).count());
+
+            if(size != data.size() or not std::equal(data.begin(), data.end(), decompressed_data.begin())) {
+                std::printf("level %u: the decompressed data differs from the original\n", level);
+                return 1;
+            }
+        }
+
+        std::printf("%6u %12zu %7.2f%% %14.1f %16.1f\n", level, compressed_data.size(),
+            100.0 * static_cast<double>(compressed_data.size()) / static_cast<double>(std::max<std::size_t>(data.size(), 1u)),
+            static_cast<double>(data.size()) / compress_seconds / 1e6, static_cast<double>(data.size()) / decompress_seconds / 1e6);
+    }
+
+    return 0;
+}
@@ -0,0 +1,36 @@
+/* throughput of sel::compress_deflate_parallel against the amount of threads, and the size of the output
+* against the one of the single-threaded compress_deflate.
+* usage: compression_scaling [level (default 6)] [megabytes (default 64)]
+* build: g++ -std=c++20 -O2 -pthread -I../source compression_scaling.cpp ../source/compressor.cpp ../source/deflate.cpp ../source/adler32.cpp ../source/shared.cpp */
+#include "compressor.hpp"
+#include "thread_scaling.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    const std::uint32_t level {argc > 1 ? static_cast<std::uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 6u};
+    const std::size_t megabytes {argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 64u};
+
+    std::mt19937 random {12345u};
+    const std::vector<std::uint8_t> data {thread_scaling::make_text_like(megabytes << 20u, random)};
+
+    std::size_t serial_size {0u};
+    const double serial_seconds {thread_scaling::seconds_of([&] { serial_size = sel::compress_deflate(data, level).size(); })};
+    std::printf("%zu MiB, level %u, %u hardware threads\n", megabytes, level, thread_scaling::thread_counts().back());
+
+    // the chunks don't depend on the amount of threads, so neither does the output
+    std::size_t parallel_size {0u};
+    thread_scaling::print_thread_scaling(data.size(), serial_seconds, 1,
+        [&](const std::uint32_t threads) { return sel::compress_deflate_parallel(data, level, threads).size(); },
+        [&](std::uint32_t, const std::size_t size) {
+            parallel_size = size;
+            return true;
+        });
+    std::printf("%zu bytes serial, %zu bytes parallel\n", serial_size, parallel_size);
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/* the cost of rejecting corrupt deflate streams with sel::decompress_deflate (which throws) against
+* sel::try_decompress_deflate (which returns the error), and of decompressing the intact streams with both.
+* usage: corrupt_input [streams (default 100000)] [stream size (default 4096)]
+* build: g++ -std=c++20 -O2 -I../source corrupt_input.cpp ../source/compressor.cpp ../source/deflate.cpp ../source/adler32.cpp ../source/shared.cpp */
+#include "compressor.hpp"
+#include "deflate.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    const std::size_t stream_count {argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000u};
+    const std::size_t stream_size {argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 4096u};
+
+    // a few distinct streams, each corrupted by flipping one bit or by cutting it short
+    std::mt19937 random {12345u};
+    std::vector<std::vector<std::uint8_t>> intact;
+    std::vector<std::vector<std::uint8_t>> corrupt;
+    for(std::size_t i = 0u; i < 64u; ++i) {
+        std::vector<std::uint8_t> data(stream_size);
+        for(std::size_t j = 0u; j < data.size(); ++j) {
+            if(j > 64u and random() % 4u != 0u) { data[j] = data[j - 1u - random() % 48u]; }
+            else { data[j] = static_cast<std::uint8_t>('a' + random() % 20u); }
+        }
+        intact.push_back(sel::compress_deflate(data, 6u));
+
+        std::vector<std::uint8_t> bad {intact.back()};
+        if(i % 2u == 0u) { bad.resize(bad.size() / 2u); }
+        else { bad[random() % bad.size()] ^= static_cast<std::uint8_t>(1u << (random() % 8u)); }
+        corrupt.push_back(std::move(bad));
+    }
+
+    std::vector<std::uint8_t> output(stream_size * 2u);
+    const auto measure = [&](const std::vector<std::vector<std::uint8_t>>& streams, const bool throwing) {
+        std::size_t failures {0u};
+        const auto start {std::chrono::steady_clock::now()};
+        for(std::size_t i = 0u; i < stream_count; ++i) {
+            const std::vector<std::uint8_t>& stream {streams[i % streams.size()]};
+            if(throwing) {
+                try { sel::decompress_deflate(stream, output); }
+                catch(const sel::Exception&) { ++failures; }
+            }
+            else if(not sel::try_decompress_deflate(stream, output)) { ++failures; }
+        }
+        const double seconds {std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count()};
+        std::printf("%8s %10s %12.0f %10zu\n", streams.data() == intact.data() ? "intact" : "corrupt", throwing ? "throwing" : "expected",
+            static_cast<double>(stream_count) / seconds, failures);
+    };
+
+    std::printf("%zu streams of %zu bytes\n", stream_count, stream_size);
+    std::printf("%8s %10s %12s %10s\n", "input", "api", "streams/s", "failures");
+    measure(intact, true);
+    measure(intact, false);
+    measure(corrupt, true);
+    measure(corrupt, false);
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+/* throughput of sel::decompress_deflate_parallel against the amount of threads, compared with the
+* single-threaded decompress_deflate on the same stream.
+* usage: decompression_scaling [megabytes (default 256)] [level (default 6)]
+* build: g++ -std=c++20 -O2 -pthread -I../source decompression_scaling.cpp ../source/parallel_inflate.cpp ../source/compressor.cpp ../source/deflate.cpp ../source/adler32.cpp ../source/shared.cpp */
+#include "parallel_inflate.hpp"
+#include "compressor.hpp"
+#include "thread_scaling.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    const std::size_t megabytes {argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 256u};
+    const std::uint32_t level {argc > 2 ? static_cast<std::uint32_t>(std::strtoul(argv[2], nullptr, 10)) : 6u};
+
+    std::mt19937 random {12345u};
+    const std::vector<std::uint8_t> data {thread_scaling::make_text_like(megabytes << 20u, random)};
+    /* compressed by a single thread: the output of compress_deflate_parallel has an empty stored block at every
+    * chunk boundary, which the search for block headers would find right away */
+    const std::vector<std::uint8_t> compressed_data {sel::compress_deflate(data, level)};
+
+    std::vector<std::uint8_t> serial_data;
+    const double serial_seconds {thread_scaling::seconds_of([&] { serial_data = sel::decompress_deflate(compressed_data, data.size()); })};
+    std::printf("%zu MiB (%zu compressed), level %u, %u hardware threads\n", megabytes, compressed_data.size(), level, thread_scaling::thread_counts().back());
+
+    const bool same {thread_scaling::print_thread_scaling(data.size(), serial_seconds, 1,
+        [&](const std::uint32_t threads) { return sel::decompress_deflate_parallel(compressed_data, threads); },
+        [&](const std::uint32_t threads, const std::vector<std::uint8_t>& parallel_data) {
+            if(parallel_data != serial_data) { std::printf("%u threads: the output differs from decompress_deflate\n", threads); }
+            return parallel_data == serial_data;
+        })};
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+/* the statistics of decompressing a raw deflate stream with sel::decompress_deflate: its blocks, its symbols
+* and where the time goes, to find out why a stream decompresses slowly.
+* usage: inflate_statistics <file with a raw deflate stream>
+* build: g++ -std=c++20 -O2 -I../source inflate_statistics.cpp ../source/deflate.cpp ../source/shared.cpp */
+#include "deflate.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    if(argc < 2) {
+        std::fprintf(stderr, "usage: inflate_statistics <file with a raw deflate stream>\n");
+        return 1;
+    }
+
+    std::ifstream file {argv[1], std::ios::binary};
+    const std::vector<std::uint8_t> data {std::istreambuf_iterator<char> {file}, std::istreambuf_iterator<char> {}};
+
+    sel::Inflate_statistics statistics;
+    try {
+        sel::decompress_deflate(data, statistics);
+    }
+    catch(const sel::Exception&) {
+        std::printf("the stream is malformed, these are the statistics up to the error\n");
+    }
+
+    const auto print_blocks = [](const char* name, const sel::Inflate_statistics::Blocks& blocks) {
+        std::printf("%8s %10llu %14llu %14llu\n", name, static_cast<unsigned long long>(blocks.count),
+            static_cast<unsigned long long>(blocks.compressed_bits / 8u), static_cast<unsigned long long>(blocks.decompressed_bytes));
+    };
+    std::printf("%8s %10s %14s %14s\n", "blocks", "count", "compressed", "decompressed");
+    print_blocks("stored", statistics.stored_blocks);
+    print_blocks("fixed", statistics.fixed_blocks);
+    print_blocks("dynamic", statistics.dynamic_blocks);
+
+    const double matches {static_cast<double>(statistics.matches)};
+    std::printf("\n%llu literals, %llu matches of %.1f bytes on average\n", static_cast<unsigned long long>(statistics.literals),
+        static_cast<unsigned long long>(statistics.matches), matches == 0.0 ? 0.0 : static_cast<double>(statistics.match_bytes) / matches);
+    std::printf("%8s %10s %10s\n", "symbol", "lengths", "distances");
+    for(std::size_t i = 0u; i < statistics.distance_histogram.size(); ++i) {
+        const unsigned long long lengths {i < statistics.length_histogram.size() ? static_cast<unsigned long long>(statistics.length_histogram[i]) : 0ull};
+        std::printf("%8zu %10llu %10llu\n", i, lengths, static_cast<unsigned long long>(statistics.distance_histogram[i]));
+    }
+
+    const auto print_cycles = [&](const char* name, const std::uint64_t cycles) {
+        const double total {static_cast<double>(statistics.total_cycles)};
+        std::printf("%16s %14llu %6.1f%%\n", name, static_cast<unsigned long long>(cycles), total == 0.0 ? 0.0 : static_cast<double>(cycles) / total * 100.0);
+    };
+    std::printf("\n%16s %14s\n", "", "cycles");
+    print_cycles("table building", statistics.table_building_cycles);
+    print_cycles("decoding", statistics.decoding_cycles);
+    print_cycles("copying", statistics.copying_cycles);
+    print_cycles("total", statistics.total_cycles);
+    std::printf("\n%zu bytes to %zu bytes in %.3f ms, %.3f bytes per cycle, %.1f MB/s\n", statistics.compressed_bytes, statistics.decompressed_bytes,
+        static_cast<double>(statistics.nanoseconds) / 1e6, statistics.bytes_per_cycle(),
+        statistics.nanoseconds == 0u ? 0.0 : static_cast<double>(statistics.decompressed_bytes) / static_cast<double>(statistics.nanoseconds) * 1e3);
+
+    return 0;
+}
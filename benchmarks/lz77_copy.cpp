@@ -0,0 +1,126 @@
+/* compares sel::impl::deflate::lz77_copy with the byte by byte copy into a std::vector that it replaced,
+* across distributions of distances and lengths.
+* build: g++ -std=c++20 -O2 -I../source lz77_copy.cpp ../source/deflate.cpp ../source/shared.cpp */
+#include "deflate.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+    struct Match {
+        std::uint32_t length;
+        std::uint32_t distance;
+    };
+
+    struct Distribution {
+        const char* name;
+        std::uint32_t min_distance;
+        std::uint32_t max_distance;
+        std::uint32_t min_length;
+        std::uint32_t max_length;
+    };
+
+    constexpr std::size_t history_size {32768u};
+    constexpr std::size_t matches_per_run {1u << 16u};
+
+    // the lz77_copy of the previous versions of the library
+    void vector_lz77_copy(std::vector<std::uint8_t>& inflated_data, const std::uint32_t length, const std::uint32_t distance)
+    {
+        const std::size_t beginning_of_copy {inflated_data.size() - distance};
+        std::size_t copy_from {beginning_of_copy};
+
+        inflated_data.reserve(inflated_data.size() + length);
+        for(std::uint32_t i = 0u; i < length; ++i) {
+            const std::uint8_t value_to_copy {inflated_data[copy_from]};
+            inflated_data.push_back(value_to_copy);
+            ++copy_from;
+            if(copy_from == inflated_data.size()) {
+                copy_from = beginning_of_copy;
+            }
+        }
+    }
+
+    std::vector<Match> make_matches(const Distribution& distribution, std::mt19937& random)
+    {
+        std::uniform_int_distribution<std::uint32_t> distances {distribution.min_distance, distribution.max_distance};
+        std::uniform_int_distribution<std::uint32_t> lengths {distribution.min_length, distribution.max_length};
+
+        std::vector<Match> matches(matches_per_run);
+        for(Match& match : matches) {
+            match.distance = distances(random);
+            match.length = lengths(random);
+        }
+
+        return matches;
+    }
+
+    template<typename Function>
+    double seconds_of(Function&& function)
+    {
+        const auto start {std::chrono::steady_clock::now()};
+        function();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main()
+{
+    constexpr Distribution distributions[] {
+        {"rle (distance 1)", 1u, 1u, 3u, 258u},
+        {"distance 2", 2u, 2u, 3u, 258u},
+        {"distance 3", 3u, 3u, 3u, 258u},
+        {"distance 4", 4u, 4u, 3u, 258u},
+        {"distance 5~7", 5u, 7u, 3u, 258u},
+        {"distance 8~31", 8u, 31u, 3u, 258u},
+        {"distance 32~258", 32u, 258u, 3u, 258u},
+        {"far, short", 259u, 32768u, 3u, 16u},
+        {"far, long", 259u, 32768u, 64u, 258u},
+        {"anything", 1u, 32768u, 3u, 258u}
+    };
+    constexpr int repetitions {5};
+
+    std::mt19937 random {12345u};
+    std::vector<std::uint8_t> history(history_size);
+    for(std::uint8_t& byte : history) { byte = static_cast<std::uint8_t>(random()); }
+
+    std::printf("%-20s %14s %14s %8s\n", "distribution", "vector MB/s", "wide MB/s", "speedup");
+    for(const Distribution& distribution : distributions) {
+        const std::vector<Match> matches {make_matches(distribution, random)};
+        std::size_t total_length {0u};
+        for(const Match& match : matches) { total_length += match.length; }
+
+        double vector_seconds {1e30};
+        double wide_seconds {1e30};
+        for(int i = 0; i < repetitions; ++i) {
+            // reserved up front, otherwise the exact-size reserve of the old function reallocates on every call
+            std::vector<std::uint8_t> inflated_data(history);
+            inflated_data.reserve(history_size + total_length);
+            vector_seconds = std::min(vector_seconds, seconds_of([&] {
+                for(const Match& match : matches) { vector_lz77_copy(inflated_data, match.length, match.distance); }
+            }));
+
+            std::vector<std::uint8_t> output(history_size + total_length + sel::impl::deflate::max_lz77_copy_overrun);
+            std::copy(history.begin(), history.end(), output.begin());
+            wide_seconds = std::min(wide_seconds, seconds_of([&] {
+                std::uint8_t* position {output.data() + history_size};
+                for(const Match& match : matches) {
+                    sel::impl::deflate::lz77_copy(position, match.length, match.distance);
+                    position += match.length;
+                }
+            }));
+
+            if(not std::equal(inflated_data.begin(), inflated_data.end(), output.begin())) {
+                std::printf("%s: the outputs differ\n", distribution.name);
+                return 1;
+            }
+        }
+
+        const double megabytes {static_cast<double>(total_length) / 1e6};
+        std::printf("%-20s %14.1f %14.1f %7.2fx\n", distribution.name,
+            megabytes / vector_seconds, megabytes / wide_seconds, vector_seconds / wide_seconds);
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+/* what the benchmarks that compare amounts of threads share: the data they compress, the amounts of
+* threads they try, the timing and the table they print */
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace thread_scaling {
+    // literals from a small alphabet and short copies of recent data, compresses to about 60%
+    inline std::vector<std::uint8_t> make_text_like(const std::size_t size, std::mt19937& random)
+    {
+        std::vector<std::uint8_t> data(size);
+        for(std::size_t i = 0u; i < data.size(); ++i) {
+            if(i > 64u and random() % 4u != 0u) { data[i] = data[i - 1u - random() % 48u]; }
+            else { data[i] = static_cast<std::uint8_t>('a' + random() % 20u); }
+        }
+        return data;
+    }
+
+    // powers of two, and the amount of hardware threads
+    inline std::vector<std::uint32_t> thread_counts()
+    {
+        const std::uint32_t max_threads {std::max(1u, std::thread::hardware_concurrency())};
+        std::vector<std::uint32_t> counts;
+        for(std::uint32_t threads = 1u; threads < max_threads; threads *= 2u) { counts.push_back(threads); }
+        counts.push_back(max_threads);
+        return counts;
+    }
+
+    // the time of one call of function, in seconds
+    template<typename Function>
+    double seconds_of(Function&& function)
+    {
+        const auto start {std::chrono::steady_clock::now()};
+        function();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* prints, for each of thread_counts(), the throughput of the fastest of 'runs' calls of run(threads) on
+    * 'bytes' bytes and its speedup over 'serial_seconds', or over one thread if it's zero. check(threads,
+    * result) gets what each call returned, out of the timing, and a false from it ends the sweep with false */
+    template<typename Run, typename Check>
+    bool print_thread_scaling(const std::size_t bytes, double serial_seconds, const int runs, Run&& run, Check&& check)
+    {
+        std::printf("%8s %10s %8s\n", "threads", "MB/s", "speedup");
+        if(serial_seconds != 0.0) { std::printf("%8s %10.1f\n", "serial", static_cast<double>(bytes) / serial_seconds / 1e6); }
+
+        for(const std::uint32_t threads : thread_counts()) {
+            double seconds {1e30};
+            for(int i = 0; i < runs; ++i) {
+                std::invoke_result_t<Run&, std::uint32_t> result {};
+                seconds = std::min(seconds, seconds_of([&] { result = run(threads); }));
+                if(not check(threads, result)) return false;
+            }
+
+            if(serial_seconds == 0.0) { serial_seconds = seconds; }
+            std::printf("%8u %10.1f %7.2fx\n", threads, static_cast<double>(bytes) / seconds / 1e6, serial_seconds / seconds);
+        }
+
+        return true;
+    }
+}
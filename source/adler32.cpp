@@ -1,14 +1,189 @@
 #include "adler32.hpp"
+#include "shared.hpp"
+#include "threads.hpp"
 
-std::uint32_t sel::adler32(std::span<const std::uint8_t> bytes)
+#include <vector>
+
+#ifdef SELEBITS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr std::uint32_t adler_modulus {65521u};
+    // the most bytes that can be added before the sums could overflow 32 bits
+    constexpr std::size_t nmax {5552u};
+    // below this, a thread costs more than what it saves
+    constexpr std::size_t min_bytes_per_thread {1u << 20u};
+
+    std::uint32_t adler32_scalar(std::uint32_t sum1, std::uint32_t sum2, std::span<const std::uint8_t> bytes)
+    {
+        while(not bytes.empty()) {
+            const std::size_t amount {std::min(bytes.size(), nmax)};
+            for(std::size_t i = 0u; i < amount; ++i) {
+                sum1 += bytes[i];
+                sum2 += sum1;
+            }
+            sum1 %= adler_modulus;
+            sum2 %= adler_modulus;
+            bytes = bytes.subspan(amount);
+        }
+
+        return (sum2 << 16u) | sum1;
+    }
+
+#ifdef SELEBITS_X86
+    /* each byte of a chunk is added to sum2 as many times as there are bytes from it to the end of the chunk
+    * (the taps), and sum1 is added to sum2 once per byte of the chunk. Within nmax bytes the lanes can't
+    * overflow, so the modulo is only done every nmax bytes */
+    SELEBITS_TARGET("ssse3")
+    std::uint32_t adler32_ssse3(std::uint32_t sum1, std::uint32_t sum2, std::span<const std::uint8_t> bytes)
+    {
+        constexpr std::size_t chunk_size {32u};
+        const __m128i taps1 {_mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17)};
+        const __m128i taps2 {_mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)};
+        const __m128i zero {_mm_setzero_si128()};
+        const __m128i ones {_mm_set1_epi16(1)};
+
+        const std::uint8_t* data {bytes.data()};
+        std::size_t chunks {bytes.size() / chunk_size};
+        while(chunks != 0u) {
+            std::size_t amount {std::min(chunks, nmax / chunk_size)};
+            chunks -= amount;
+
+            // sum1 before each chunk, added to sum2 multiplied by the chunk size at the end
+            __m128i previous_sum1s {_mm_set_epi32(0, 0, 0, static_cast<int>(sum1 * amount))};
+            __m128i vector_sum1 {zero};
+            __m128i vector_sum2 {_mm_set_epi32(0, 0, 0, static_cast<int>(sum2))};
+            do {
+                const __m128i bytes1 {_mm_loadu_si128(reinterpret_cast<const __m128i*>(data))};
+                const __m128i bytes2 {_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16u))};
+
+                previous_sum1s = _mm_add_epi32(previous_sum1s, vector_sum1);
+                vector_sum1 = _mm_add_epi32(vector_sum1, _mm_sad_epu8(bytes1, zero));
+                vector_sum1 = _mm_add_epi32(vector_sum1, _mm_sad_epu8(bytes2, zero));
+                vector_sum2 = _mm_add_epi32(vector_sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, taps1), ones));
+                vector_sum2 = _mm_add_epi32(vector_sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, taps2), ones));
+
+                data += chunk_size;
+            } while(--amount != 0u);
+            vector_sum2 = _mm_add_epi32(vector_sum2, _mm_slli_epi32(previous_sum1s, 5));
+
+            // horizontal sums
+            vector_sum1 = _mm_add_epi32(vector_sum1, _mm_shuffle_epi32(vector_sum1, _MM_SHUFFLE(2, 3, 0, 1)));
+            vector_sum1 = _mm_add_epi32(vector_sum1, _mm_shuffle_epi32(vector_sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+            vector_sum2 = _mm_add_epi32(vector_sum2, _mm_shuffle_epi32(vector_sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+            vector_sum2 = _mm_add_epi32(vector_sum2, _mm_shuffle_epi32(vector_sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum1 = (sum1 + static_cast<std::uint32_t>(_mm_cvtsi128_si32(vector_sum1))) % adler_modulus;
+            sum2 = static_cast<std::uint32_t>(_mm_cvtsi128_si32(vector_sum2)) % adler_modulus;
+        }
+
+        return adler32_scalar(sum1, sum2, bytes.subspan(bytes.size() - bytes.size() % chunk_size));
+    }
+
+    // same as adler32_ssse3, with 64 bytes chunks
+    SELEBITS_TARGET("avx2")
+    std::uint32_t adler32_avx2(std::uint32_t sum1, std::uint32_t sum2, std::span<const std::uint8_t> bytes)
+    {
+        constexpr std::size_t chunk_size {64u};
+        const __m256i taps1 {_mm256_setr_epi8(
+            64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49,
+            48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33)};
+        const __m256i taps2 {_mm256_setr_epi8(
+            32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+            16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)};
+        const __m256i zero {_mm256_setzero_si256()};
+        const __m256i ones {_mm256_set1_epi16(1)};
+
+        const std::uint8_t* data {bytes.data()};
+        std::size_t chunks {bytes.size() / chunk_size};
+        while(chunks != 0u) {
+            std::size_t amount {std::min(chunks, nmax / chunk_size)};
+            chunks -= amount;
+
+            __m256i previous_sum1s {_mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, static_cast<int>(sum1 * amount))};
+            __m256i vector_sum1 {zero};
+            __m256i vector_sum2 {_mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, static_cast<int>(sum2))};
+            do {
+                const __m256i bytes1 {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data))};
+                const __m256i bytes2 {_mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32u))};
+
+                previous_sum1s = _mm256_add_epi32(previous_sum1s, vector_sum1);
+                vector_sum1 = _mm256_add_epi32(vector_sum1, _mm256_sad_epu8(bytes1, zero));
+                vector_sum1 = _mm256_add_epi32(vector_sum1, _mm256_sad_epu8(bytes2, zero));
+                vector_sum2 = _mm256_add_epi32(vector_sum2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes1, taps1), ones));
+                vector_sum2 = _mm256_add_epi32(vector_sum2, _mm256_madd_epi16(_mm256_maddubs_epi16(bytes2, taps2), ones));
+
+                data += chunk_size;
+            } while(--amount != 0u);
+            vector_sum2 = _mm256_add_epi32(vector_sum2, _mm256_slli_epi32(previous_sum1s, 6));
+
+            // horizontal sums
+            __m128i half_sum1 {_mm_add_epi32(_mm256_castsi256_si128(vector_sum1), _mm256_extracti128_si256(vector_sum1, 1))};
+            __m128i half_sum2 {_mm_add_epi32(_mm256_castsi256_si128(vector_sum2), _mm256_extracti128_si256(vector_sum2, 1))};
+            half_sum1 = _mm_add_epi32(half_sum1, _mm_shuffle_epi32(half_sum1, _MM_SHUFFLE(2, 3, 0, 1)));
+            half_sum1 = _mm_add_epi32(half_sum1, _mm_shuffle_epi32(half_sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+            half_sum2 = _mm_add_epi32(half_sum2, _mm_shuffle_epi32(half_sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+            half_sum2 = _mm_add_epi32(half_sum2, _mm_shuffle_epi32(half_sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+            sum1 = (sum1 + static_cast<std::uint32_t>(_mm_cvtsi128_si32(half_sum1))) % adler_modulus;
+            sum2 = static_cast<std::uint32_t>(_mm_cvtsi128_si32(half_sum2)) % adler_modulus;
+        }
+
+        return adler32_scalar(sum1, sum2, bytes.subspan(bytes.size() - bytes.size() % chunk_size));
+    }
+#endif
+
+    using Adler32_function = std::uint32_t (*)(std::uint32_t, std::uint32_t, std::span<const std::uint8_t>);
+
+    Adler32_function choose_adler32_function() noexcept
+    {
+#ifdef SELEBITS_X86
+        if(sel::impl::cpu_features().avx2) return adler32_avx2;
+        if(sel::impl::cpu_features().ssse3) return adler32_ssse3;
+#endif
+        return adler32_scalar;
+    }
+}
+
+std::uint32_t sel::adler32(std::span<const std::uint8_t> bytes, const std::uint32_t adler)
 {
-    std::uint32_t sum1 {1u};
-    std::uint32_t sum2 {0u};
+    static const Adler32_function function {choose_adler32_function()};
+    return function(adler & 0xFFFFu, adler >> 16u, bytes);
+}
+
+std::uint32_t sel::adler32_combine(const std::uint32_t adler_a, const std::uint32_t adler_b, const std::uint64_t length_b) noexcept
+{
+    /* sum1 = sum1_a + sum1_b - 1
+    * sum2 = sum2_a + sum2_b + length_b * (sum1_a - 1), because each byte of 'b' adds sum1_a - 1 more */
+    const std::uint64_t remainder {length_b % adler_modulus};
+    const std::uint64_t sum1_a {adler_a & 0xFFFFu};
+    const std::uint64_t sum2_a {adler_a >> 16u};
+    const std::uint64_t sum1_b {adler_b & 0xFFFFu};
+    const std::uint64_t sum2_b {adler_b >> 16u};
+
+    const std::uint64_t sum1 {(sum1_a + sum1_b + adler_modulus - 1u) % adler_modulus};
+    const std::uint64_t sum2 {(sum2_a + sum2_b + remainder * sum1_a + adler_modulus - remainder) % adler_modulus};
+
+    return static_cast<std::uint32_t>((sum2 << 16u) | sum1);
+}
+
+std::uint32_t sel::adler32_parallel(std::span<const std::uint8_t> bytes, std::uint32_t threads)
+{
+    threads = static_cast<std::uint32_t>(std::min<std::size_t>(impl::resolve_thread_count(threads), bytes.size() / min_bytes_per_thread));
+    if(threads < 2u) return adler32(bytes);
+
+    // the last chunk takes the remainder of the division
+    const std::size_t chunk_size {bytes.size() / threads};
+    auto chunk {[&](const std::size_t i) {
+        return (i == threads - 1u) ? bytes.subspan(chunk_size * i) : bytes.subspan(chunk_size * i, chunk_size);
+    }};
+
+    std::vector<std::uint32_t> adlers(threads);
+    impl::for_each_in_parallel(threads, threads, [&](std::uint32_t, const std::size_t i) { adlers[i] = adler32(chunk(i)); });
 
-    for(std::span<const std::uint8_t>::size_type i = 0; i < bytes.size(); ++i) {
-        sum1 = (sum1 + bytes[i]) % 65521u;
-        sum2 = (sum2 + sum1) % 65521u;
+    std::uint32_t result {adlers[0]};
+    for(std::uint32_t i = 1u; i < threads; ++i) {
+        result = adler32_combine(result, adlers[i], chunk(i).size());
     }
 
-    return (sum2 << 16u) + sum1;
+    return result;
 }
\ No newline at end of file
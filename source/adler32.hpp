@@ -4,5 +4,13 @@
 #include <span>
 
 namespace sel {
-    std::uint32_t adler32(std::span<const std::uint8_t> bytes);
+    // 'adler' is the Adler-32 of the bytes that come before 'bytes', to compute it piece by piece
+    std::uint32_t adler32(std::span<const std::uint8_t> bytes, const std::uint32_t adler = 1u);
+
+    // the Adler-32 of 'a' followed by 'b', from the Adler-32 of each of them and the length of 'b'
+    std::uint32_t adler32_combine(const std::uint32_t adler_a, const std::uint32_t adler_b, const std::uint64_t length_b) noexcept;
+
+    /* splits 'bytes' among 'threads' threads (0: as many as the hardware runs concurrently) and combines
+    * their Adler-32s, the result is the same as adler32(bytes). Small inputs use fewer threads */
+    std::uint32_t adler32_parallel(std::span<const std::uint8_t> bytes, std::uint32_t threads = 0u);
 }
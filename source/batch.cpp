@@ -0,0 +1,58 @@
+#include "batch.hpp"
+#include "threads.hpp"
+
+#include <cstring>
+
+sel::Batch_result sel::decompress_deflate_batch(std::span<const std::span<const std::uint8_t>> deflate_streams, std::uint32_t threads)
+{
+    const std::size_t item_count {deflate_streams.size()};
+    std::size_t input_size {0u};
+    for(const std::span<const std::uint8_t> deflate_stream : deflate_streams) { input_size += deflate_stream.size(); }
+    threads = static_cast<std::uint32_t>(std::min({std::size_t {impl::resolve_thread_count(threads)}, item_count, input_size / impl::batch::min_bytes_per_thread}));
+    threads = std::max(threads, 1u);
+
+    Batch_result result;
+    result.errors.resize(item_count, Error::none);
+    std::vector<impl::batch::Worker> workers(threads);
+    std::vector<impl::batch::Item_output> item_outputs(item_count);
+    impl::for_each_in_parallel(item_count, threads, [&](const std::uint32_t worker, const std::size_t i) {
+        const std::size_t offset {workers[worker].output_size};
+        // corrupt items are reported without throwing, so a batch with many of them isn't slower
+        result.errors[i] = impl::batch::decompress(deflate_streams[i], workers[worker]);
+        item_outputs[i] = {worker, offset, workers[worker].output_size - offset};
+    });
+
+    // the outputs are joined in the order of the items
+    result.offsets.resize(item_count + 1u);
+    for(std::size_t i = 0u; i < item_count; ++i) { result.offsets[i + 1u] = result.offsets[i] + item_outputs[i].size; }
+    // one thread wrote them in order already
+    if(threads == 1u) {
+        result.data = std::move(workers[0].output);
+        result.data.resize(workers[0].output_size);
+        return result;
+    }
+
+    result.data.resize(result.offsets.back());
+    impl::for_each_in_parallel(item_count, threads, [&](std::uint32_t, const std::size_t i) {
+        const impl::batch::Item_output& item_output {item_outputs[i]};
+        if(item_output.size == 0u) return;
+        std::memcpy(result.data.data() + result.offsets[i], workers[item_output.worker].output.data() + item_output.offset, item_output.size);
+    });
+
+    return result;
+}
+
+sel::Error sel::impl::batch::decompress(std::span<const std::uint8_t> deflate_data, Worker& worker)
+{
+    // written after the streams that the worker already decompressed, the room only grows
+    deflate::Deflate_bitstream bitstream {deflate_data};
+    deflate::Output_buffer output {worker.output.data() + worker.output_size, 0u, worker.output.size() - worker.output_size, &worker.output, worker.output_size};
+    bool last_block {false};
+    while(not last_block) {
+        const Error error {deflate::decompress_block(output, bitstream, worker.tables, last_block)};
+        if(error != Error::none) return error;
+    }
+
+    worker.output_size += output.size;
+    return Error::none;
+}
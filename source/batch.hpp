@@ -0,0 +1,51 @@
+#pragma once
+
+#include "shared.hpp"
+#include "deflate.hpp"
+
+#include <vector>
+
+namespace sel {
+    struct Batch_result {
+        // the decompressed data of every item, one after another in the order of the inputs
+        std::vector<std::uint8_t> data;
+        // one more than the items: item i is data[offsets[i], offsets[i + 1])
+        std::vector<std::size_t> offsets;
+        // Error::none for the items that were decompressed, the others have no data
+        std::vector<Error> errors;
+
+        std::span<const std::uint8_t> output(const std::size_t item) const noexcept
+        {
+            return std::span<const std::uint8_t> {data}.subspan(offsets[item], offsets[item + 1u] - offsets[item]);
+        }
+    };
+
+    /* decompresses many independent deflate streams with 'threads' threads (0: as many as the hardware runs
+    * concurrently). Each thread takes the next stream when it finishes one and keeps its Huffman tables and
+    * its buffers for all of them, so small streams cost little more than decoding them. A stream that
+    * can't be decompressed only sets its error, the others are decompressed anyway */
+    Batch_result decompress_deflate_batch(std::span<const std::span<const std::uint8_t>> deflate_streams, const std::uint32_t threads = 0u);
+}
+
+namespace sel::impl::batch {
+    // no more threads than one per this much input, starting threads costs more than decoding less than that
+    constexpr std::size_t min_bytes_per_thread {1u << 16u}; // 64KB
+
+    // what each thread reuses
+    struct Worker {
+        deflate::Dynamic_tables tables;
+        // the streams that the thread decompressed one after another, in its first 'output_size' bytes
+        std::vector<std::uint8_t> output; // its size is the room
+        std::size_t output_size {0u};
+    };
+
+    // where the output of each item was written before the outputs are joined
+    struct Item_output {
+        std::uint32_t worker {0u};
+        std::size_t offset {0u};
+        std::size_t size {0u};
+    };
+
+    // decompresses the stream after the ones in worker.output, output_size only grows if it succeeds
+    Error decompress(std::span<const std::uint8_t> deflate_data, Worker& worker);
+}
@@ -0,0 +1,883 @@
+#include "compressor.hpp"
+#include "adler32.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+std::vector<std::uint8_t> sel::compress_deflate(std::span<const std::uint8_t> data, const std::uint32_t level)
+{
+    if(level > impl::compressor::max_level) throw Exception {Error::bug};
+
+    std::vector<std::uint8_t> compressed_data;
+    compressed_data.reserve(data.size() / 2u + 64u);
+    impl::compressor::Bit_writer writer {compressed_data};
+    impl::compressor::compress(data, 0u, impl::compressor::level_parameters[level], true, writer);
+    writer.flush();
+
+    return compressed_data;
+}
+
+std::vector<std::uint8_t> sel::compress_deflate_parallel(std::span<const std::uint8_t> data, const std::uint32_t level, const std::uint32_t threads)
+{
+    if(level > impl::compressor::max_level) throw Exception {Error::bug};
+
+    std::vector<std::uint8_t> compressed_data;
+    impl::compressor::compress_parallel(data, impl::compressor::level_parameters[level], threads, compressed_data);
+    return compressed_data;
+}
+
+void sel::impl::compressor::Bit_writer::write_bits(const std::uint32_t bits, const std::uint32_t amount)
+{
+    m_bit_buffer |= std::uint64_t {bits} << m_bits_in_buffer;
+    m_bits_in_buffer += amount;
+    if(m_bits_in_buffer >= 32u) { write_word(); }
+}
+
+void sel::impl::compressor::Bit_writer::align_to_byte()
+{
+    m_bits_in_buffer += bits_to_byte_boundary();
+    if(m_bits_in_buffer >= 32u) { write_word(); }
+}
+
+void sel::impl::compressor::Bit_writer::write_word()
+{
+    for(std::uint32_t i = 0u; i < 4u; ++i) {
+        m_output.push_back(static_cast<std::uint8_t>(m_bit_buffer >> (8u * i)));
+    }
+    m_bit_buffer >>= 32u;
+    m_bits_in_buffer -= 32u;
+}
+
+void sel::impl::compressor::Bit_writer::write_bytes(std::span<const std::uint8_t> bytes)
+{
+    if(m_bits_in_buffer % 8u != 0u) throw Exception {Error::bug};
+
+    flush();
+    m_output.insert(m_output.end(), bytes.begin(), bytes.end());
+}
+
+void sel::impl::compressor::Bit_writer::flush()
+{
+    align_to_byte();
+    while(m_bits_in_buffer != 0u) {
+        m_output.push_back(static_cast<std::uint8_t>(m_bit_buffer));
+        m_bit_buffer >>= 8u;
+        m_bits_in_buffer -= 8u;
+    }
+}
+
+sel::impl::compressor::Match_finder::Match_finder(std::span<const std::uint8_t> data)
+    : m_data {data}, m_head(std::size_t {1u} << hash_bits), m_previous(deflate::window_size)
+{}
+
+inline std::uint32_t sel::impl::compressor::Match_finder::hash(const std::size_t position) const noexcept
+{
+    const std::uint32_t bytes {std::uint32_t {m_data[position]} | (std::uint32_t {m_data[position + 1u]} << 8u) | (std::uint32_t {m_data[position + 2u]} << 16u)};
+    return (bytes * 0x1E35A7BDu) >> (32u - hash_bits);
+}
+
+void sel::impl::compressor::Match_finder::insert(const std::size_t position) noexcept
+{
+    if(m_data.size() - position < min_match_length) return;
+
+    std::size_t& head {m_head[hash(position)]};
+    m_previous[position & window_mask] = head;
+    head = position + 1u;
+}
+
+void sel::impl::compressor::Match_finder::insert(const std::size_t first, const std::size_t last) noexcept
+{
+    for(std::size_t position = first; position < last; ++position) { insert(position); }
+}
+
+namespace {
+    // how many bytes are the same at 'a' and 'b', up to 'max_length'
+    inline std::uint32_t common_length(const std::uint8_t* a, const std::uint8_t* b, const std::uint32_t max_length) noexcept
+    {
+        std::uint32_t length {0u};
+        while(length + 8u <= max_length) {
+            std::uint64_t a_word;
+            std::uint64_t b_word;
+            std::memcpy(&a_word, a + length, sizeof(a_word));
+            std::memcpy(&b_word, b + length, sizeof(b_word));
+            const std::uint64_t difference {a_word ^ b_word};
+            if(difference != 0u) {
+                if constexpr(std::endian::native == std::endian::little) { return length + (std::countr_zero(difference) >> 3u); }
+                else { return length + (std::countl_zero(difference) >> 3u); }
+            }
+            length += 8u;
+        }
+        while(length < max_length and a[length] == b[length]) { ++length; }
+
+        return length;
+    }
+}
+
+sel::impl::compressor::Match sel::impl::compressor::Match_finder::longest_match(const std::size_t position, const std::uint32_t max_length, const std::uint32_t max_chain_length, const std::uint32_t nice_length) noexcept
+{
+    Match best;
+    if(m_data.size() - position < min_match_length) return best;
+
+    std::size_t& head {m_head[hash(position)]};
+    std::size_t candidate {head};
+    m_previous[position & window_mask] = head;
+    head = position + 1u;
+    if(max_length < min_match_length) return best;
+
+    const std::uint8_t* const current {m_data.data() + position};
+    for(std::uint32_t chain = 0u; chain < max_chain_length and candidate != 0u; ++chain) {
+        const std::size_t candidate_position {candidate - 1u};
+        const std::size_t distance {position - candidate_position};
+        if(distance > deflate::window_size) break;
+
+        // the match can only be longer if the byte that would make it longer matches
+        const std::uint8_t* const earlier {m_data.data() + candidate_position};
+        if(earlier[best.length] == current[best.length]) {
+            const std::uint32_t length {common_length(earlier, current, max_length)};
+            if(length > best.length) {
+                best = {length, static_cast<std::uint32_t>(distance)};
+                if(length >= nice_length or length == max_length) break;
+            }
+        }
+
+        // the entry was overwritten by a newer position, the chain ends here
+        const std::size_t next {m_previous[candidate_position & window_mask]};
+        if(next >= candidate) break;
+        candidate = next;
+    }
+
+    // a short match far away takes more bits than the literals
+    if(best.length < min_match_length or (best.length == min_match_length and best.distance > 8192u)) return {};
+    return best;
+}
+
+void sel::impl::compressor::Match_finder::all_matches(const std::size_t position, const std::uint32_t max_length, const std::uint32_t max_chain_length, const std::uint32_t nice_length, std::vector<Match>& matches)
+{
+    if(m_data.size() - position < min_match_length) return;
+
+    std::size_t& head {m_head[hash(position)]};
+    std::size_t candidate {head};
+    m_previous[position & window_mask] = head;
+    head = position + 1u;
+    if(max_length < min_match_length) return;
+
+    const std::uint8_t* const current {m_data.data() + position};
+    std::uint32_t best_length {min_match_length - 1u};
+    for(std::uint32_t chain = 0u; chain < max_chain_length and candidate != 0u; ++chain) {
+        const std::size_t candidate_position {candidate - 1u};
+        const std::size_t distance {position - candidate_position};
+        if(distance > deflate::window_size) break;
+
+        const std::uint8_t* const earlier {m_data.data() + candidate_position};
+        if(earlier[best_length] == current[best_length]) {
+            const std::uint32_t length {common_length(earlier, current, max_length)};
+            if(length > best_length) {
+                best_length = length;
+                matches.push_back({length, static_cast<std::uint32_t>(distance)});
+                if(length >= nice_length or length == max_length) break;
+            }
+        }
+
+        const std::size_t next {m_previous[candidate_position & window_mask]};
+        if(next >= candidate) break;
+        candidate = next;
+    }
+}
+
+void sel::impl::compressor::compress(std::span<const std::uint8_t> data, const std::size_t start, const Level_parameters& parameters, const bool last, Bit_writer& writer)
+{
+    if(parameters.parser == Parser::stored) {
+        write_stored_blocks(writer, data.subspan(start), last);
+        return;
+    }
+
+    Match_finder match_finder {data};
+    match_finder.insert(start - std::min(start, deflate::window_size), start);
+    std::vector<Sequence> sequences;
+    std::span<const std::uint8_t> stored;
+    Optimal_parser_state optimal_parser_state;
+    std::size_t position {start};
+    // an empty input still needs a block
+    do {
+        const std::size_t chunk_start {position};
+        const std::size_t chunk_end {std::min(data.size(), chunk_start + chunk_size)};
+        sequences.clear();
+        switch(parameters.parser) {
+            case Parser::greedy:
+                position = parse_greedy(data, chunk_start, chunk_end, parameters, match_finder, sequences);
+                break;
+            case Parser::lazy:
+                position = parse_lazy(data, chunk_start, chunk_end, parameters, match_finder, sequences);
+                break;
+            case Parser::optimal:
+                position = parse_optimal(data, chunk_start, chunk_end, parameters, match_finder, sequences, optimal_parser_state);
+                break;
+            default:
+                throw Exception {Error::bug};
+        }
+
+        write_blocks(writer, sequences, data.subspan(chunk_start, position - chunk_start), stored, last and position == data.size());
+    } while(position != data.size());
+
+    if(not stored.empty()) { write_stored_blocks(writer, stored, false); }
+    // an empty stored block ends the data at a byte boundary, so more blocks can be appended byte by byte
+    if(not last and writer.bits_to_byte_boundary() != 0u) { write_stored_blocks(writer, {}, false); }
+}
+
+std::uint32_t sel::impl::compressor::compress_parallel(std::span<const std::uint8_t> data, const Level_parameters& parameters, std::uint32_t threads, std::vector<std::uint8_t>& output)
+{
+    const std::size_t chunk_count {std::max<std::size_t>(1u, (data.size() + parallel_chunk_size - 1u) / parallel_chunk_size)};
+    threads = static_cast<std::uint32_t>(std::min<std::size_t>(resolve_thread_count(threads), chunk_count));
+
+    std::vector<std::vector<std::uint8_t>> compressed_chunks(chunk_count);
+    std::vector<std::uint32_t> adlers(chunk_count);
+    for_each_in_parallel(chunk_count, threads, [&](std::uint32_t, const std::size_t i) {
+        const std::size_t start {i * parallel_chunk_size};
+        const std::size_t end {std::min(data.size(), start + parallel_chunk_size)};
+        // the 32KB before the chunk are its preset window
+        const std::size_t history_start {start - std::min(start, deflate::window_size)};
+
+        compressed_chunks[i].reserve((end - start) / 2u + 64u);
+        Bit_writer writer {compressed_chunks[i]};
+        compress(data.subspan(history_start, end - history_start), start - history_start, parameters, i == chunk_count - 1u, writer);
+        writer.flush();
+        adlers[i] = adler32(data.subspan(start, end - start));
+    });
+
+    std::size_t total_size {output.size()};
+    for(const std::vector<std::uint8_t>& compressed_chunk : compressed_chunks) { total_size += compressed_chunk.size(); }
+    output.reserve(total_size);
+    std::uint32_t adler {adlers[0]};
+    for(std::size_t i = 0u; i < chunk_count; ++i) {
+        output.insert(output.end(), compressed_chunks[i].begin(), compressed_chunks[i].end());
+        if(i != 0u) { adler = adler32_combine(adler, adlers[i], std::min(data.size() - i * parallel_chunk_size, parallel_chunk_size)); }
+    }
+
+    return adler;
+}
+
+std::size_t sel::impl::compressor::parse_greedy(std::span<const std::uint8_t> data, const std::size_t start, const std::size_t end, const Level_parameters& parameters, Match_finder& match_finder, std::vector<Sequence>& sequences)
+{
+    std::size_t position {start};
+    while(position < end) {
+        const std::uint32_t max_length {static_cast<std::uint32_t>(std::min<std::size_t>(deflate::max_match_length, data.size() - position))};
+        const Match match {match_finder.longest_match(position, max_length, parameters.max_chain_length, parameters.nice_length)};
+        if(match.length == 0u) {
+            sequences.push_back({data[position], 0u});
+            ++position;
+            continue;
+        }
+
+        sequences.push_back({static_cast<std::uint16_t>(match.length), static_cast<std::uint16_t>(match.distance)});
+        match_finder.insert(position + 1u, position + match.length);
+        position += match.length;
+    }
+
+    return position;
+}
+
+std::size_t sel::impl::compressor::parse_lazy(std::span<const std::uint8_t> data, const std::size_t start, const std::size_t end, const Level_parameters& parameters, Match_finder& match_finder, std::vector<Sequence>& sequences)
+{
+    // a match at the previous position, that is taken unless the current position has a longer one
+    Match pending;
+    std::size_t position {start};
+    while(position < end) {
+        const std::uint32_t max_length {static_cast<std::uint32_t>(std::min<std::size_t>(deflate::max_match_length, data.size() - position))};
+        const Match match {match_finder.longest_match(position, max_length, parameters.max_chain_length, parameters.nice_length)};
+        if(pending.length != 0u) {
+            if(pending.length >= match.length) {
+                sequences.push_back({static_cast<std::uint16_t>(pending.length), static_cast<std::uint16_t>(pending.distance)});
+                // the pending match started at the previous position, this one is already inserted
+                match_finder.insert(position + 1u, position - 1u + pending.length);
+                position += pending.length - 1u;
+                pending = {};
+                continue;
+            }
+
+            sequences.push_back({data[position - 1u], 0u});
+            pending = {};
+        }
+
+        if(match.length >= parameters.nice_length) {
+            sequences.push_back({static_cast<std::uint16_t>(match.length), static_cast<std::uint16_t>(match.distance)});
+            match_finder.insert(position + 1u, position + match.length);
+            position += match.length;
+        }
+        else if(match.length != 0u) {
+            pending = match;
+            ++position;
+        }
+        else {
+            sequences.push_back({data[position], 0u});
+            ++position;
+        }
+    }
+
+    if(pending.length != 0u) {
+        sequences.push_back({static_cast<std::uint16_t>(pending.length), static_cast<std::uint16_t>(pending.distance)});
+        match_finder.insert(position, position - 1u + pending.length);
+        position += pending.length - 1u;
+    }
+
+    return position;
+}
+
+namespace {
+    /* the sequences of lazy matching with the longest match of each position among the ones that were found,
+    * without searching again. Their statistics are far closer to the codes of the block than the fixed codes.
+    * Returns how many bytes they cover, the last match can go past 'size' */
+    std::size_t parse_lazy_from_matches(std::span<const std::uint8_t> data, const std::size_t start, const std::size_t size, const sel::impl::compressor::Optimal_parser_state& state,
+        std::vector<sel::impl::compressor::Sequence>& sequences)
+    {
+        using namespace sel::impl::compressor;
+
+        const auto longest_match {[&](const std::size_t i) {
+            if(i >= size or state.first_match[i] == state.first_match[i + 1u]) return Match {};
+            const Match match {state.matches[state.first_match[i + 1u] - 1u]};
+            // like in Match_finder::longest_match, a short match far away takes more bits than the literals
+            if(match.length == min_match_length and match.distance > 8192u) return Match {};
+            return match;
+        }};
+
+        sequences.clear();
+        std::size_t i {0u};
+        while(i < size) {
+            const Match match {longest_match(i)};
+            if(match.length == 0u or longest_match(i + 1u).length > match.length) {
+                sequences.push_back({data[start + i], 0u});
+                ++i;
+                continue;
+            }
+            sequences.push_back({static_cast<std::uint16_t>(match.length), static_cast<std::uint16_t>(match.distance)});
+            i += match.length;
+        }
+        return i;
+    }
+}
+
+std::size_t sel::impl::compressor::parse_optimal(std::span<const std::uint8_t> data, const std::size_t start, const std::size_t end, const Level_parameters& parameters, Match_finder& match_finder, std::vector<Sequence>& sequences, Optimal_parser_state& state)
+{
+    const std::size_t size {end - start};
+
+    /* the matches of every position are found once, the passes only change their costs. Every position is
+    * searched, also inside long matches: a shorter match that starts in one can be the cheaper way through.
+    * Like the other parsers, the last match can go past the end of the chunk */
+    state.matches.clear();
+    state.first_match.resize(size + 1u);
+    for(std::size_t i = 0u; i < size; ++i) {
+        state.first_match[i] = static_cast<std::uint32_t>(state.matches.size());
+        const std::uint32_t max_length {static_cast<std::uint32_t>(std::min<std::size_t>(deflate::max_match_length, data.size() - start - i))};
+        match_finder.all_matches(start + i, max_length, parameters.max_chain_length, parameters.nice_length, state.matches);
+    }
+    state.first_match[size] = static_cast<std::uint32_t>(state.matches.size());
+
+    /* the first pass has the costs of the codes of lazy matching, the next ones the costs of the codes of the
+    * previous pass. With 'fixed_code_seed', as many passes follow from the costs of the fixed codes, which
+    * can get to a smaller parse than the ones from lazy matching. A pass only knows the codes of the one
+    * before it, so it can come out bigger: the smallest parse is kept, including the one of lazy matching */
+    std::size_t best_size {parse_lazy_from_matches(data, start, size, state, sequences)};
+    state.best_sequences = sequences;
+    std::size_t best_bits {count_block_bits(sequences)};
+    std::array<std::uint32_t, 286> literal_length_costs;
+    std::array<std::uint32_t, 30> distance_costs;
+
+    const std::uint32_t passes {parameters.fixed_code_seed ? 2u * parameters.passes : parameters.passes};
+    for(std::uint32_t pass = 0u; pass < passes; ++pass) {
+        if(pass == parameters.passes) {
+            for(std::uint32_t i = 0u; i < 286u; ++i) { literal_length_costs[i] = i < 144u ? 8u : i < 256u ? 9u : i < 280u ? 7u : 8u; }
+            distance_costs.fill(5u);
+        }
+        else {
+            Symbol_frequencies frequencies;
+            count_frequencies(sequences, frequencies);
+            // every symbol stays possible, the ones that weren't used get long codes
+            for(std::uint32_t& frequency : frequencies.literal_length) { ++frequency; }
+            for(std::uint32_t& frequency : frequencies.distance) { ++frequency; }
+            make_bit_lengths(frequencies.literal_length, 15u, literal_length_costs);
+            make_bit_lengths(frequencies.distance, 15u, distance_costs);
+        }
+
+        std::array<std::uint32_t, deflate::max_match_length + 1u> length_costs {};
+        for(std::uint32_t length = min_match_length; length <= deflate::max_match_length; ++length) {
+            const std::uint32_t symbol {length_symbols[length]};
+            length_costs[length] = literal_length_costs[257u + symbol] + deflate::length_extra_bits[symbol];
+        }
+
+        // the cheapest way to get to each position from the start of the chunk
+        state.costs.assign(size + deflate::max_match_length + 1u, std::numeric_limits<std::uint32_t>::max());
+        state.choices.resize(state.costs.size());
+        state.costs[0] = 0u;
+        for(std::size_t i = 0u; i < size; ++i) {
+            const std::uint32_t cost {state.costs[i]};
+
+            const std::uint32_t literal_cost {cost + literal_length_costs[data[start + i]]};
+            if(literal_cost < state.costs[i + 1u]) {
+                state.costs[i + 1u] = literal_cost;
+                state.choices[i + 1u] = {1u, 0u};
+            }
+
+            std::uint32_t length {min_match_length};
+            for(std::uint32_t m = state.first_match[i]; m < state.first_match[i + 1u]; ++m) {
+                const Match& match {state.matches[m]};
+                const std::uint32_t symbol {distance_symbol(match.distance)};
+                const std::uint32_t match_cost {cost + distance_costs[symbol] + deflate::distance_extra_bits[symbol]};
+                if(match.length >= parameters.nice_length) { length = match.length; }
+                for(; length <= match.length; ++length) {
+                    const std::uint32_t total_cost {match_cost + length_costs[length]};
+                    if(total_cost < state.costs[i + length]) {
+                        state.costs[i + length] = total_cost;
+                        state.choices[i + length] = {static_cast<std::uint16_t>(length), static_cast<std::uint16_t>(match.distance)};
+                    }
+                }
+            }
+        }
+
+        // the choices are followed back from the furthest position that a match gets to
+        std::size_t parse_size {state.costs.size() - 1u};
+        while(state.costs[parse_size] == std::numeric_limits<std::uint32_t>::max()) { --parse_size; }
+        sequences.clear();
+        for(std::size_t i = parse_size; i != 0u;) {
+            const Sequence choice {state.choices[i]};
+            i -= choice.literal_or_length;
+            if(choice.distance == 0u) { sequences.push_back({data[start + i], 0u}); }
+            else { sequences.push_back(choice); }
+        }
+        std::reverse(sequences.begin(), sequences.end());
+
+        const std::size_t bits {count_block_bits(sequences)};
+        if(bits < best_bits) {
+            best_bits = bits;
+            best_size = parse_size;
+            state.best_sequences = sequences;
+        }
+    }
+
+    sequences = state.best_sequences;
+    // the positions after the end of the chunk weren't searched
+    match_finder.insert(end, start + best_size);
+    return start + best_size;
+}
+
+void sel::impl::compressor::write_blocks(Bit_writer& writer, std::span<const Sequence> sequences, std::span<const std::uint8_t> bytes, std::span<const std::uint8_t>& stored, const bool last)
+{
+    // the statistics are compared every 'segment_size' sequences, a split must save about a block header
+    constexpr std::size_t segment_size {4096u};
+    constexpr double split_threshold_bits {1024.0};
+
+    std::size_t block_start {0u};
+    std::size_t block_bytes_start {0u};
+    Symbol_frequencies block_frequencies;
+    std::size_t block_bytes {count_frequencies(sequences.first(std::min(segment_size, sequences.size())), block_frequencies)};
+    for(std::size_t segment_start = segment_size; segment_start < sequences.size(); segment_start += segment_size) {
+        Symbol_frequencies segment_frequencies;
+        const std::size_t segment_bytes {count_frequencies(sequences.subspan(segment_start, std::min(segment_size, sequences.size() - segment_start)), segment_frequencies)};
+
+        Symbol_frequencies merged_frequencies {block_frequencies};
+        for(std::size_t i = 0u; i < merged_frequencies.literal_length.size(); ++i) { merged_frequencies.literal_length[i] += segment_frequencies.literal_length[i]; }
+        for(std::size_t i = 0u; i < merged_frequencies.distance.size(); ++i) { merged_frequencies.distance[i] += segment_frequencies.distance[i]; }
+
+        if(estimate_bits(block_frequencies) + estimate_bits(segment_frequencies) + split_threshold_bits < estimate_bits(merged_frequencies)) {
+            write_block(writer, sequences.subspan(block_start, segment_start - block_start), bytes.subspan(block_bytes_start, block_bytes), stored, false);
+            block_start = segment_start;
+            block_bytes_start += block_bytes;
+            block_frequencies = segment_frequencies;
+            block_bytes = segment_bytes;
+        }
+        else {
+            block_frequencies = merged_frequencies;
+            block_bytes += segment_bytes;
+        }
+    }
+
+    write_block(writer, sequences.subspan(block_start), bytes.subspan(block_bytes_start), stored, last);
+}
+
+namespace {
+    // a dynamic block header, ready to be written
+    struct Dynamic_header {
+        std::array<std::uint32_t, 286> literal_length_bit_lengths {};
+        std::array<std::uint32_t, 30> distance_bit_lengths {};
+        std::array<std::uint32_t, 19> code_length_bit_lengths {};
+        std::uint32_t hlit {0u};
+        std::uint32_t hdist {0u};
+        std::uint32_t hclen {0u};
+        // the bit-lengths of both alphabets with the repeat codes (16, 17 and 18) and their extra bits
+        std::array<std::uint8_t, 286u + 30u> code_length_symbols {};
+        std::array<std::uint8_t, 286u + 30u> code_length_extra {};
+        std::uint32_t code_length_symbol_count {0u};
+        std::size_t bits {0u};
+    };
+
+    constexpr std::array<std::uint32_t, 19> code_length_extra_bits {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 3, 7};
+
+    void make_dynamic_header(const sel::impl::compressor::Symbol_frequencies& frequencies, Dynamic_header& header)
+    {
+        using namespace sel::impl;
+
+        compressor::make_bit_lengths(frequencies.literal_length, 15u, header.literal_length_bit_lengths);
+        compressor::make_bit_lengths(frequencies.distance, 15u, header.distance_bit_lengths);
+
+        header.hlit = 286u;
+        while(header.hlit > 257u and header.literal_length_bit_lengths[header.hlit - 1u] == 0u) { --header.hlit; }
+        header.hdist = 30u;
+        while(header.hdist > 1u and header.distance_bit_lengths[header.hdist - 1u] == 0u) { --header.hdist; }
+
+        std::array<std::uint32_t, 286u + 30u> bit_lengths;
+        std::copy_n(header.literal_length_bit_lengths.begin(), header.hlit, bit_lengths.begin());
+        std::copy_n(header.distance_bit_lengths.begin(), header.hdist, bit_lengths.begin() + header.hlit);
+        const std::uint32_t count {header.hlit + header.hdist};
+
+        std::array<std::uint32_t, 19> code_length_frequencies {};
+        std::uint32_t& symbol_count {header.code_length_symbol_count};
+        const auto add_symbol {[&](const std::uint32_t symbol, const std::uint32_t extra) {
+            header.code_length_symbols[symbol_count] = static_cast<std::uint8_t>(symbol);
+            header.code_length_extra[symbol_count] = static_cast<std::uint8_t>(extra);
+            ++symbol_count;
+            ++code_length_frequencies[symbol];
+        }};
+
+        symbol_count = 0u;
+        for(std::uint32_t i = 0u; i < count;) {
+            const std::uint32_t bit_length {bit_lengths[i]};
+            std::uint32_t run {1u};
+            while(i + run < count and bit_lengths[i + run] == bit_length) { ++run; }
+            i += run;
+
+            if(bit_length == 0u) {
+                for(; run >= 11u; run -= std::min(run, 138u)) { add_symbol(18u, std::min(run, 138u) - 11u); }
+                if(run >= 3u) {
+                    add_symbol(17u, run - 3u);
+                    run = 0u;
+                }
+            }
+            else {
+                add_symbol(bit_length, 0u);
+                --run;
+                for(; run >= 3u; run -= std::min(run, 6u)) { add_symbol(16u, std::min(run, 6u) - 3u); }
+            }
+            for(; run != 0u; --run) { add_symbol(bit_length, 0u); }
+        }
+
+        compressor::make_bit_lengths(code_length_frequencies, 7u, header.code_length_bit_lengths);
+        header.hclen = 19u;
+        while(header.hclen > 4u and header.code_length_bit_lengths[deflate::code_length_order[header.hclen - 1u]] == 0u) { --header.hclen; }
+
+        header.bits = 5u + 5u + 4u + 3u * header.hclen;
+        for(std::uint32_t i = 0u; i < 19u; ++i) {
+            header.bits += code_length_frequencies[i] * (header.code_length_bit_lengths[i] + code_length_extra_bits[i]);
+        }
+    }
+
+    // the bits of the symbols of a block with the given codes, without the extra bits
+    std::size_t count_symbol_bits(const sel::impl::compressor::Symbol_frequencies& frequencies, std::span<const std::uint32_t> literal_length_bit_lengths, std::span<const std::uint32_t> distance_bit_lengths) noexcept
+    {
+        std::size_t bits {0u};
+        for(std::size_t i = 0u; i < frequencies.literal_length.size(); ++i) { bits += std::size_t {frequencies.literal_length[i]} * literal_length_bit_lengths[i]; }
+        for(std::size_t i = 0u; i < frequencies.distance.size(); ++i) { bits += std::size_t {frequencies.distance[i]} * distance_bit_lengths[i]; }
+        return bits;
+    }
+
+    void write_sequences(sel::impl::compressor::Bit_writer& writer, std::span<const sel::impl::compressor::Sequence> sequences, std::span<const std::uint32_t> literal_length_bit_lengths, std::span<const std::uint32_t> distance_bit_lengths)
+    {
+        using namespace sel::impl;
+
+        std::array<std::uint32_t, 288> literal_length_codes;
+        std::array<std::uint32_t, 30> distance_codes;
+        compressor::make_codes(literal_length_bit_lengths, std::span {literal_length_codes}.first(literal_length_bit_lengths.size()));
+        compressor::make_codes(distance_bit_lengths, distance_codes);
+
+        for(const compressor::Sequence& sequence : sequences) {
+            if(sequence.distance == 0u) {
+                writer.write_bits(literal_length_codes[sequence.literal_or_length], literal_length_bit_lengths[sequence.literal_or_length]);
+                continue;
+            }
+
+            const std::uint32_t length_symbol {compressor::length_symbols[sequence.literal_or_length]};
+            writer.write_bits(literal_length_codes[257u + length_symbol], literal_length_bit_lengths[257u + length_symbol]);
+            writer.write_bits(sequence.literal_or_length - deflate::length_bases[length_symbol], deflate::length_extra_bits[length_symbol]);
+
+            const std::uint32_t distance_symbol {compressor::distance_symbol(sequence.distance)};
+            writer.write_bits(distance_codes[distance_symbol], distance_bit_lengths[distance_symbol]);
+            writer.write_bits(sequence.distance - deflate::distance_bases[distance_symbol], deflate::distance_extra_bits[distance_symbol]);
+        }
+        writer.write_bits(literal_length_codes[256], literal_length_bit_lengths[256]);
+    }
+
+    // symbols 286 and 287 never occur, but they have codes
+    constexpr std::array<std::uint32_t, 288> fixed_literal_length_bit_lengths {[] {
+        std::array<std::uint32_t, 288> bit_lengths {};
+        for(std::uint32_t i = 0u; i < 288u; ++i) { bit_lengths[i] = i < 144u ? 8u : i < 256u ? 9u : i < 280u ? 7u : 8u; }
+        return bit_lengths;
+    }()};
+
+    constexpr std::array<std::uint32_t, 30> fixed_distance_bit_lengths {[] {
+        std::array<std::uint32_t, 30> bit_lengths {};
+        bit_lengths.fill(5u);
+        return bit_lengths;
+    }()};
+
+    struct Huffman_block_bits {
+        std::size_t fixed {0u};
+        std::size_t dynamic {0u};
+    };
+
+    // the bits of a block of the sequences with each kind of codes, with the header of the block
+    Huffman_block_bits count_huffman_block_bits(std::span<const sel::impl::compressor::Sequence> sequences, sel::impl::compressor::Symbol_frequencies& frequencies, Dynamic_header& header)
+    {
+        using namespace sel::impl;
+
+        compressor::count_frequencies(sequences, frequencies);
+        frequencies.literal_length[256] = 1u; // end of block
+
+        std::size_t extra_bits {0u};
+        for(std::uint32_t i = 0u; i < 29u; ++i) { extra_bits += std::size_t {frequencies.literal_length[257u + i]} * deflate::length_extra_bits[i]; }
+        for(std::uint32_t i = 0u; i < 30u; ++i) { extra_bits += std::size_t {frequencies.distance[i]} * deflate::distance_extra_bits[i]; }
+
+        make_dynamic_header(frequencies, header);
+        return {
+            3u + count_symbol_bits(frequencies, fixed_literal_length_bit_lengths, fixed_distance_bit_lengths) + extra_bits,
+            3u + header.bits + count_symbol_bits(frequencies, header.literal_length_bit_lengths, header.distance_bit_lengths) + extra_bits
+        };
+    }
+}
+
+std::size_t sel::impl::compressor::count_block_bits(std::span<const Sequence> sequences)
+{
+    Symbol_frequencies frequencies;
+    Dynamic_header header;
+    const Huffman_block_bits bits {count_huffman_block_bits(sequences, frequencies, header)};
+    return std::min(bits.fixed, bits.dynamic);
+}
+
+void sel::impl::compressor::write_block(Bit_writer& writer, std::span<const Sequence> sequences, std::span<const std::uint8_t> bytes, std::span<const std::uint8_t>& stored, const bool last)
+{
+    Symbol_frequencies frequencies;
+    Dynamic_header header;
+    const Huffman_block_bits huffman_bits {count_huffman_block_bits(sequences, frequencies, header)};
+    const std::size_t fixed_bits {huffman_bits.fixed};
+    const std::size_t dynamic_bits {huffman_bits.dynamic};
+
+    /* a stored block can't have more than 65535 bytes, each one takes a header, the bits to the next byte boundary,
+    * LEN and NLEN. After the stored bytes, the next ones start at a byte boundary: 3 + 5 + 32 bits. The bytes are
+    * written after the ones that are already stored, only the blocks that they add count */
+    const auto stored_block_count {[](const std::size_t size) { return std::max<std::size_t>(1u, (size + 65534u) / 65535u); }};
+    const std::size_t stored_bits {stored.empty()
+        ? 3u + (writer.bits_to_byte_boundary() + 5u) % 8u + 32u + (stored_block_count(bytes.size()) - 1u) * 40u + bytes.size() * 8u
+        : (stored_block_count(stored.size() + bytes.size()) - stored_block_count(stored.size())) * 40u + bytes.size() * 8u};
+
+    if(stored_bits <= fixed_bits and stored_bits <= dynamic_bits) {
+        stored = stored.empty() ? bytes : std::span<const std::uint8_t> {stored.data(), stored.size() + bytes.size()};
+        if(last) {
+            write_stored_blocks(writer, stored, true);
+            stored = {};
+        }
+        return;
+    }
+
+    if(not stored.empty()) {
+        write_stored_blocks(writer, stored, false);
+        stored = {};
+    }
+    if(fixed_bits <= dynamic_bits) {
+        writer.write_bits(last ? 1u : 0u, 1u);
+        writer.write_bits(1u, 2u);
+        write_sequences(writer, sequences, fixed_literal_length_bit_lengths, fixed_distance_bit_lengths);
+    }
+    else {
+        writer.write_bits(last ? 1u : 0u, 1u);
+        writer.write_bits(2u, 2u);
+        writer.write_bits(header.hlit - 257u, 5u);
+        writer.write_bits(header.hdist - 1u, 5u);
+        writer.write_bits(header.hclen - 4u, 4u);
+        for(std::uint32_t i = 0u; i < header.hclen; ++i) {
+            writer.write_bits(header.code_length_bit_lengths[deflate::code_length_order[i]], 3u);
+        }
+
+        std::array<std::uint32_t, 19> code_length_codes;
+        make_codes(header.code_length_bit_lengths, code_length_codes);
+        for(std::uint32_t i = 0u; i < header.code_length_symbol_count; ++i) {
+            const std::uint32_t symbol {header.code_length_symbols[i]};
+            writer.write_bits(code_length_codes[symbol], header.code_length_bit_lengths[symbol]);
+            writer.write_bits(header.code_length_extra[i], code_length_extra_bits[symbol]);
+        }
+
+        write_sequences(writer, sequences, header.literal_length_bit_lengths, header.distance_bit_lengths);
+    }
+}
+
+void sel::impl::compressor::write_stored_blocks(Bit_writer& writer, std::span<const std::uint8_t> bytes, const bool last)
+{
+    // an empty input is a single empty block
+    do {
+        const std::size_t size {std::min<std::size_t>(bytes.size(), 65535u)};
+        const bool last_piece {size == bytes.size()};
+        writer.write_bits(last and last_piece ? 1u : 0u, 1u);
+        writer.write_bits(0u, 2u);
+        writer.align_to_byte();
+        writer.write_bits(static_cast<std::uint32_t>(size), 16u);
+        writer.write_bits(static_cast<std::uint32_t>(size) ^ 0xFFFFu, 16u);
+        writer.write_bytes(bytes.first(size));
+        bytes = bytes.subspan(size);
+    } while(not bytes.empty());
+}
+
+std::size_t sel::impl::compressor::count_frequencies(std::span<const Sequence> sequences, Symbol_frequencies& frequencies) noexcept
+{
+    std::size_t bytes {0u};
+    for(const Sequence& sequence : sequences) {
+        if(sequence.distance == 0u) {
+            ++frequencies.literal_length[sequence.literal_or_length];
+            ++bytes;
+            continue;
+        }
+
+        ++frequencies.literal_length[257u + length_symbols[sequence.literal_or_length]];
+        ++frequencies.distance[distance_symbol(sequence.distance)];
+        bytes += sequence.literal_or_length;
+    }
+
+    return bytes;
+}
+
+double sel::impl::compressor::estimate_bits(const Symbol_frequencies& frequencies) noexcept
+{
+    const auto entropy {[](std::span<const std::uint32_t> counts) {
+        double total {0.0};
+        for(const std::uint32_t count : counts) { total += count; }
+
+        double bits {0.0};
+        for(const std::uint32_t count : counts) {
+            if(count != 0u) { bits += count * std::log2(total / count); }
+        }
+        return bits;
+    }};
+
+    return entropy(frequencies.literal_length) + entropy(frequencies.distance);
+}
+
+void sel::impl::compressor::make_bit_lengths(std::span<const std::uint32_t> frequencies, const std::uint32_t max_bit_length, std::span<std::uint32_t> bit_lengths)
+{
+    std::fill(bit_lengths.begin(), bit_lengths.end(), 0u);
+
+    // the used symbols, from the least to the most frequent
+    std::array<std::uint32_t, 288> symbols;
+    std::uint32_t count {0u};
+    for(std::uint32_t i = 0u; i < frequencies.size(); ++i) {
+        if(frequencies[i] != 0u) {
+            symbols[count] = i;
+            ++count;
+        }
+    }
+    // a single code would be an incomplete set, a second one is made up
+    if(count < 2u) {
+        bit_lengths[0] = 1u;
+        bit_lengths[count == 1u and symbols[0] != 0u ? symbols[0] : 1u] = 1u;
+        return;
+    }
+    std::stable_sort(symbols.begin(), symbols.begin() + count, [&](const std::uint32_t a, const std::uint32_t b) { return frequencies[a] < frequencies[b]; });
+
+    /* the code lengths of a Huffman code in place, from "In-Place Calculation of Minimum-Redundancy Codes"
+    * (Moffat and Katajainen): first the tree as parent pointers, then the depths of the internal nodes
+    * and then the depths of the leaves */
+    std::array<std::uint32_t, 288> a;
+    for(std::uint32_t i = 0u; i < count; ++i) { a[i] = frequencies[symbols[i]]; }
+
+    a[0] += a[1];
+    std::uint32_t root {0u};
+    std::uint32_t leaf {2u};
+    for(std::uint32_t next = 1u; next < count - 1u; ++next) {
+        if(leaf >= count or a[root] < a[leaf]) {
+            a[next] = a[root];
+            a[root] = next;
+            ++root;
+        }
+        else {
+            a[next] = a[leaf];
+            ++leaf;
+        }
+
+        if(leaf >= count or (root < next and a[root] < a[leaf])) {
+            a[next] += a[root];
+            a[root] = next;
+            ++root;
+        }
+        else {
+            a[next] += a[leaf];
+            ++leaf;
+        }
+    }
+
+    a[count - 2u] = 0u;
+    for(std::uint32_t next = count - 2u; next-- != 0u;) { a[next] = a[a[next]] + 1u; }
+
+    std::uint32_t available {1u};
+    std::uint32_t used {0u};
+    std::uint32_t depth {0u};
+    std::int64_t internal {static_cast<std::int64_t>(count) - 2};
+    std::int64_t next {static_cast<std::int64_t>(count) - 1};
+    while(available > 0u) {
+        while(internal >= 0 and a[internal] == depth) {
+            ++used;
+            --internal;
+        }
+        while(available > used) {
+            a[next] = depth;
+            --next;
+            --available;
+        }
+        available = 2u * used;
+        ++depth;
+        used = 0u;
+    }
+
+    /* codes longer than the limit are shortened, the codes that makes room for them are lengthened
+    * one bit at a time (the Kraft sum must stay at one) */
+    std::array<std::uint32_t, 32> bl_count {};
+    for(std::uint32_t i = 0u; i < count; ++i) { ++bl_count[std::min(a[i], max_bit_length)]; }
+    std::uint64_t kraft_sum {0u};
+    for(std::uint32_t i = 1u; i <= max_bit_length; ++i) { kraft_sum += std::uint64_t {bl_count[i]} << (max_bit_length - i); }
+    for(; kraft_sum > (std::uint64_t {1u} << max_bit_length); --kraft_sum) {
+        --bl_count[max_bit_length];
+        for(std::uint32_t i = max_bit_length - 1u; i != 0u; --i) {
+            if(bl_count[i] != 0u) {
+                --bl_count[i];
+                bl_count[i + 1u] += 2u;
+                break;
+            }
+        }
+    }
+
+    // the least frequent symbols get the longest codes
+    std::uint32_t symbol_index {0u};
+    for(std::uint32_t bit_length = max_bit_length; bit_length != 0u; --bit_length) {
+        for(std::uint32_t i = 0u; i < bl_count[bit_length]; ++i) {
+            bit_lengths[symbols[symbol_index]] = bit_length;
+            ++symbol_index;
+        }
+    }
+}
+
+void sel::impl::compressor::make_codes(std::span<const std::uint32_t> bit_lengths, std::span<std::uint32_t> codes)
+{
+    std::array<std::uint32_t, 16> bl_count {};
+    for(const std::uint32_t bit_length : bit_lengths) { ++bl_count[bit_length]; }
+    bl_count[0] = 0u;
+
+    std::array<std::uint32_t, 16> next_code {};
+    std::uint32_t code {0u};
+    for(std::uint32_t i = 1u; i < 16u; ++i) {
+        code = (code + bl_count[i - 1u]) << 1u;
+        next_code[i] = code;
+    }
+
+    for(std::size_t i = 0u; i < bit_lengths.size(); ++i) {
+        if(bit_lengths[i] == 0u) {
+            codes[i] = 0u;
+            continue;
+        }
+        codes[i] = bitswap_from_lsbit(next_code[bit_lengths[i]], bit_lengths[i]);
+        ++next_code[bit_lengths[i]];
+    }
+}
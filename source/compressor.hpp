@@ -0,0 +1,196 @@
+#pragma once
+
+#include "shared.hpp"
+#include "deflate.hpp"
+
+#include <vector>
+#include <array>
+
+namespace sel {
+    /* compresses 'data' into a deflate stream (RFC 1951). 'level' goes from 0 (stored blocks only) to 9:
+    * 1~3 take the longest match that a short hash chain finds, 4~7 also look one byte ahead before taking
+    * a match (lazy matching) with longer chains and 8~9 choose among all the matches with a cost model
+    * of the block (near-optimal parsing). Every block is written as stored, fixed or dynamic, whichever
+    * is smaller, and the blocks end where the statistics of the data change */
+    std::vector<std::uint8_t> compress_deflate(std::span<const std::uint8_t> data, const std::uint32_t level = 6u);
+
+    /* the same, but the data is split into chunks that are compressed by 'threads' threads (0: as many as the
+    * hardware runs concurrently). Each chunk starts with the 32KB before it as history and ends at a byte
+    * boundary, so the chunks are simply joined. The output is slightly bigger than the one of compress_deflate */
+    std::vector<std::uint8_t> compress_deflate_parallel(std::span<const std::uint8_t> data, const std::uint32_t level = 6u, const std::uint32_t threads = 0u);
+}
+
+namespace sel::impl::compressor {
+    constexpr std::uint32_t max_level {9u};
+    constexpr std::uint32_t min_match_length {3u};
+    /* the input is parsed and written in chunks, so the sequences of a chunk are all that is in memory.
+    * Matches can reach the data before the chunk */
+    constexpr std::size_t chunk_size {1u << 17u}; // 128KB
+    // the data that each thread compresses at a time in compress_parallel
+    constexpr std::size_t parallel_chunk_size {1u << 18u}; // 256KB
+
+    enum class Parser {
+        stored,
+        greedy,
+        lazy,
+        optimal
+    };
+
+    struct Level_parameters {
+        Parser parser {Parser::stored};
+        std::uint32_t max_chain_length {0u}; // how many earlier positions with the same hash are tried
+        std::uint32_t nice_length {0u}; // a match at least this long is taken without trying others
+        std::uint32_t passes {0u}; // of the optimal parser, each one with the statistics of the previous one
+        bool fixed_code_seed {false}; // the optimal parser does its passes again from the costs of the fixed codes
+    };
+
+    constexpr std::array<Level_parameters, max_level + 1u> level_parameters {{
+        {Parser::stored, 0u, 0u, 0u, false},
+        {Parser::greedy, 1u, 16u, 0u, false},
+        {Parser::greedy, 4u, 32u, 0u, false},
+        {Parser::greedy, 8u, 64u, 0u, false},
+        {Parser::lazy, 8u, 32u, 0u, false},
+        {Parser::lazy, 16u, 64u, 0u, false},
+        {Parser::lazy, 32u, 128u, 0u, false},
+        {Parser::lazy, 128u, 258u, 0u, false},
+        {Parser::optimal, 128u, 128u, 2u, false},
+        {Parser::optimal, 256u, 258u, 3u, true}
+    }};
+
+    // the length symbol (0~28, add 257 for the literal/length alphabet) of each match length
+    constexpr std::array<std::uint8_t, 259> length_symbols {[] {
+        std::array<std::uint8_t, 259> symbols {};
+        for(std::uint32_t symbol = 0u; symbol < 29u; ++symbol) {
+            const std::uint32_t last {std::min(deflate::length_bases[symbol] + (1u << deflate::length_extra_bits[symbol]) - 1u, 258u)};
+            for(std::uint32_t length = deflate::length_bases[symbol]; length <= last; ++length) {
+                symbols[length] = static_cast<std::uint8_t>(symbol);
+            }
+        }
+        return symbols;
+    }()};
+
+    /* the distance symbol of distance - 1, up to 256 directly and then in steps of 128 (the distances of
+    * the symbols above 15 always start at a multiple of 128) */
+    constexpr std::array<std::uint8_t, 512> distance_symbols {[] {
+        std::array<std::uint8_t, 512> symbols {};
+        for(std::uint32_t symbol = 0u; symbol < 30u; ++symbol) {
+            const std::uint32_t first {deflate::distance_bases[symbol] - 1u};
+            const std::uint32_t last {first + (1u << deflate::distance_extra_bits[symbol]) - 1u};
+            for(std::uint32_t distance = first; distance <= last; ++distance) {
+                if(distance < 256u) { symbols[distance] = static_cast<std::uint8_t>(symbol); }
+                else { symbols[256u + (distance >> 7u)] = static_cast<std::uint8_t>(symbol); }
+            }
+        }
+        return symbols;
+    }()};
+
+    constexpr std::uint32_t distance_symbol(const std::uint32_t distance) noexcept
+    {
+        return distance <= 256u ? distance_symbols[distance - 1u] : distance_symbols[256u + ((distance - 1u) >> 7u)];
+    }
+
+    // a literal when 'distance' is zero, a match otherwise
+    struct Sequence {
+        std::uint16_t literal_or_length {0u};
+        std::uint16_t distance {0u};
+    };
+
+    struct Match {
+        std::uint32_t length {0u}; // zero means that there isn't a match
+        std::uint32_t distance {0u};
+    };
+
+    struct Symbol_frequencies {
+        std::array<std::uint32_t, 286> literal_length {};
+        std::array<std::uint32_t, 30> distance {};
+    };
+
+    // writes the bits in the order of deflate, the first bit is the less significant bit of the first byte
+    class Bit_writer {
+    public:
+        Bit_writer(std::vector<std::uint8_t>& output) noexcept : m_output {output} {}
+
+        // 'amount' can't be greater than 32
+        void write_bits(const std::uint32_t bits, const std::uint32_t amount);
+        // the bits until the next byte boundary are zeros
+        void align_to_byte();
+        // must be at a byte boundary
+        void write_bytes(std::span<const std::uint8_t> bytes);
+        // writes the bits that don't fill a whole byte, at the end
+        void flush();
+        // how many bits there are before the next byte boundary
+        std::uint32_t bits_to_byte_boundary() const noexcept { return (8u - m_bits_in_buffer % 8u) % 8u; }
+    private:
+        // the buffer never has more than 32 bits between calls
+        void write_word();
+
+        std::vector<std::uint8_t>& m_output;
+        std::uint64_t m_bit_buffer {0u};
+        std::uint32_t m_bits_in_buffer {0u};
+    };
+
+    /* hash chains of the positions of the data by their first three bytes: 'head' has the latest position
+    * of each hash and 'previous' the position before it with the same hash, for the last 32KB */
+    class Match_finder {
+    public:
+        Match_finder(std::span<const std::uint8_t> data);
+
+        void insert(const std::size_t position) noexcept;
+        void insert(const std::size_t first, const std::size_t last) noexcept; // [first, last)
+        /* the longest match at 'position' that is at most 'max_length' long, trying at most 'max_chain_length'
+        * earlier positions. The position is inserted */
+        Match longest_match(const std::size_t position, const std::uint32_t max_length, const std::uint32_t max_chain_length, const std::uint32_t nice_length) noexcept;
+        // the matches that are longer than every match nearer than them, shortest first
+        void all_matches(const std::size_t position, const std::uint32_t max_length, const std::uint32_t max_chain_length, const std::uint32_t nice_length, std::vector<Match>& matches);
+    private:
+        static constexpr std::uint32_t hash_bits {15u};
+        static constexpr std::size_t window_mask {deflate::window_size - 1u};
+
+        std::uint32_t hash(const std::size_t position) const noexcept;
+
+        std::span<const std::uint8_t> m_data;
+        // positions plus one, zero means none
+        std::vector<std::size_t> m_head;
+        std::vector<std::size_t> m_previous;
+    };
+
+    // the scratch space of the optimal parser
+    struct Optimal_parser_state {
+        std::vector<Match> matches;
+        std::vector<std::uint32_t> first_match; // the index in 'matches' of the matches of each position
+        std::vector<std::uint32_t> costs; // the cheapest way to get to each position, in bits
+        std::vector<Sequence> choices; // the sequence that gets to each position the cheapest way
+        std::vector<Sequence> best_sequences; // the smallest parse of the passes so far
+    };
+
+    /* compresses data[start, end) into deflate blocks, data[0, start) is the history that the matches can reach.
+    * If it isn't the last part of the stream, it ends at a byte boundary */
+    void compress(std::span<const std::uint8_t> data, const std::size_t start, const Level_parameters& parameters, const bool last, Bit_writer& writer);
+    // appends the whole deflate stream of 'data' to 'output' and returns the Adler-32 of 'data'
+    std::uint32_t compress_parallel(std::span<const std::uint8_t> data, const Level_parameters& parameters, std::uint32_t threads, std::vector<std::uint8_t>& output);
+
+    // they parse at least until 'end', and return where they stopped (greedy and lazy matches can go past it)
+    std::size_t parse_greedy(std::span<const std::uint8_t> data, const std::size_t start, const std::size_t end, const Level_parameters& parameters, Match_finder& match_finder, std::vector<Sequence>& sequences);
+    std::size_t parse_lazy(std::span<const std::uint8_t> data, const std::size_t start, const std::size_t end, const Level_parameters& parameters, Match_finder& match_finder, std::vector<Sequence>& sequences);
+    std::size_t parse_optimal(std::span<const std::uint8_t> data, const std::size_t start, const std::size_t end, const Level_parameters& parameters, Match_finder& match_finder, std::vector<Sequence>& sequences, Optimal_parser_state& state);
+
+    /* splits the sequences into blocks where the statistics of the symbols change enough to pay for
+    * another block header. 'bytes' is the data that the sequences decode to. The blocks that are smaller
+    * stored are added to 'stored' (the bytes just before 'bytes'), which is written before the next block
+    * that isn't stored or with the last block: stored blocks are split every 65535 bytes, not at every chunk */
+    void write_blocks(Bit_writer& writer, std::span<const Sequence> sequences, std::span<const std::uint8_t> bytes, std::span<const std::uint8_t>& stored, const bool last);
+    void write_block(Bit_writer& writer, std::span<const Sequence> sequences, std::span<const std::uint8_t> bytes, std::span<const std::uint8_t>& stored, const bool last);
+    void write_stored_blocks(Bit_writer& writer, std::span<const std::uint8_t> bytes, const bool last);
+
+    // returns the amount of bytes that the sequences decode to
+    std::size_t count_frequencies(std::span<const Sequence> sequences, Symbol_frequencies& frequencies) noexcept;
+    // the entropy of the symbols, which is about what a Huffman code of them takes
+    double estimate_bits(const Symbol_frequencies& frequencies) noexcept;
+    // the bits of the sequences in a single block, fixed or dynamic (whichever is smaller)
+    std::size_t count_block_bits(std::span<const Sequence> sequences);
+
+    // lengths of a Huffman code of at most 'max_bit_length' bits, at least two symbols have a code
+    void make_bit_lengths(std::span<const std::uint32_t> frequencies, const std::uint32_t max_bit_length, std::span<std::uint32_t> bit_lengths);
+    // the canonical codes of the bit lengths, bit-reversed to be written as they are
+    void make_codes(std::span<const std::uint32_t> bit_lengths, std::span<std::uint32_t> codes);
+}
@@ -0,0 +1,143 @@
+#include "crc32.hpp"
+#include "shared.hpp"
+
+#include <array>
+
+#ifdef SELEBITS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr std::uint32_t polynomial {0xEDB88320u};
+
+    /* crc_tables[0] is the usual byte at a time table, crc_tables[i] advances the CRC of a byte over i
+    * zero bytes more, so 8 bytes are done with 8 independent lookups (slicing-by-8) */
+    constexpr std::array<std::array<std::uint32_t, 256>, 8> crc_tables {[] {
+        std::array<std::array<std::uint32_t, 256>, 8> tables {};
+        for(std::uint32_t i = 0u; i < 256u; ++i) {
+            std::uint32_t crc {i};
+            for(std::uint32_t bit = 0u; bit < 8u; ++bit) {
+                crc = (crc >> 1u) ^ (polynomial & (0u - (crc & 1u)));
+            }
+            tables[0][i] = crc;
+        }
+        for(std::size_t table = 1u; table < tables.size(); ++table) {
+            for(std::size_t i = 0u; i < 256u; ++i) {
+                const std::uint32_t previous {tables[table - 1u][i]};
+                tables[table][i] = (previous >> 8u) ^ tables[0][previous & 0xFFu];
+            }
+        }
+        return tables;
+    }()};
+
+    // the functions take and return the CRC before the final inversion
+    std::uint32_t crc32_scalar(std::uint32_t crc, std::span<const std::uint8_t> bytes)
+    {
+        const std::uint8_t* data {bytes.data()};
+        std::size_t size {bytes.size()};
+        while(size >= 8u) {
+            const std::uint32_t low {crc ^ (data[0] | (data[1] << 8u) | (data[2] << 16u) | (static_cast<std::uint32_t>(data[3]) << 24u))};
+            const std::uint32_t high {data[4] | (data[5] << 8u) | (data[6] << 16u) | (static_cast<std::uint32_t>(data[7]) << 24u)};
+            crc = crc_tables[7][low & 0xFFu] ^ crc_tables[6][(low >> 8u) & 0xFFu] ^ crc_tables[5][(low >> 16u) & 0xFFu] ^ crc_tables[4][low >> 24u]
+                ^ crc_tables[3][high & 0xFFu] ^ crc_tables[2][(high >> 8u) & 0xFFu] ^ crc_tables[1][(high >> 16u) & 0xFFu] ^ crc_tables[0][high >> 24u];
+            data += 8u;
+            size -= 8u;
+        }
+        while(size != 0u) {
+            crc = (crc >> 8u) ^ crc_tables[0][(crc ^ *data) & 0xFFu];
+            ++data;
+            --size;
+        }
+
+        return crc;
+    }
+
+#ifdef SELEBITS_X86
+    SELEBITS_TARGET("sse2")
+    inline __m128i load(const std::uint8_t* data)
+    {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    }
+
+    // 'accumulator' times the two halves of 'constants', xored with 'next'
+    SELEBITS_TARGET("sse2,pclmul")
+    inline __m128i fold(const __m128i accumulator, const __m128i constants, const __m128i next)
+    {
+        const __m128i low {_mm_clmulepi64_si128(accumulator, constants, 0x00)};
+        const __m128i high {_mm_clmulepi64_si128(accumulator, constants, 0x11)};
+        return _mm_xor_si128(_mm_xor_si128(low, high), next);
+    }
+
+    /* folding with carry-less multiplications ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+    * Instruction", Intel): four 128 bits accumulators are each multiplied by x^(512+64) and x^512 modulo P and
+    * xored into the next 64 bytes, then folded into one, reduced to 64 bits and to 32 bits with a Barrett
+    * reduction. The constants are in the bit-reflected domain of the CRC */
+    SELEBITS_TARGET("sse2,pclmul")
+    std::uint32_t crc32_pclmul(std::uint32_t crc, std::span<const std::uint8_t> bytes)
+    {
+        constexpr std::size_t chunk_size {64u};
+        if(bytes.size() < chunk_size) return crc32_scalar(crc, bytes);
+
+        const __m128i fold_by_4 {_mm_set_epi64x(0x1C6E41596, 0x154442BD4)};
+        const __m128i fold_by_1 {_mm_set_epi64x(0x0CCAA009E, 0x1751997D0)};
+        const __m128i fold_to_64 {_mm_set_epi64x(0x0, 0x163CD6124)};
+        const __m128i barrett {_mm_set_epi64x(0x1F7011641, 0x1DB710641)}; // mu and P
+        const __m128i low_32_bits {_mm_setr_epi32(-1, 0, -1, 0)};
+
+        const std::uint8_t* data {bytes.data()};
+        std::size_t size {bytes.size()};
+        __m128i x1 {_mm_xor_si128(load(data), _mm_cvtsi32_si128(static_cast<int>(crc)))};
+        __m128i x2 {load(data + 16u)};
+        __m128i x3 {load(data + 32u)};
+        __m128i x4 {load(data + 48u)};
+        data += chunk_size;
+        size -= chunk_size;
+
+        while(size >= chunk_size) {
+            x1 = fold(x1, fold_by_4, load(data));
+            x2 = fold(x2, fold_by_4, load(data + 16u));
+            x3 = fold(x3, fold_by_4, load(data + 32u));
+            x4 = fold(x4, fold_by_4, load(data + 48u));
+            data += chunk_size;
+            size -= chunk_size;
+        }
+
+        x1 = fold(x1, fold_by_1, x2);
+        x1 = fold(x1, fold_by_1, x3);
+        x1 = fold(x1, fold_by_1, x4);
+        while(size >= 16u) {
+            x1 = fold(x1, fold_by_1, load(data));
+            data += 16u;
+            size -= 16u;
+        }
+
+        // 128 bits to 64 bits
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(x1, fold_by_1, 0x10));
+        x1 = _mm_xor_si128(_mm_srli_si128(x1, 4), _mm_clmulepi64_si128(_mm_and_si128(x1, low_32_bits), fold_to_64, 0x00));
+
+        // 64 bits to 32 bits
+        __m128i quotient {_mm_clmulepi64_si128(_mm_and_si128(x1, low_32_bits), barrett, 0x10)};
+        quotient = _mm_clmulepi64_si128(_mm_and_si128(quotient, low_32_bits), barrett, 0x00);
+        x1 = _mm_xor_si128(x1, quotient);
+        crc = static_cast<std::uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+
+        return crc32_scalar(crc, std::span<const std::uint8_t> {data, size});
+    }
+#endif
+
+    using Crc32_function = std::uint32_t (*)(std::uint32_t, std::span<const std::uint8_t>);
+
+    Crc32_function choose_crc32_function() noexcept
+    {
+#ifdef SELEBITS_X86
+        if(sel::impl::cpu_features().pclmul) return crc32_pclmul;
+#endif
+        return crc32_scalar;
+    }
+}
+
+std::uint32_t sel::crc32(std::span<const std::uint8_t> bytes, const std::uint32_t crc)
+{
+    static const Crc32_function function {choose_crc32_function()};
+    return ~function(~crc, bytes);
+}
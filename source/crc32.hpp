@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace sel {
+    /* the CRC-32 of gzip, zip and PNG (reflected polynomial 0xEDB88320). 'crc' is the CRC-32 of the
+    * bytes that come before 'bytes', to compute it piece by piece */
+    std::uint32_t crc32(std::span<const std::uint8_t> bytes, const std::uint32_t crc = 0u);
+}
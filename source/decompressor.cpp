@@ -0,0 +1,71 @@
+#include "decompressor.hpp"
+#include "zlib.hpp"
+
+#include <stdexcept>
+
+std::vector<std::uint8_t> sel::Decompressor::decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint)
+{
+    return impl::deflate::decompress_to_vector(deflate_data, size_hint, m_tables).value();
+}
+
+std::size_t sel::Decompressor::decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output)
+{
+    return impl::deflate::decompress_to_span(deflate_data, output, m_tables).value();
+}
+
+std::vector<std::uint8_t> sel::Decompressor::decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary)
+{
+    return impl::zlib::decompress(zlib_data, dictionary, m_tables).value();
+}
+
+std::vector<std::uint8_t> sel::Decompressor::decompress_gzip(std::span<const std::uint8_t> gzip_data)
+{
+    return impl::gzip::decompress(gzip_data, m_tables, nullptr).value();
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::Decompressor::try_decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint) noexcept
+{
+    try {
+        return impl::deflate::decompress_to_vector(deflate_data, size_hint, m_tables);
+    }
+    // the same as sel::try_decompress_deflate
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+    catch(const std::length_error&) {
+        return Decode_error {Error::out_of_memory};
+    }
+    catch(...) {
+        return Decode_error {Error::bug};
+    }
+}
+
+sel::Expected<std::size_t> sel::Decompressor::try_decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output) noexcept
+{
+    try {
+        return impl::deflate::decompress_to_span(deflate_data, output, m_tables);
+    }
+    catch(...) {
+        return Decode_error {Error::bug};
+    }
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::Decompressor::try_decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary) noexcept
+{
+    try {
+        return impl::zlib::decompress(zlib_data, dictionary, m_tables);
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::Decompressor::try_decompress_gzip(std::span<const std::uint8_t> gzip_data) noexcept
+{
+    try {
+        return impl::gzip::decompress(gzip_data, m_tables, nullptr);
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "shared.hpp"
+#include "deflate.hpp"
+#include "gzip.hpp"
+
+#include <vector>
+
+namespace sel {
+    /* the same as the free functions, but the Huffman tables and the scratch space are kept between calls
+    * instead of being set up on every call, so decoding many small streams only allocates the output
+    * (and nothing at all with a span as output). A Decompressor can be reused, but not by two threads at
+    * the same time, each thread should have its own */
+    class Decompressor {
+    public:
+        std::vector<std::uint8_t> decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint = 0u);
+        std::size_t decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output);
+        std::vector<std::uint8_t> decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary = {});
+        std::vector<std::uint8_t> decompress_gzip(std::span<const std::uint8_t> gzip_data);
+
+        // without exceptions, see try_decompress_deflate
+        Expected<std::vector<std::uint8_t>> try_decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint = 0u) noexcept;
+        Expected<std::size_t> try_decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output) noexcept;
+        Expected<std::vector<std::uint8_t>> try_decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary = {}) noexcept;
+        Expected<std::vector<std::uint8_t>> try_decompress_gzip(std::span<const std::uint8_t> gzip_data) noexcept;
+
+        // the tables are cached across calls too, streams from the same encoder often share headers
+        Table_cache_statistics table_cache_statistics() const noexcept { return m_tables.statistics; }
+    private:
+        impl::deflate::Dynamic_tables m_tables;
+    };
+}
@@ -1,280 +1,892 @@
 #include "deflate.hpp"
+#include "statistics.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <stdexcept>
 
-std::vector<std::uint8_t> sel::decompress_deflate(std::span<const std::uint8_t> deflate_data)
+std::vector<std::uint8_t> sel::decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint)
 {
-    impl::deflate::Deflate_bitstream bitstream {deflate_data};
-    std::vector<std::uint8_t> inflated_data;
-    inflated_data.reserve(5000); // 5KB
-    std::uint32_t bfinal {0u};
-    do {
-        bfinal = bitstream.read_bits(1);
-        const std::uint32_t btype {bitstream.read_bits(2)};
-        switch(btype) {
-            case 0: // no compression
-                bitstream.skip_until_next_byte_boundary();
-                impl::deflate::decompress_uncompressed(inflated_data, bitstream);
+    impl::deflate::Dynamic_tables tables;
+    return impl::deflate::decompress_to_vector(deflate_data, size_hint, tables).value();
+}
+
+std::size_t sel::decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output)
+{
+    impl::deflate::Dynamic_tables tables;
+    return impl::deflate::decompress_to_span(deflate_data, output, tables).value();
+}
+
+std::vector<std::uint8_t> sel::decompress_deflate(std::span<const std::uint8_t> deflate_data, Inflate_statistics& statistics, const std::size_t size_hint)
+{
+    impl::deflate::Dynamic_tables tables;
+    return impl::deflate::decompress_to_vector(deflate_data, size_hint, tables, &statistics).value();
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::try_decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint) noexcept
+{
+    try {
+        impl::deflate::Dynamic_tables tables;
+        return impl::deflate::decompress_to_vector(deflate_data, size_hint, tables);
+    }
+    // a size hint too large for a vector is the same as one that can't be allocated
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+    catch(const std::length_error&) {
+        return Decode_error {Error::out_of_memory};
+    }
+    // the statistics callback threw, which it must not
+    catch(...) {
+        return Decode_error {Error::bug};
+    }
+}
+
+sel::Expected<std::size_t> sel::try_decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output) noexcept
+{
+    try {
+        impl::deflate::Dynamic_tables tables;
+        return impl::deflate::decompress_to_span(deflate_data, output, tables);
+    }
+    // the statistics callback threw, which it must not
+    catch(...) {
+        return Decode_error {Error::bug};
+    }
+}
+
+namespace {
+    /* the flag is checked first, so decompressing without a callback doesn't touch the shared pointer. A callback
+    * is never changed, only replaced, and the decompressions that are calling the old one keep it alive */
+    std::atomic<bool> statistics_callback_set {false};
+    std::atomic<std::shared_ptr<const sel::Inflate_statistics_callback>> statistics_callback;
+}
+
+void sel::set_inflate_statistics_callback(Inflate_statistics_callback callback)
+{
+    const bool set {static_cast<bool>(callback)};
+    statistics_callback.store(set ? std::make_shared<const Inflate_statistics_callback>(std::move(callback)) : nullptr);
+    statistics_callback_set.store(set);
+}
+
+bool sel::impl::deflate::has_statistics_callback() noexcept
+{
+    return statistics_callback_set.load(std::memory_order_relaxed);
+}
+
+void sel::impl::deflate::report_statistics(const Inflate_statistics& statistics)
+{
+    const std::shared_ptr<const Inflate_statistics_callback> callback {statistics_callback.load()};
+    if(callback != nullptr) { (*callback)(statistics); }
+}
+
+sel::Inflater::Inflater() : m_window(4u * impl::deflate::window_size) {}
+
+sel::Inflater::Result sel::Inflater::inflate(std::span<const std::uint8_t> input, std::span<std::uint8_t> output)
+{
+    return try_inflate(input, output).value();
+}
+
+// the output has no vector, so nothing here allocates
+sel::Expected<sel::Inflater::Result> sel::Inflater::try_inflate(std::span<const std::uint8_t> input, std::span<std::uint8_t> output) noexcept
+{
+    Result result;
+    bool needs_input {false};
+    while(true) {
+        // write what was decompressed
+        const std::size_t amount {std::min(m_window_used - m_window_written, output.size() - result.bytes_written)};
+        std::memcpy(output.data() + result.bytes_written, m_window.data() + m_window_written, amount);
+        m_window_written += amount;
+        result.bytes_written += amount;
+        if(m_window_written != m_window_used or needs_input or m_state.step == impl::deflate::Inflate_state::Step::done) {
+            return result;
+        }
+
+        // when the window is full, only the history is kept
+        if(m_window.size() - m_window_used < impl::deflate::max_match_length + impl::deflate::max_lz77_copy_overrun) {
+            const std::size_t history {std::min(m_window_used, impl::deflate::window_size)};
+            std::memmove(m_window.data(), m_window.data() + m_window_used - history, history);
+            m_window_used = history;
+            m_window_written = history;
+        }
+
+        /* the input that couldn't be decoded the last time is in the stash, followed by as much of the new
+        * input as fits. Once the stash is decoded, the new input is decoded where it is */
+        const std::span<const std::uint8_t> new_input {input.subspan(result.bytes_read)};
+        const bool from_stash {m_stash_size != 0u};
+        std::size_t appended {0u};
+        if(from_stash) {
+            appended = std::min(new_input.size(), stash_capacity - m_stash_size);
+            // an empty input can have no data at all, which memcpy doesn't allow
+            std::copy_n(new_input.data(), appended, m_stash.data() + m_stash_size);
+            m_stash_size += appended;
+            result.bytes_read += appended;
+        }
+        else if(new_input.empty()) { return result; }
+
+        const std::span<const std::uint8_t> source {from_stash ? std::span<const std::uint8_t> {m_stash.data(), m_stash_size} : new_input};
+        impl::deflate::Deflate_bitstream bitstream {source};
+        bitstream.skip_bits(m_bit_offset);
+        impl::deflate::Output_buffer window {m_window.data(), m_window_used, m_window.size()};
+        const impl::deflate::Inflate_status status {impl::deflate::inflate(m_state, m_tables, window, bitstream)};
+        if(status == impl::deflate::Inflate_status::bad_formed_data) return Decode_error {Error::bad_formed_data, result.bytes_read * 8u};
+        m_window_used = window.size;
+
+        // the stream ends at a byte boundary
+        std::size_t bits_read {source.size() * 8u - bitstream.bits_left()};
+        if(status == impl::deflate::Inflate_status::done) { bits_read = (bits_read + 7u) / 8u * 8u; }
+        const std::size_t bytes_read {bits_read / 8u};
+        const std::size_t bytes_unread {source.size() - bytes_read};
+        m_bit_offset = static_cast<std::uint32_t>(bits_read % 8u);
+
+        if(from_stash) {
+            if(bytes_unread <= appended) {
+                // the stash is decoded, the rest is given back to be decoded from the input
+                result.bytes_read -= bytes_unread;
+                m_stash_size = 0u;
+            }
+            else {
+                std::memmove(m_stash.data(), m_stash.data() + bytes_read, bytes_unread);
+                m_stash_size = bytes_unread;
+            }
+        }
+        else {
+            result.bytes_read += bytes_read;
+            if(status == impl::deflate::Inflate_status::needs_input) {
+                // the end of the input has part of a block header or a symbol
+                std::memcpy(m_stash.data(), new_input.data() + bytes_read, bytes_unread);
+                m_stash_size = bytes_unread;
+                result.bytes_read += bytes_unread;
+            }
+        }
+
+        needs_input = status == impl::deflate::Inflate_status::needs_input and result.bytes_read == input.size();
+    }
+}
+
+bool sel::Inflater::finished() const noexcept
+{
+    return m_state.step == impl::deflate::Inflate_state::Step::done and m_window_written == m_window_used;
+}
+
+std::span<const std::uint8_t> sel::Inflater::input_after_end() const noexcept
+{
+    if(m_state.step != impl::deflate::Inflate_state::Step::done) return {};
+
+    return {m_stash.data(), m_stash_size};
+}
+
+sel::impl::deflate::Inflate_status sel::impl::deflate::inflate(Inflate_state& state, Dynamic_tables& tables, Output_buffer& output, Deflate_bitstream& bitstream)
+{
+    while(true) {
+        switch(state.step) {
+            case Inflate_state::Step::block_header: {
+                // a block header is read whole or not at all
+                const Deflate_bitstream saved {bitstream};
+                const Error error {read_block_header(state, tables, bitstream)};
+                if(error == Error::unexpected_eof) {
+                    bitstream = saved;
+                    return Inflate_status::needs_input;
+                }
+                if(error != Error::none) return Inflate_status::bad_formed_data;
                 break;
-            case 1: // fixed Huffman codes
-                impl::deflate::decompress_fixed(inflated_data, bitstream);
+            }
+            case Inflate_state::Step::stored_block: {
+                if(state.stored_bytes_left == 0u) {
+                    state.step = state.last_block ? Inflate_state::Step::done : Inflate_state::Step::block_header;
+                    if(state.stop_at_block_boundaries and state.step == Inflate_state::Step::block_header) return Inflate_status::block_boundary;
+                    break;
+                }
+
+                // the bit-stream is at a byte boundary
+                std::size_t amount {std::min<std::size_t>(state.stored_bytes_left, bitstream.bits_left() / 8u)};
+                if(amount == 0u) return Inflate_status::needs_input;
+                if(not output.reserve(amount)) { amount = output.capacity - output.size; }
+                if(amount == 0u) return Inflate_status::needs_output;
+
+                const std::span<const std::uint8_t> bytes {bitstream.read_bytes(static_cast<std::uint32_t>(amount))};
+                std::memcpy(output.data + output.size, bytes.data(), amount);
+                output.size += amount;
+                state.stored_bytes_left -= static_cast<std::uint32_t>(amount);
                 break;
-            case 2: // dynamic Huffman codes
-                impl::deflate::decompress_dynamic(inflated_data, bitstream);
+            }
+            case Inflate_state::Step::huffman_block: {
+                const Inflate_status status {state.fixed_block
+                    ? decompress_huffman_block(output, bitstream, fixed_literal_length_alphabet, fixed_distance_alphabet)
+                    : decompress_huffman_block(output, bitstream, tables.literal_length_alphabet(), tables.distance_alphabet())};
+                if(status != Inflate_status::done) return status;
+
+                state.step = state.last_block ? Inflate_state::Step::done : Inflate_state::Step::block_header;
+                if(state.stop_at_block_boundaries and state.step == Inflate_state::Step::block_header) return Inflate_status::block_boundary;
                 break;
-            default:
-                throw Exception {Error::bad_formed_data};
+            }
+            case Inflate_state::Step::done:
+                return Inflate_status::done;
         }
-    } while(not bfinal);
+    }
+}
+
+namespace {
+    // where the bit-stream is in the data, for Decode_error
+    std::size_t bit_offset(std::span<const std::uint8_t> deflate_data, const sel::impl::deflate::Deflate_bitstream& bitstream) noexcept
+    {
+        return deflate_data.size() * 8u - bitstream.bits_left();
+    }
+
+    struct Stream_start {
+        std::uint64_t cycles {0u};
+        std::chrono::steady_clock::time_point time;
+    };
+
+    // resets the statistics, if there are
+    Stream_start start_stream(sel::Inflate_statistics* statistics) noexcept
+    {
+        if(statistics == nullptr) return {};
+
+        *statistics = {};
+        return {sel::impl::read_cycle_counter(), std::chrono::steady_clock::now()};
+    }
 
+    void finish_stream(sel::Inflate_statistics* statistics, const Stream_start& start, const std::size_t bits_read, const std::size_t decompressed_bytes, const sel::Error error) noexcept
+    {
+        if(statistics == nullptr) return;
+
+        statistics->total_cycles = sel::impl::read_cycle_counter() - start.cycles;
+        statistics->nanoseconds = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start.time).count());
+        statistics->compressed_bytes = (bits_read + 7u) / 8u;
+        statistics->decompressed_bytes = decompressed_bytes;
+        statistics->error = error;
+    }
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::impl::deflate::decompress_to_vector(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint, Dynamic_tables& tables, Inflate_statistics* statistics)
+{
+    if(statistics == nullptr and has_statistics_callback()) {
+        Inflate_statistics reported;
+        Expected<std::vector<std::uint8_t>> result {decompress_to_vector(deflate_data, size_hint, tables, &reported)};
+        report_statistics(reported);
+        return result;
+    }
+
+    const Stream_start start {start_stream(statistics)};
+    std::vector<std::uint8_t> inflated_data;
+    Deflate_bitstream bitstream {deflate_data};
+    Output_buffer output {.vector = &inflated_data};
+    // with the room for the hot loops, a right hint means that the vector never grows
+    output.reserve(size_hint != 0u ? size_hint + max_match_length + max_lz77_copy_overrun : 5000u); // 5KB
+    bool last_block {false};
+    Error error {Error::none};
+    while(not last_block and error == Error::none) {
+        error = decompress_block(output, bitstream, tables, last_block, statistics);
+    }
+    finish_stream(statistics, start, bit_offset(deflate_data, bitstream), output.size, error);
+    if(error != Error::none) return Decode_error {error, bit_offset(deflate_data, bitstream)};
+
+    inflated_data.resize(output.size);
     return inflated_data;
 }
 
-void sel::impl::deflate::decompress_uncompressed(std::vector<std::uint8_t>& inflated_data, Deflate_bitstream& bitstream)
+sel::Expected<std::size_t> sel::impl::deflate::decompress_to_span(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output, Dynamic_tables& tables, Inflate_statistics* statistics)
 {
-    std::uint32_t len {bitstream.read_bits(16)};
-    std::uint32_t nlen {bitstream.read_bits(16)};
-    if(~len != nlen) throw Exception {Error::bad_formed_data};
-    if(len == 0u) return; // zero length is allowed
+    if(statistics == nullptr and has_statistics_callback()) {
+        Inflate_statistics reported;
+        const Expected<std::size_t> result {decompress_to_span(deflate_data, output, tables, &reported)};
+        report_statistics(reported);
+        return result;
+    }
 
-    std::span<const std::uint8_t> uncompressed_data {bitstream.read_bytes(len)};
-    inflated_data.insert(inflated_data.end(), uncompressed_data.begin(), uncompressed_data.end());
+    const Stream_start start {start_stream(statistics)};
+    Deflate_bitstream bitstream {deflate_data};
+    Output_buffer output_buffer {output.data(), 0u, output.size()};
+    bool last_block {false};
+    Error error {Error::none};
+    // without a vector the output never grows, so nothing here allocates
+    while(not last_block and error == Error::none) {
+        error = decompress_block(output_buffer, bitstream, tables, last_block, statistics);
+    }
+    finish_stream(statistics, start, bit_offset(deflate_data, bitstream), output_buffer.size, error);
+    if(error != Error::none) return Decode_error {error, bit_offset(deflate_data, bitstream)};
+
+    return output_buffer.size;
 }
 
-void sel::impl::deflate::decompress_fixed(std::vector<std::uint8_t>& inflated_data, Deflate_bitstream& bitstream)
+sel::Error sel::impl::deflate::read_block_header(Inflate_state& state, Dynamic_tables& tables, Deflate_bitstream& bitstream) noexcept
 {
-    static const std::vector<Huffman_code> huffman_codes(make_fixed_huffman_table());
-    std::uint32_t symbol {fetch_symbol_in_fixed_block(huffman_codes, bitstream)};
-    while(symbol != 256u) {
-        if(symbol < 256u) {
-            inflated_data.push_back(static_cast<std::uint8_t>(symbol));
+    std::uint32_t bfinal {0u};
+    std::uint32_t btype {0u};
+    if(not bitstream.try_read_bits(1u, bfinal) or not bitstream.try_read_bits(2u, btype)) return Error::unexpected_eof;
+    switch(btype) {
+        case 0: { // no compression
+            bitstream.skip_until_next_byte_boundary();
+            std::uint32_t len {0u};
+            std::uint32_t nlen {0u};
+            if(not bitstream.try_read_bits(16u, len) or not bitstream.try_read_bits(16u, nlen)) return Error::unexpected_eof;
+            if((len ^ 0xFFFFu) != nlen) return Error::bad_formed_data;
+            state.stored_bytes_left = len;
+            state.step = Inflate_state::Step::stored_block;
+            break;
         }
-        else {
-            if(symbol > 285u) throw Exception {Error::bad_formed_data};
-            symbol -= 257u;
-            const std::uint32_t length {length_bases[symbol] + bitstream.read_bits(length_extra_bits[symbol])};
-            if(length > 258u) throw Exception {Error::bad_formed_data};
-
-            // for fixed huffman blocks, a distance huffman code and its symbol have the same values
-            symbol = bitstream.read_bits(5);
-            symbol = bitswap_from_lsbit(symbol, 5);
-            if(symbol > 29u) throw Exception {Error::bad_formed_data};
-            const std::uint32_t distance {distance_bases[symbol] + bitstream.read_bits(distance_extra_bits[symbol])};
-            if(distance > inflated_data.size() or distance > 32768u) throw Exception {Error::bad_formed_data};
-
-            lz77_copy(inflated_data, length, distance);
+        case 1: // fixed Huffman codes
+            state.fixed_block = true;
+            state.step = Inflate_state::Step::huffman_block;
+            break;
+        case 2: { // dynamic Huffman codes
+            const Error error {read_dynamic_huffman_tables(bitstream, tables)};
+            if(error != Error::none) return error;
+            state.fixed_block = false;
+            state.step = Inflate_state::Step::huffman_block;
+            break;
+        }
+        default:
+            return Error::bad_formed_data;
+    }
+
+    state.last_block = bfinal != 0u;
+    return Error::none;
+}
+
+sel::Error sel::impl::deflate::decompress_block(Output_buffer& output, Deflate_bitstream& bitstream, Dynamic_tables& tables, bool& last_block, Inflate_statistics* statistics)
+{
+    const std::size_t bits_left_before {bitstream.bits_left()};
+    const std::size_t size_before {output.size};
+    std::uint32_t bfinal {0u};
+    std::uint32_t btype {0u};
+    if(not bitstream.try_read_bits(1u, bfinal) or not bitstream.try_read_bits(2u, btype)) return Error::unexpected_eof;
+    last_block = bfinal != 0u;
+    Error error {Error::none};
+    switch(btype) {
+        case 0: // no compression
+            bitstream.skip_until_next_byte_boundary();
+            error = decompress_uncompressed(output, bitstream, statistics);
+            break;
+        case 1: // fixed Huffman codes
+            error = decompress_fixed(output, bitstream, statistics);
+            break;
+        case 2: // dynamic Huffman codes
+            error = decompress_dynamic(output, bitstream, tables, statistics);
+            break;
+        default:
+            return Error::bad_formed_data;
+    }
+
+    if(statistics != nullptr) {
+        Inflate_statistics::Blocks& blocks {btype == 0u ? statistics->stored_blocks : btype == 1u ? statistics->fixed_blocks : statistics->dynamic_blocks};
+        ++blocks.count;
+        blocks.compressed_bits += bits_left_before - bitstream.bits_left();
+        blocks.decompressed_bytes += output.size - size_before;
+    }
+    return error;
+}
+
+sel::Error sel::impl::deflate::decompress_uncompressed(Output_buffer& output, Deflate_bitstream& bitstream, Inflate_statistics* statistics)
+{
+    std::uint32_t len {0u};
+    std::uint32_t nlen {0u};
+    if(not bitstream.try_read_bits(16u, len) or not bitstream.try_read_bits(16u, nlen)) return Error::unexpected_eof;
+    if((len ^ 0xFFFFu) != nlen) return Error::bad_formed_data;
+    if(len == 0u) return Error::none; // zero length is allowed
+
+    // the bit-stream is at a byte boundary
+    if(bitstream.bits_left() < std::size_t {len} * 8u) return Error::unexpected_eof;
+    std::span<const std::uint8_t> uncompressed_data {bitstream.read_bytes(len)};
+    if(not output.reserve(len)) return Error::output_too_small;
+    const std::uint64_t copy_start {statistics != nullptr ? read_cycle_counter() : 0u};
+    std::memcpy(output.data + output.size, uncompressed_data.data(), len);
+    output.size += len;
+    if(statistics != nullptr) { statistics->copying_cycles += read_cycle_counter() - copy_start; }
+    return Error::none;
+}
+
+namespace {
+    // the end of a block that is decompressed whole
+    sel::Error block_error(const sel::impl::deflate::Inflate_status status) noexcept
+    {
+        switch(status) {
+            case sel::impl::deflate::Inflate_status::needs_input: return sel::Error::unexpected_eof;
+            case sel::impl::deflate::Inflate_status::needs_output: return sel::Error::output_too_small;
+            case sel::impl::deflate::Inflate_status::bad_formed_data: return sel::Error::bad_formed_data;
+            default: return sel::Error::none;
         }
+    }
 
-        symbol = fetch_symbol_in_fixed_block(huffman_codes, bitstream);
+    // with statistics, the block is timed here and its copies by the block itself
+    template<typename Literal_length_table, typename Distance_table>
+    sel::Error decompress_whole_huffman_block(sel::impl::deflate::Output_buffer& output, sel::impl::deflate::Deflate_bitstream& bitstream,
+        const Literal_length_table& literal_length_alphabet, const Distance_table& distance_alphabet, sel::Inflate_statistics* statistics)
+    {
+        using namespace sel::impl::deflate;
+
+        if(statistics == nullptr) return block_error(decompress_huffman_block(output, bitstream, literal_length_alphabet, distance_alphabet));
+
+        const std::uint64_t start {sel::impl::read_cycle_counter()};
+        const std::uint64_t copying_before {statistics->copying_cycles};
+        const Inflate_status status {decompress_huffman_block<Literal_length_table, Distance_table, true>(output, bitstream, literal_length_alphabet, distance_alphabet, statistics)};
+        // the copies are estimated, so they may come out longer than the whole block
+        const std::uint64_t block_cycles {sel::impl::read_cycle_counter() - start};
+        statistics->decoding_cycles += block_cycles - std::min(block_cycles, statistics->copying_cycles - copying_before);
+        return block_error(status);
     }
 }
 
-void sel::impl::deflate::decompress_dynamic(std::vector<std::uint8_t>& inflated_data, Deflate_bitstream& bitstream)
+sel::Error sel::impl::deflate::decompress_fixed(Output_buffer& output, Deflate_bitstream& bitstream, Inflate_statistics* statistics)
 {
-    const std::uint32_t hlit {bitstream.read_bits(5) + 257u};
-    const std::uint32_t hdist {bitstream.read_bits(5) + 1u};
-    const std::uint32_t hclen {bitstream.read_bits(4) + 4u};
-    if(hlit > 286u or hdist > 30u) throw Exception {Error::bad_formed_data};
-
-    // the order of slots with which to place the bit-lengths of the codes of the code bit-length alphabet
-    static constexpr std::array<int, 19> ordered_indexes {
-        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
-    };
+    return decompress_whole_huffman_block(output, bitstream, fixed_literal_length_alphabet, fixed_distance_alphabet, statistics);
+}
+
+sel::Error sel::impl::deflate::decompress_dynamic(Output_buffer& output, Deflate_bitstream& bitstream, Dynamic_tables& tables, Inflate_statistics* statistics)
+{
+    const std::uint64_t start {statistics != nullptr ? read_cycle_counter() : 0u};
+    const Error error {read_dynamic_huffman_tables(bitstream, tables)};
+    if(statistics != nullptr) { statistics->table_building_cycles += read_cycle_counter() - start; }
+    if(error != Error::none) return error;
+
+    return decompress_whole_huffman_block(output, bitstream, tables.literal_length_alphabet(), tables.distance_alphabet(), statistics);
+}
+
+namespace {
+    // FNV-1a of the bit-lengths and of where the distance alphabet starts, to tell cached headers apart quickly
+    std::uint64_t hash_bit_lengths(const std::uint32_t hlit, std::span<const std::uint32_t> bit_lengths) noexcept
+    {
+        std::uint64_t hash {0xCBF29CE484222325u ^ hlit};
+        for(const std::uint32_t bit_length : bit_lengths) {
+            hash = (hash ^ bit_length) * 0x100000001B3u;
+        }
+        return hash;
+    }
+}
+
+sel::Error sel::impl::deflate::read_dynamic_huffman_tables(Deflate_bitstream& bitstream, Dynamic_tables& tables) noexcept
+{
+    std::uint32_t hlit {0u};
+    std::uint32_t hdist {0u};
+    std::uint32_t hclen {0u};
+    if(not bitstream.try_read_bits(5u, hlit) or not bitstream.try_read_bits(5u, hdist) or not bitstream.try_read_bits(4u, hclen)) {
+        return Error::unexpected_eof;
+    }
+    hlit += 257u;
+    hdist += 1u;
+    hclen += 4u;
+    if(hlit > 286u or hdist > 30u) return Error::bad_formed_data;
 
     std::array<std::uint32_t, 19> code_length_alphabet_bit_lengths;
     for(std::uint32_t i = 0u; i < hclen; ++i) {
-        code_length_alphabet_bit_lengths[ordered_indexes[i]] = bitstream.read_bits(3);
+        if(not bitstream.try_read_bits(3u, code_length_alphabet_bit_lengths[code_length_order[i]])) return Error::unexpected_eof;
     }
     for(std::uint32_t i = hclen; i < 19u; ++i) {
-        code_length_alphabet_bit_lengths[ordered_indexes[i]] = 0u;
+        code_length_alphabet_bit_lengths[code_length_order[i]] = 0u;
     }
-    std::vector<Huffman_code> code_length_alphabet(make_huffman_codes_from_bit_lengths(code_length_alphabet_bit_lengths));
+    Error error {make_huffman_table_from_bit_lengths(tables.code_length_alphabet, code_length_alphabet_bit_lengths, code_length_primary_bits)};
+    if(error != Error::none) return error;
 
     // bit-lengths of both the literal+length alphabet and the distance alphabet
-    std::vector<std::uint32_t> alphabets_bit_lengths;
+    std::array<std::uint32_t, 286u + 30u> alphabets_bit_lengths;
     const std::uint32_t hlit_hdist {hlit + hdist};
-    alphabets_bit_lengths.reserve(hlit_hdist);
+    std::uint32_t count {0u};
     // for(std::uint32_t i = 0u; i < hlit_hdist; ++i) <- Cannot be like this
-    while(alphabets_bit_lengths.size() < hlit_hdist) {
-        const std::uint32_t symbol {fetch_symbol_in_dynamic_block(code_length_alphabet, bitstream)};
+    while(count < hlit_hdist) {
+        std::uint32_t symbol {0u};
+        error = fetch_symbol(tables.code_length_alphabet, bitstream, symbol);
+        if(error != Error::none) return error;
         if(symbol < 16u) {
-            alphabets_bit_lengths.push_back(symbol);
+            alphabets_bit_lengths[count] = symbol;
+            ++count;
+            continue;
         }
-        else if(symbol == 16u) {
-            if(alphabets_bit_lengths.empty()) throw Exception {Error::bad_formed_data};
-            const std::uint32_t value_to_copy {alphabets_bit_lengths.back()};
-            const std::uint32_t times_to_copy {bitstream.read_bits(2) + 3u};
-            alphabets_bit_lengths.insert(alphabets_bit_lengths.end(), times_to_copy, value_to_copy);
+
+        std::uint32_t value_to_copy {0u};
+        std::uint32_t times_to_copy {0u};
+        bool complete {false};
+        if(symbol == 16u) {
+            if(count == 0u) return Error::bad_formed_data;
+            value_to_copy = alphabets_bit_lengths[count - 1u];
+            complete = bitstream.try_read_bits(2u, times_to_copy);
+            times_to_copy += 3u;
         }
         else if(symbol == 17u) {
-            const std::uint32_t times_to_copy {bitstream.read_bits(3) + 3u};
-            alphabets_bit_lengths.insert(alphabets_bit_lengths.end(), times_to_copy, 0u);
+            complete = bitstream.try_read_bits(3u, times_to_copy);
+            times_to_copy += 3u;
         }
         else if(symbol == 18u) {
-            const std::uint32_t times_to_copy {bitstream.read_bits(7) + 11u};
-            alphabets_bit_lengths.insert(alphabets_bit_lengths.end(), times_to_copy, 0u);
+            complete = bitstream.try_read_bits(7u, times_to_copy);
+            times_to_copy += 11u;
         }
-        else { throw Exception {Error::bad_formed_data}; }
+        else { return Error::bad_formed_data; }
+        if(not complete) return Error::unexpected_eof;
+
+        if(count + times_to_copy > hlit_hdist) return Error::bad_formed_data;
+        std::fill_n(alphabets_bit_lengths.begin() + count, times_to_copy, value_to_copy);
+        count += times_to_copy;
     }
 
-    std::span<const std::uint32_t> literal_length_alphabet_bit_lengths(alphabets_bit_lengths.begin(), hlit);
-    std::vector<Huffman_code> literal_length_alphabet(make_huffman_codes_from_bit_lengths(literal_length_alphabet_bit_lengths));
+    const std::span<const std::uint32_t> bit_lengths {alphabets_bit_lengths.data(), hlit_hdist};
+    const std::uint64_t hash {hash_bit_lengths(hlit, bit_lengths)};
+    for(std::size_t i = 0u; i < Dynamic_tables::cache_size; ++i) {
+        const Dynamic_tables::Cached_tables& cached {tables.cache[i]};
+        if(cached.valid and cached.hash == hash and cached.hlit == hlit and cached.hdist == hdist
+            and std::equal(bit_lengths.begin(), bit_lengths.end(), cached.bit_lengths.begin())) {
+            tables.current = i;
+            ++tables.statistics.hits;
+            return Error::none;
+        }
+    }
+    ++tables.statistics.misses;
+
+    // the oldest tables are replaced, they stay invalid if the new ones can't be built
+    Dynamic_tables::Cached_tables& cached {tables.cache[tables.next_replaced]};
+    cached.valid = false;
+    error = make_huffman_table_from_bit_lengths(cached.literal_length_alphabet, bit_lengths.first(hlit), literal_length_primary_bits);
+    if(error != Error::none) return error;
     /* this is so silly: the case in where the amount of bit-lengths for the distance alphabet is 1
     * and that lonely bit-length happens to be zero is valid, it means that the data to decompress
     * is all literals and there aren't length or distance codes. It's silly because the "no compression"
     * block (BTYPE == 0) already exists, this was completely unnecessary.
+    * A table made from bit-lengths that are all zero has no valid entries, so fetching a distance
+    * symbol from it is already an error.
     */
-    std::span<const std::uint32_t> distance_alphabet_bit_lengths(alphabets_bit_lengths.begin() + hlit, hdist);
-    std::vector<Huffman_code> distance_alphabet;
-    if(distance_alphabet_bit_lengths.size() == 1u and distance_alphabet_bit_lengths[0] == 0u) { /* do nothing */ }
-    else { distance_alphabet = make_huffman_codes_from_bit_lengths(distance_alphabet_bit_lengths); }
-
-    /* loop copy-pasted from decompress_fixed, the differences are small and I could put this loop
-    * in a single function to avoid code duplication, but in this case, I am going to allow the
-    * duplication */
-    std::uint32_t symbol {fetch_symbol_in_dynamic_block(literal_length_alphabet, bitstream)};
-    while(symbol != 256u) {
+    error = make_huffman_table_from_bit_lengths(cached.distance_alphabet, bit_lengths.subspan(hlit), distance_primary_bits);
+    if(error != Error::none) return error;
+
+    std::copy(bit_lengths.begin(), bit_lengths.end(), cached.bit_lengths.begin());
+    cached.hash = hash;
+    cached.hlit = hlit;
+    cached.hdist = hdist;
+    cached.valid = true;
+    tables.current = tables.next_replaced;
+    tables.next_replaced = (tables.next_replaced + 1u) % Dynamic_tables::cache_size;
+    return Error::none;
+}
+
+namespace {
+    /* a literal, the end of the block, or a length and a distance that reaches no further than 'output_size'.
+    * 'symbol' is the literal/length symbol */
+    template<typename Literal_length_table, typename Distance_table>
+    sel::Error read_sequence(sel::impl::deflate::Deflate_bitstream& bitstream, const Literal_length_table& literal_length_alphabet, const Distance_table& distance_alphabet,
+        const std::size_t output_size, std::uint32_t& symbol, std::uint32_t& length, std::uint32_t& distance_symbol, std::uint32_t& distance) noexcept
+    {
+        using namespace sel::impl::deflate;
+
+        sel::Error error {fetch_symbol(literal_length_alphabet, bitstream, symbol)};
+        if(error != sel::Error::none or symbol <= 256u) return error;
+        if(symbol > 285u) return sel::Error::bad_formed_data;
+        const std::uint32_t length_symbol {symbol - 257u};
+        if(not bitstream.try_read_bits(length_extra_bits[length_symbol], length)) return sel::Error::unexpected_eof;
+        length += length_bases[length_symbol];
+
+        error = fetch_symbol(distance_alphabet, bitstream, distance_symbol);
+        if(error != sel::Error::none) return error;
+        if(distance_symbol > 29u) return sel::Error::bad_formed_data;
+        if(not bitstream.try_read_bits(distance_extra_bits[distance_symbol], distance)) return sel::Error::unexpected_eof;
+        distance += distance_bases[distance_symbol];
+        if(distance > output_size) return sel::Error::bad_formed_data;
+
+        return sel::Error::none;
+    }
+
+    // the statistics of the hot loops, nothing without collect_statistics
+    template<bool collect_statistics>
+    void count_literal(sel::Inflate_statistics* statistics) noexcept
+    {
+        if constexpr(collect_statistics) { ++statistics->literals; }
+    }
+
+    template<bool collect_statistics>
+    void count_match(sel::Inflate_statistics* statistics, const std::uint32_t length_symbol, const std::uint32_t distance_symbol, const std::uint32_t length) noexcept
+    {
+        if constexpr(collect_statistics) {
+            ++statistics->matches;
+            statistics->match_bytes += length;
+            ++statistics->length_histogram[length_symbol];
+            ++statistics->distance_histogram[distance_symbol];
+        }
+    }
+
+    /* reading the cycle counter costs about as much as a short copy, so only one match out of
+    * copy_sampling_interval is timed and it counts for the ones that weren't. After count_match */
+    constexpr std::uint64_t copy_sampling_interval {16u};
+
+    template<bool collect_statistics>
+    void timed_lz77_copy(std::uint8_t* output, const std::uint32_t length, const std::uint32_t distance, sel::Inflate_statistics* statistics) noexcept
+    {
+        if constexpr(collect_statistics) {
+            if(statistics->matches % copy_sampling_interval == 0u) {
+                const std::uint64_t start {sel::impl::read_cycle_counter()};
+                sel::impl::deflate::lz77_copy(output, length, distance);
+                statistics->copying_cycles += (sel::impl::read_cycle_counter() - start) * copy_sampling_interval;
+                return;
+            }
+        }
+        sel::impl::deflate::lz77_copy(output, length, distance);
+    }
+}
+
+template<typename Literal_length_table, typename Distance_table, bool collect_statistics>
+sel::impl::deflate::Inflate_status sel::impl::deflate::decompress_huffman_block(Output_buffer& output, Deflate_bitstream& bitstream, const Literal_length_table& literal_length_alphabet, const Distance_table& distance_alphabet,
+    [[maybe_unused]] Inflate_statistics* statistics)
+{
+    /* fast loop: while a whole literal/length + distance sequence fits in the bit buffer after a refill
+    * and there is room for the longest match, only the codes themselves are checked */
+    while(bitstream.bits_left() >= max_bits_per_sequence) {
+        if(not output.reserve(max_match_length + max_lz77_copy_overrun)) break;
+        bitstream.refill();
+
+        std::uint32_t symbol {fetch_buffered_symbol(literal_length_alphabet, bitstream)};
         if(symbol < 256u) {
-            inflated_data.push_back(static_cast<std::uint8_t>(symbol));
+            output.data[output.size] = static_cast<std::uint8_t>(symbol);
+            ++output.size;
+            count_literal<collect_statistics>(statistics);
+            continue;
         }
-        else {
-            if(distance_alphabet.empty()) throw Exception {Error::bad_formed_data};
-            if(symbol > 285u) throw Exception {Error::bad_formed_data};
-            symbol -= 257u;
-            const std::uint32_t length {length_bases[symbol] + bitstream.read_bits(length_extra_bits[symbol])};
-            if(length > 258u) throw Exception {Error::bad_formed_data};
-
-            symbol = fetch_symbol_in_dynamic_block(distance_alphabet, bitstream);
-            if(symbol > 29u) throw Exception {Error::bad_formed_data};
-            const std::uint32_t distance {distance_bases[symbol] + bitstream.read_bits(distance_extra_bits[symbol])};
-            if(distance > inflated_data.size() or distance > 32768u) throw Exception {Error::bad_formed_data};
-
-            lz77_copy(inflated_data, length, distance);
+        if(symbol == 256u) return Inflate_status::done;
+        if(symbol > 285u) return Inflate_status::bad_formed_data; // invalid_symbol too
+
+        const std::uint32_t length_symbol {symbol - 257u};
+        const std::uint32_t length {length_bases[length_symbol] + bitstream.peek_bits(length_extra_bits[length_symbol])};
+        bitstream.consume_bits(length_extra_bits[length_symbol]);
+
+        symbol = fetch_buffered_symbol(distance_alphabet, bitstream);
+        if(symbol > 29u) return Inflate_status::bad_formed_data;
+        const std::uint32_t distance {distance_bases[symbol] + bitstream.peek_bits(distance_extra_bits[symbol])};
+        bitstream.consume_bits(distance_extra_bits[symbol]);
+        if(distance > output.size) return Inflate_status::bad_formed_data;
+
+        count_match<collect_statistics>(statistics, length_symbol, symbol, length);
+        timed_lz77_copy<collect_statistics>(output.data + output.size, length, distance, statistics);
+        output.size += length;
+    }
+
+    /* the last few symbols of the input or of the room in the output, every read is checked. A symbol
+    * that can't be read whole or doesn't fit is left in the bit-stream */
+    while(true) {
+        const Deflate_bitstream saved {bitstream};
+        std::uint32_t symbol {0u};
+        std::uint32_t length {0u};
+        std::uint32_t distance_symbol {0u};
+        std::uint32_t distance {0u};
+        const Error error {read_sequence(bitstream, literal_length_alphabet, distance_alphabet, output.size, symbol, length, distance_symbol, distance)};
+        if(error == Error::unexpected_eof) {
+            bitstream = saved;
+            return Inflate_status::needs_input;
         }
+        if(error != Error::none) return Inflate_status::bad_formed_data;
 
-        symbol = fetch_symbol_in_dynamic_block(literal_length_alphabet, bitstream);
+        if(symbol == 256u) return Inflate_status::done;
+        if(symbol < 256u) {
+            if(not output.reserve(1u)) {
+                bitstream = saved;
+                return Inflate_status::needs_output;
+            }
+            output.data[output.size] = static_cast<std::uint8_t>(symbol);
+            ++output.size;
+            count_literal<collect_statistics>(statistics);
+        }
+        else if(output.reserve(length + max_lz77_copy_overrun)) {
+            count_match<collect_statistics>(statistics, symbol - 257u, distance_symbol, length);
+            timed_lz77_copy<collect_statistics>(output.data + output.size, length, distance, statistics);
+            output.size += length;
+        }
+        else {
+            // without room for the overrun of lz77_copy
+            if(output.capacity - output.size < length) {
+                bitstream = saved;
+                return Inflate_status::needs_output;
+            }
+            count_match<collect_statistics>(statistics, symbol - 257u, distance_symbol, length);
+            for(std::uint32_t i = 0u; i < length; ++i) {
+                output.data[output.size] = output.data[output.size - distance];
+                ++output.size;
+            }
+        }
     }
 }
 
-std::vector<sel::impl::deflate::Huffman_code> sel::impl::deflate::make_fixed_huffman_table()
+template sel::impl::deflate::Inflate_status sel::impl::deflate::decompress_huffman_block(Output_buffer&, Deflate_bitstream&, const Huffman_table&, const Huffman_table&, Inflate_statistics*);
+template sel::impl::deflate::Inflate_status sel::impl::deflate::decompress_huffman_block(Output_buffer&, Deflate_bitstream&, const Fixed_huffman_table<9u>&, const Fixed_huffman_table<5u>&, Inflate_statistics*);
+template sel::impl::deflate::Inflate_status sel::impl::deflate::decompress_huffman_block<sel::impl::deflate::Huffman_table, sel::impl::deflate::Huffman_table, true>(
+    Output_buffer&, Deflate_bitstream&, const Huffman_table&, const Huffman_table&, Inflate_statistics*);
+template sel::impl::deflate::Inflate_status sel::impl::deflate::decompress_huffman_block<sel::impl::deflate::Fixed_huffman_table<9u>, sel::impl::deflate::Fixed_huffman_table<5u>, true>(
+    Output_buffer&, Deflate_bitstream&, const Fixed_huffman_table<9u>&, const Fixed_huffman_table<5u>&, Inflate_statistics*);
+
+sel::Error sel::impl::deflate::make_huffman_table_from_bit_lengths(Huffman_table& huffman_table, std::span<const std::uint32_t> bit_lengths, const std::uint32_t primary_bits) noexcept
 {
+    if(bit_lengths.size() > 288u) return Error::bug;
+
     // bl_count[7 (for example)] == number of codes that have 7 bits
-    /*
-    constexpr std::array<std::uint32_t, 10> bl_count {
-        0u, 0u, 0u, 0u, 0u, 0u, 0u, 24u, 152u, 112u
-    };
-    */
+    std::array<std::uint32_t, 16> bl_count {};
+    std::uint32_t max_bit_length {0u};
+    for(const std::uint32_t bit_length : bit_lengths) {
+        if(bit_length > 15u) return Error::bad_formed_data;
+        bl_count[bit_length] += 1u;
+        max_bit_length = std::max(max_bit_length, bit_length);
+    }
+    bl_count[0] = 0u;
 
-    std::vector<std::uint32_t> bit_lengths;
-    bit_lengths.reserve(288);
-    for(int i = 0; i < 144; ++i) { bit_lengths.push_back(8u); }
-    for(int i = 144; i < 256; ++i) { bit_lengths.push_back(9u); }
-    for(int i = 256; i < 280; ++i) { bit_lengths.push_back(7u); }
-    for(int i = 280; i < 288; ++i) { bit_lengths.push_back(8u); }
-
-    // generate the codes for each bit-length
-    std::vector<Huffman_code> huffman_codes;
-    huffman_codes.reserve(288);
-    std::uint32_t code {0u}; // the smallest valid code
-    for(std::uint32_t i = 7; i < 10; ++i) {
-        for(std::size_t j = 0u; j < bit_lengths.size(); ++j) {
-            if(bit_lengths[j] != i) continue;
-
-            huffman_codes.emplace_back(code, i, static_cast<std::uint32_t>(j));
-            // within a bit-length, the codes are assigned consecutive values
-            ++code;
-        }
+    /* over-subscribed sets of bit-lengths can't be decoded. Incomplete sets are only allowed when there is
+    * a single code of one bit (RFC 1951 allows it for the distance alphabet), the bits that don't match it
+    * remain invalid entries in the table */
+    std::int32_t codes_left {1};
+    for(std::uint32_t i = 1u; i < 16u; ++i) {
+        codes_left = (codes_left << 1) - static_cast<std::int32_t>(bl_count[i]);
+        if(codes_left < 0) return Error::bad_formed_data;
+    }
+    if(codes_left > 0 and max_bit_length > 1u) return Error::bad_formed_data;
 
+    // the smallest code of each bit-length
+    std::array<std::uint32_t, 16> next_code {};
+    std::uint32_t code {0u};
+    for(std::uint32_t i = 1u; i < 16u; ++i) {
         // an extra bit must be added just before going to the next bit-length
-        code <<= 1u;
+        code = (code + bl_count[i - 1u]) << 1u;
+        next_code[i] = code;
     }
 
-    return huffman_codes;
-}
+    /* the codes are put in the table bit-reversed because that's the order in which they come out
+    * of the bit-stream, within a bit-length the codes are assigned consecutive values */
+    std::array<std::uint16_t, 288> reversed_codes {};
+    for(std::size_t i = 0u; i < bit_lengths.size(); ++i) {
+        if(bit_lengths[i] == 0u) continue;
+        reversed_codes[i] = static_cast<std::uint16_t>(bitswap_from_lsbit(next_code[bit_lengths[i]], bit_lengths[i]));
+        ++next_code[bit_lengths[i]];
+    }
 
-std::uint32_t sel::impl::deflate::fetch_symbol_in_fixed_block(const std::vector<Huffman_code>& huffman_codes, Deflate_bitstream& bitstream)
-{
-    for(int i = 7; i < 10; ++i) {
-        std::uint32_t code {bitstream.peek_bits(i)};
-        code = bitswap_from_lsbit(code, i);
-
-        for(const Huffman_code hc : huffman_codes) {
-            if(hc.bit_length == i and hc.code == code) {
-                bitstream.skip_bits(i);
-                return hc.symbol;
+    huffman_table.primary_bits = primary_bits;
+    const std::uint32_t primary_size {1u << primary_bits};
+    const std::uint32_t primary_mask {primary_size - 1u};
+
+    // each sub-table is as big as the longest code that starts with its primary bits needs
+    std::array<std::uint8_t, 1u << 10u> longest_code_per_prefix {};
+    if(primary_bits > 10u) return Error::bug;
+    for(std::size_t i = 0u; i < bit_lengths.size(); ++i) {
+        if(bit_lengths[i] <= primary_bits) continue;
+        std::uint8_t& longest {longest_code_per_prefix[reversed_codes[i] & primary_mask]};
+        longest = std::max(longest, static_cast<std::uint8_t>(bit_lengths[i]));
+    }
+
+    // the entries of the previous table that aren't overwritten must become invalid
+    std::fill(huffman_table.entries.begin(), huffman_table.entries.begin() + primary_size, Huffman_entry {});
+    std::size_t next_subtable {primary_size};
+    for(std::uint32_t i = 0u; i < primary_size; ++i) {
+        if(longest_code_per_prefix[i] == 0u) continue;
+
+        const std::uint32_t subtable_bits {longest_code_per_prefix[i] - primary_bits};
+        if(next_subtable + (std::size_t {1u} << subtable_bits) > huffman_table.entries.size()) {
+            return Error::bad_formed_data;
+        }
+        huffman_table.entries[i].value = static_cast<std::uint16_t>(next_subtable);
+        huffman_table.entries[i].subtable_bits = static_cast<std::uint8_t>(subtable_bits);
+        next_subtable += std::size_t {1u} << subtable_bits;
+    }
+    std::fill(huffman_table.entries.begin() + primary_size, huffman_table.entries.begin() + next_subtable, Huffman_entry {});
+
+    // every index whose low bits are the (reversed) code decodes to the same symbol
+    for(std::size_t i = 0u; i < bit_lengths.size(); ++i) {
+        const std::uint32_t bit_length {bit_lengths[i]};
+        if(bit_length == 0u) continue;
+
+        const Huffman_entry entry {static_cast<std::uint16_t>(i), static_cast<std::uint8_t>(bit_length), 0u};
+        if(bit_length <= primary_bits) {
+            for(std::uint32_t j = reversed_codes[i]; j < primary_size; j += (1u << bit_length)) {
+                huffman_table.entries[j] = entry;
+            }
+        }
+        else {
+            const Huffman_entry subtable {huffman_table.entries[reversed_codes[i] & primary_mask]};
+            const std::uint32_t subtable_size {1u << subtable.subtable_bits};
+            for(std::uint32_t j = reversed_codes[i] >> primary_bits; j < subtable_size; j += (1u << (bit_length - primary_bits))) {
+                huffman_table.entries[subtable.value + j] = entry;
             }
         }
     }
 
-    throw Exception {Error::bad_formed_data};
+    return Error::none;
 }
 
-std::vector<sel::impl::deflate::Huffman_code> sel::impl::deflate::make_huffman_codes_from_bit_lengths(std::span<const std::uint32_t> bit_lengths)
+sel::Error sel::impl::deflate::fetch_symbol(const Huffman_table& huffman_table, Deflate_bitstream& bitstream, std::uint32_t& symbol) noexcept
 {
-    auto iter {std::max_element(bit_lengths.begin(), bit_lengths.end())};
-    // bl_count[7 (for example)] == number of codes that have 7 bits
-    std::vector<std::uint32_t> bl_count;
-    bl_count.resize(*iter + 1u);
+    // the bits past the end of the bit-stream are peeked as zeros, so the code may need bits that it doesn't have
+    const std::uint32_t bits {bitstream.peek_bits(15u)};
 
-    // count the number of codes for each bit-length
-    for(std::size_t i = 0u; i < bit_lengths.size(); ++i) {
-        bl_count[bit_lengths[i]] += 1u;
+    Huffman_entry entry {huffman_table.entries[bits & ((1u << huffman_table.primary_bits) - 1u)]};
+    if(entry.subtable_bits != 0u) {
+        entry = huffman_table.entries[entry.value + ((bits >> huffman_table.primary_bits) & ((1u << entry.subtable_bits) - 1u))];
     }
-
-    // generate the codes for each bit-length
-    std::vector<Huffman_code> huffman_codes;
-    std::uint32_t code {0u}; // the smallest valid code
-    for(std::uint32_t i = 1; i <= *iter; ++i) {
-        // an extra bit must be added just before going to the next bit-length
-        code <<= 1u;
-        /* the above "code <<= 1u;" must be before the below
-        * if(bl_count[i] == 0u) continue;" because there can be bl_counts that
-        * are equal to zero between bl_counts that aren't, and the left-shift
-        * must still be done
-        */
-        if(bl_count[i] == 0u) continue;
-
-        for(std::size_t j = 0u; j < bit_lengths.size(); ++j) {
-            if(bit_lengths[j] != i) continue;
-
-            huffman_codes.emplace_back(code, i, static_cast<std::uint32_t>(j));
-            // within a bit-length, the codes are assigned consecutive values
-            ++code;
-        }
+    if(entry.bit_length == 0u) {
+        // it may be a valid code that continues in bits that the bit-stream doesn't have yet
+        return bitstream.bits_left() < 15u ? Error::unexpected_eof : Error::bad_formed_data;
     }
+    if(bitstream.bits_left() < entry.bit_length) return Error::unexpected_eof;
 
-    return huffman_codes;
+    bitstream.consume_bits(entry.bit_length);
+    symbol = entry.value;
+    return Error::none;
 }
 
-std::uint32_t sel::impl::deflate::fetch_symbol_in_dynamic_block(const std::vector<Huffman_code>& huffman_codes, Deflate_bitstream& bitstream)
+std::uint32_t sel::impl::deflate::fetch_buffered_symbol(const Huffman_table& huffman_table, Deflate_bitstream& bitstream) noexcept
 {
-    for(std::uint32_t i = 1u; i < 16u; ++i) {
-        std::uint32_t code {bitstream.peek_bits(i)};
-        code = bitswap_from_lsbit(code, i);
+    const std::uint32_t bits {bitstream.peek_bits(15u)};
 
-        for(const Huffman_code hc : huffman_codes) {
-            if(hc.bit_length == i and hc.code == code) {
-                bitstream.skip_bits(i);
-                return hc.symbol;
-            }
-        }
+    Huffman_entry entry {huffman_table.entries[bits & ((1u << huffman_table.primary_bits) - 1u)]};
+    if(entry.subtable_bits != 0u) {
+        entry = huffman_table.entries[entry.value + ((bits >> huffman_table.primary_bits) & ((1u << entry.subtable_bits) - 1u))];
     }
 
-    throw Exception {Error::bad_formed_data};
+    bitstream.consume_bits(entry.bit_length);
+    return entry.value;
 }
 
-void sel::impl::deflate::lz77_copy(std::vector<std::uint8_t>& inflated_data, const std::uint32_t length, const std::uint32_t distance)
+void sel::impl::deflate::lz77_copy(std::uint8_t* output, const std::uint32_t length, const std::uint32_t distance) noexcept
 {
-    const std::size_t beginning_of_copy {inflated_data.size() - distance};
-    std::size_t copy_from {beginning_of_copy};
-
-    inflated_data.reserve(inflated_data.size() + length);
-    for(std::uint32_t i = 0u; i < length; ++i) {
-        const std::uint8_t value_to_copy {inflated_data[copy_from]};
-        inflated_data.push_back(value_to_copy);
-        ++copy_from;
-        if(copy_from == inflated_data.size()) {
-            copy_from = beginning_of_copy;
+    const std::uint8_t* source {output - distance};
+    const std::uint8_t* const end {output + length};
+
+    /* every chunk is written whole, so up to max_lz77_copy_overrun bytes after 'end' are overwritten.
+    * The source and the destination overlap when the distance is shorter than the length, but a chunk
+    * never reads bytes that it writes itself as long as it isn't wider than the distance */
+    if(distance >= 32u) {
+        do {
+            std::memcpy(output, source, 32u);
+            output += 32u;
+            source += 32u;
+        } while(output < end);
+    }
+    else if(distance == 1u or distance == 2u or distance == 4u) {
+        /* the repetitions fit exactly in 8 bytes, they are broadcast with a multiplication. It puts the
+        * first byte at the lowest address only on little endian, elsewhere the pattern is built byte by byte */
+        std::uint64_t pattern {0u};
+        if constexpr(std::endian::native == std::endian::little) {
+            std::memcpy(&pattern, source, distance);
+            if(distance == 1u) { pattern *= 0x0101010101010101u; }
+            else if(distance == 2u) { pattern *= 0x0001000100010001u; }
+            else { pattern *= 0x0000000100000001u; }
+        }
+        else {
+            std::uint8_t bytes[8];
+            for(std::uint32_t i = 0u; i < 8u; ++i) { bytes[i] = source[i % distance]; }
+            std::memcpy(&pattern, bytes, 8u);
         }
+
+        do {
+            std::memcpy(output, &pattern, 8u);
+            std::memcpy(output + 8u, &pattern, 8u);
+            std::memcpy(output + 16u, &pattern, 8u);
+            std::memcpy(output + 24u, &pattern, 8u);
+            output += 32u;
+        } while(output < end);
     }
-}
+    else {
+        /* the data repeats every 'distance' bytes: the repetitions are broadcast to a buffer once, and
+        * each chunk writes as many whole repetitions as fit in 32 bytes. Copying from the bytes that
+        * were just written would stall on store-to-load forwarding instead */
+        std::uint8_t pattern[64];
+        std::memcpy(pattern, source, distance);
+        for(std::uint32_t filled = distance; filled < 32u; filled *= 2u) {
+            std::memcpy(pattern + filled, pattern, filled);
+        }
+
+        const std::uint32_t step {32u - 32u % distance};
+        do {
+            std::memcpy(output, pattern, 32u);
+            output += step;
+        } while(output < end);
+    }
+}
\ No newline at end of file
@@ -5,9 +5,73 @@
 #include <vector>
 #include <array>
 #include <compare>
+#include <algorithm>
+#include <functional>
 
 namespace sel {
-    std::vector<std::uint8_t> decompress_deflate(std::span<const std::uint8_t> deflate_data);
+    // 'size_hint' is the expected size of the decompressed data, zero if it isn't known
+    std::vector<std::uint8_t> decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint = 0u);
+    /* decompresses into 'output' without allocating and returns the amount of bytes written, throws
+    * Error::output_too_small if the decompressed data doesn't fit */
+    std::size_t decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output);
+
+    /* the same without exceptions: malformed or truncated data, an output that is too small or running out of memory
+    * are returned as a Decode_error, which is much cheaper than a throw when corrupt input is common */
+    Expected<std::vector<std::uint8_t>> try_decompress_deflate(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint = 0u) noexcept;
+    Expected<std::size_t> try_decompress_deflate(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output) noexcept;
+
+    // how often the header of a dynamic block was the same as one of the last few, so its tables were reused
+    struct Table_cache_statistics {
+        std::uint64_t hits {0u};
+        std::uint64_t misses {0u};
+    };
+
+    /* what the decompression of a stream did and where the time went. The cycles are the ones of
+    * impl::read_cycle_counter (nanoseconds outside x86), the copies of the matches are estimated from a sample */
+    struct Inflate_statistics {
+        struct Blocks {
+            std::uint64_t count {0u};
+            std::uint64_t compressed_bits {0u}; // with the headers
+            std::uint64_t decompressed_bytes {0u};
+        };
+
+        Blocks stored_blocks;
+        Blocks fixed_blocks;
+        Blocks dynamic_blocks;
+
+        std::uint64_t literals {0u};
+        std::uint64_t matches {0u};
+        std::uint64_t match_bytes {0u};
+        // by symbol: length symbols 257~285 are 0~28, see impl::deflate::length_bases and distance_bases
+        std::array<std::uint64_t, 29> length_histogram {};
+        std::array<std::uint64_t, 30> distance_histogram {};
+
+        std::uint64_t table_building_cycles {0u}; // the headers of dynamic blocks, cached tables or not
+        std::uint64_t decoding_cycles {0u}; // the Huffman blocks without their copies
+        std::uint64_t copying_cycles {0u}; // the matches and the stored blocks
+        std::uint64_t total_cycles {0u};
+        std::uint64_t nanoseconds {0u};
+
+        std::size_t compressed_bytes {0u}; // read, up to the end of the stream or to the error
+        std::size_t decompressed_bytes {0u};
+        Error error {Error::none};
+
+        double bytes_per_cycle() const noexcept
+        {
+            return total_cycles == 0u ? 0.0 : static_cast<double>(decompressed_bytes) / static_cast<double>(total_cycles);
+        }
+    };
+
+    // the same as decompress_deflate, collecting the statistics of the stream (on errors too)
+    std::vector<std::uint8_t> decompress_deflate(std::span<const std::uint8_t> deflate_data, Inflate_statistics& statistics, const std::size_t size_hint = 0u);
+
+    using Inflate_statistics_callback = std::function<void(const Inflate_statistics&)>;
+    /* from now on, 'callback' gets the statistics of every stream decompressed by decompress_deflate or
+    * try_decompress_deflate (also the ones of a Decompressor), in the thread that decompressed it. It must
+    * not throw (try_decompress_deflate returns Error::bug if it does), and an empty callback stops it.
+    * Without a callback, the only cost is checking for one once per stream, the statistics are collected
+    * by their own instantiation of the hot loops */
+    void set_inflate_statistics_callback(Inflate_statistics_callback callback);
 }
 
 namespace sel::impl::deflate {
@@ -36,29 +100,261 @@ namespace sel::impl::deflate {
         7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
     };
 
-    struct Huffman_code {
-        Huffman_code() noexcept {}
-        // just for emplace_back
-        Huffman_code(std::uint32_t a_code, std::uint32_t a_bit_length, std::uint32_t a_symbol) noexcept : code {a_code}, bit_length {a_bit_length}, symbol {a_symbol} {}
+    // the order of slots with which to place the bit-lengths of the codes of the code bit-length alphabet
+    constexpr std::array<std::uint32_t, 19> code_length_order {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+    };
 
-        std::uint32_t code {0u};
-        std::uint32_t bit_length {0u};
-        std::uint32_t symbol {0u};
+    /* the tables are indexed by the next 'primary_bits' bits of the bit-stream (as they come out of it,
+    * that is, with the Huffman codes bit-reversed), codes longer than that continue in a sub-table that
+    * is stored after the primary table. The sizes are the worst cases for the chosen primary_bits
+    * (computed with zlib's "enough" program) */
+    constexpr std::uint32_t literal_length_primary_bits {9u};
+    constexpr std::uint32_t distance_primary_bits {6u};
+    constexpr std::uint32_t code_length_primary_bits {7u}; // no code of the code-length alphabet is longer than 7 bits
+    constexpr std::size_t huffman_table_capacity {852u}; // literal+length: 852, distance: 592, code-length: 128
+
+    // the value of the entries of bits that aren't the prefix of any code, no alphabet has that many symbols
+    constexpr std::uint32_t invalid_symbol {0xFFFFu};
+
+    struct Huffman_entry {
+        std::uint16_t value {invalid_symbol}; // the symbol, or the offset of the sub-table when subtable_bits isn't zero
+        std::uint8_t bit_length {0u}; // zero means that the bits aren't the prefix of any code
+        std::uint8_t subtable_bits {0u};
+    };
+
+    struct Huffman_table {
+        std::array<Huffman_entry, huffman_table_capacity> entries {};
+        std::uint32_t primary_bits {0u};
+    };
+
+    /* the tables of dynamic blocks. Many encoders write the same header block after block, so the tables of
+    * the last few headers are kept with their bit-lengths and a header that matches one of them reuses them */
+    struct Dynamic_tables {
+        static constexpr std::size_t cache_size {4u};
+
+        struct Cached_tables {
+            bool valid {false}; // false while the tables are being built
+            std::uint64_t hash {0u};
+            std::uint32_t hlit {0u};
+            std::uint32_t hdist {0u};
+            std::array<std::uint32_t, 286u + 30u> bit_lengths {}; // of both alphabets, as they come in the header
+            Huffman_table literal_length_alphabet;
+            Huffman_table distance_alphabet;
+        };
+
+        const Huffman_table& literal_length_alphabet() const noexcept { return cache[current].literal_length_alphabet; }
+        const Huffman_table& distance_alphabet() const noexcept { return cache[current].distance_alphabet; }
+
+        Huffman_table code_length_alphabet;
+        std::array<Cached_tables, cache_size> cache;
+        std::size_t current {0u}; // the tables of the last header that was read
+        std::size_t next_replaced {0u}; // the oldest tables
+        Table_cache_statistics statistics;
     };
 
     using Deflate_bitstream = Bitstream<Bitstream_format::gif>;
 
-    void decompress_uncompressed(std::vector<std::uint8_t>& inflated_data, Deflate_bitstream& bitstream);
-    void decompress_fixed(std::vector<std::uint8_t>& inflated_data, Deflate_bitstream& bitstream);
-    void decompress_dynamic(std::vector<std::uint8_t>& inflated_data, Deflate_bitstream& bitstream);
+    /* the inflated data is written to 'data' and 'size' counts it, the bytes between 'size' and 'capacity'
+    * are room for the hot loops to write without checking every byte. With a vector, 'data' is the buffer
+    * of the vector and it grows with it, otherwise the room is all there is */
+    struct Output_buffer {
+        // makes room for at least 'amount' more bytes after 'size', false if there isn't and it can't grow
+        bool reserve(const std::size_t amount)
+        {
+            if(capacity - size >= amount) return true;
+            if(vector == nullptr) return false;
 
-    std::vector<Huffman_code> make_fixed_huffman_table(); // for literals and lengths
-    // used in decompress_dynamic
-    std::vector<Huffman_code> make_huffman_codes_from_bit_lengths(std::span<const std::uint32_t> bit_lengths);
+            vector->resize(std::max(vector->size() * 2u, vector_offset + size + amount));
+            data = vector->data() + vector_offset;
+            capacity = vector->size() - vector_offset;
+            return true;
+        }
+
+        std::uint8_t* data {nullptr};
+        std::size_t size {0u};
+        std::size_t capacity {0u};
+        std::vector<std::uint8_t>* vector {nullptr};
+        std::size_t vector_offset {0u}; // where 'data' starts in the vector, the bytes before it aren't part of the output
+    };
+
+    // the longest match and the most bits that a literal/length symbol followed by a distance symbol can take
+    constexpr std::uint32_t max_match_length {258u};
+    constexpr std::uint32_t max_bits_per_sequence {15u + 5u + 15u + 13u};
+    // the farthest that a distance can reach
+    constexpr std::size_t window_size {32768u};
+    /* the most that deflate data can expand: a match of 258 bytes takes 2 bits at best, so a size read from
+    * a header can be checked against it before it's used to allocate */
+    constexpr std::size_t max_deflate_ratio {1032u};
+
+    enum class Inflate_status {
+        done, // the end of the block or of the stream
+        needs_input,
+        needs_output,
+        block_boundary, // only with Inflate_state::stop_at_block_boundaries
+        bad_formed_data // the bit-stream is left near where the data stopped making sense
+    };
 
-    // for literals and lengths (fetch_symbol_in_fixed_block)
-    std::uint32_t fetch_symbol_in_fixed_block(const std::vector<Huffman_code>& huffman_codes, Deflate_bitstream& bitstream);
-    std::uint32_t fetch_symbol_in_dynamic_block(const std::vector<Huffman_code>& huffman_codes, Deflate_bitstream& bitstream);
+    // where a resumable decompression is, see inflate
+    struct Inflate_state {
+        enum class Step { block_header, stored_block, huffman_block, done };
 
-    void lz77_copy(std::vector<std::uint8_t>& inflated_data, const std::uint32_t length, const std::uint32_t distance);
+        Step step {Step::block_header};
+        // inflate returns between blocks too, the only places where the state is just the bit-stream and the history
+        bool stop_at_block_boundaries {false};
+        bool last_block {false};
+        bool fixed_block {false};
+        std::uint32_t stored_bytes_left {0u};
+    };
+
+    /* decompresses until the stream ends, the bit-stream runs out or the output doesn't have room. When the
+    * bit-stream ends in the middle of a block header or a symbol, it's left before them, so the
+    * decompression can continue with more input. 'tables' go with 'state', they hold the ones of the
+    * current dynamic block */
+    Inflate_status inflate(Inflate_state& state, Dynamic_tables& tables, Output_buffer& output, Deflate_bitstream& bitstream);
+
+    /* the functions below report errors instead of throwing them, Error::unexpected_eof when the bit-stream
+    * ends too soon. Only growing the output of a vector can throw (std::bad_alloc) */
+    Error read_block_header(Inflate_state& state, Dynamic_tables& tables, Deflate_bitstream& bitstream) noexcept;
+
+    /* the whole stream at once, the tables are only scratch space. Without 'statistics', they are collected
+    * anyway for the callback if there is one. Besides growing the vector, only the callback can throw */
+    Expected<std::vector<std::uint8_t>> decompress_to_vector(std::span<const std::uint8_t> deflate_data, const std::size_t size_hint, Dynamic_tables& tables, Inflate_statistics* statistics = nullptr);
+    Expected<std::size_t> decompress_to_span(std::span<const std::uint8_t> deflate_data, std::span<std::uint8_t> output, Dynamic_tables& tables, Inflate_statistics* statistics = nullptr);
+
+    // 'last_block' is set once the header of the block is read. The statistics are only collected if there are
+    Error decompress_block(Output_buffer& output, Deflate_bitstream& bitstream, Dynamic_tables& tables, bool& last_block, Inflate_statistics* statistics = nullptr);
+    Error decompress_uncompressed(Output_buffer& output, Deflate_bitstream& bitstream, Inflate_statistics* statistics = nullptr);
+    Error decompress_fixed(Output_buffer& output, Deflate_bitstream& bitstream, Inflate_statistics* statistics = nullptr);
+    Error decompress_dynamic(Output_buffer& output, Deflate_bitstream& bitstream, Dynamic_tables& tables, Inflate_statistics* statistics = nullptr);
+    // makes the tables of the header current, building them only if they aren't cached
+    Error read_dynamic_huffman_tables(Deflate_bitstream& bitstream, Dynamic_tables& tables) noexcept;
+    /* the loop of both fixed and dynamic blocks, done means the end of the block. When it runs out of input
+    * or output, it stops before the symbol that it couldn't decode or write. It's instantiated for the
+    * tables of dynamic blocks (Huffman_table) and for the ones of fixed blocks (Fixed_huffman_table), and
+    * with collect_statistics for the symbols and the copies, which then go to 'statistics' */
+    template<typename Literal_length_table, typename Distance_table, bool collect_statistics = false>
+    Inflate_status decompress_huffman_block(Output_buffer& output, Deflate_bitstream& bitstream, const Literal_length_table& literal_length_alphabet, const Distance_table& distance_alphabet,
+        Inflate_statistics* statistics = nullptr);
+
+    // used in read_dynamic_huffman_tables, only the entries that the new table uses are overwritten
+    Error make_huffman_table_from_bit_lengths(Huffman_table& huffman_table, std::span<const std::uint32_t> bit_lengths, const std::uint32_t primary_bits) noexcept;
+
+    /* the codes of fixed blocks are never longer than 9 bits (literal+length) and 5 bits (distance), so their
+    * tables have an entry for every value of those bits and no sub-tables, and every entry is valid */
+    template<std::uint32_t bits>
+    struct Fixed_huffman_table {
+        std::array<Huffman_entry, std::size_t {1u} << bits> entries {};
+    };
+
+    template<std::uint32_t bits, std::size_t symbols>
+    constexpr Fixed_huffman_table<bits> make_fixed_huffman_table(const std::array<std::uint8_t, symbols>& bit_lengths)
+    {
+        std::array<std::uint32_t, bits + 1u> bl_count {};
+        for(const std::uint8_t bit_length : bit_lengths) { ++bl_count[bit_length]; }
+
+        std::array<std::uint32_t, bits + 1u> next_code {};
+        std::uint32_t code {0u};
+        for(std::uint32_t i = 1u; i <= bits; ++i) {
+            code = (code + bl_count[i - 1u]) << 1u;
+            next_code[i] = code;
+        }
+
+        Fixed_huffman_table<bits> huffman_table;
+        for(std::size_t i = 0u; i < symbols; ++i) {
+            const std::uint32_t bit_length {bit_lengths[i]};
+            const Huffman_entry entry {static_cast<std::uint16_t>(i), static_cast<std::uint8_t>(bit_length), 0u};
+            for(std::uint32_t j = bitswap_from_lsbit(next_code[bit_length], bit_length); j < huffman_table.entries.size(); j += 1u << bit_length) {
+                huffman_table.entries[j] = entry;
+            }
+            ++next_code[bit_length];
+        }
+        return huffman_table;
+    }
+
+    // literal+length symbols 286 and 287 and distance symbols 30 and 31 have codes but never occur in the data
+    constexpr Fixed_huffman_table<9u> fixed_literal_length_alphabet {make_fixed_huffman_table<9u>([] {
+        std::array<std::uint8_t, 288> bit_lengths {};
+        for(std::size_t i = 0u; i < 288u; ++i) { bit_lengths[i] = i < 144u ? 8u : i < 256u ? 9u : i < 280u ? 7u : 8u; }
+        return bit_lengths;
+    }())};
+
+    constexpr Fixed_huffman_table<5u> fixed_distance_alphabet {make_fixed_huffman_table<5u>([] {
+        std::array<std::uint8_t, 32> bit_lengths {};
+        bit_lengths.fill(5u);
+        return bit_lengths;
+    }())};
+
+    // one or two table lookups, Error::bad_formed_data if the bits aren't a code
+    Error fetch_symbol(const Huffman_table& huffman_table, Deflate_bitstream& bitstream, std::uint32_t& symbol) noexcept;
+    /* same as fetch_symbol, but the bit-stream must have been refilled and have enough bits buffered. Bits that
+    * aren't a code give invalid_symbol without consuming anything, the range checks of the symbols catch it */
+    std::uint32_t fetch_buffered_symbol(const Huffman_table& huffman_table, Deflate_bitstream& bitstream) noexcept;
+
+    // a single lookup without checking the entry
+    template<std::uint32_t bits>
+    Error fetch_symbol(const Fixed_huffman_table<bits>& huffman_table, Deflate_bitstream& bitstream, std::uint32_t& symbol) noexcept
+    {
+        // the bits past the end of the bit-stream are peeked as zeros, the code may need bits that it doesn't have
+        const Huffman_entry entry {huffman_table.entries[bitstream.peek_bits(bits)]};
+        if(bitstream.bits_left() < entry.bit_length) return Error::unexpected_eof;
+        bitstream.consume_bits(entry.bit_length);
+        symbol = entry.value;
+        return Error::none;
+    }
+
+    template<std::uint32_t bits>
+    std::uint32_t fetch_buffered_symbol(const Fixed_huffman_table<bits>& huffman_table, Deflate_bitstream& bitstream) noexcept
+    {
+        const Huffman_entry entry {huffman_table.entries[bitstream.peek_bits(bits)]};
+        bitstream.consume_bits(entry.bit_length);
+        return entry.value;
+    }
+
+    /* 'output' must have at least 'distance' bytes before it and room for 'length' + max_lz77_copy_overrun
+    * bytes after it, the bytes after 'length' are left with garbage */
+    constexpr std::uint32_t max_lz77_copy_overrun {32u};
+    void lz77_copy(std::uint8_t* output, const std::uint32_t length, const std::uint32_t distance) noexcept;
+}
+
+namespace sel {
+    /* decompresses a deflate stream that comes in pieces of any size into buffers of any size, keeping
+    * only the last 32KB of decompressed data as history (and some room to decompress into) */
+    class Inflater {
+    public:
+        struct Result {
+            std::size_t bytes_read {0u}; // from the input
+            std::size_t bytes_written {0u}; // to the output
+        };
+
+        Inflater();
+
+        /* reads 'input' and writes to 'output' until the input is all read, the output is full or the stream ends.
+        * The end of the input can be in the middle of anything, what can't be decompressed yet is kept
+        * for the next call. When the stream ends, the input after it isn't read */
+        Result inflate(std::span<const std::uint8_t> input, std::span<std::uint8_t> output);
+        /* the same without exceptions, for callers to whom bad data is one more outcome. The offset of the error
+        * is the input that was read before it, in this call */
+        Expected<Result> try_inflate(std::span<const std::uint8_t> input, std::span<std::uint8_t> output) noexcept;
+
+        // the stream ended and all its data was written
+        bool finished() const noexcept;
+        /* input that was kept for the next call but ended up being after the end of the stream, the bytes
+        * that follow it are the ones after 'bytes_read' of the last call */
+        std::span<const std::uint8_t> input_after_end() const noexcept;
+
+        Table_cache_statistics table_cache_statistics() const noexcept { return m_tables.statistics; }
+    private:
+        // the longest block header is around 600 bytes, anything shorter is decoded from the input directly
+        static constexpr std::size_t stash_capacity {1024u};
+
+        impl::deflate::Inflate_state m_state;
+        impl::deflate::Dynamic_tables m_tables;
+        std::vector<std::uint8_t> m_window; // the history, followed by data that isn't written to the caller yet
+        std::size_t m_window_used {0u};
+        std::size_t m_window_written {0u};
+        std::array<std::uint8_t, stash_capacity> m_stash; // the input that couldn't be decoded yet
+        std::size_t m_stash_size {0u};
+        std::uint32_t m_bit_offset {0u}; // the bits of the first byte of the input that were already read
+    };
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "deflate_index.hpp"
+#include "compressor.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    constexpr std::array<std::uint8_t, 4> index_signature {'S', 'D', 'X', '1'};
+
+    // the decompression of the index happens in a window like the one of Inflater, only its last 32KB are kept
+    constexpr std::size_t window_capacity {4u * sel::impl::deflate::window_size};
+
+    // keeps the last 32KB of the output at its beginning, returns how many bytes were dropped
+    std::size_t slide_window(sel::impl::deflate::Output_buffer& output) noexcept
+    {
+        const std::size_t history {std::min(output.size, sel::impl::deflate::window_size)};
+        const std::size_t dropped {output.size - history};
+        std::memmove(output.data, output.data + dropped, history);
+        output.size = history;
+        return dropped;
+    }
+
+    template<std::integral T>
+    void append_little_endian(std::vector<std::uint8_t>& output, const T value)
+    {
+        for(std::size_t i = 0u; i < sizeof(T); ++i) {
+            output.push_back(static_cast<std::uint8_t>(value >> (8u * i)));
+        }
+    }
+}
+
+sel::Deflate_index sel::Deflate_index::build(std::span<const std::uint8_t> deflate_data, const std::size_t spacing)
+{
+    Deflate_index index;
+    index.m_checkpoints.emplace_back();
+
+    impl::deflate::Inflate_state state;
+    impl::deflate::Dynamic_tables tables;
+    state.stop_at_block_boundaries = true;
+    impl::deflate::Deflate_bitstream bitstream {deflate_data};
+    std::vector<std::uint8_t> window(window_capacity);
+    impl::deflate::Output_buffer output {window.data(), 0u, window.size()};
+    std::uint64_t window_offset {0u}; // the offset of the window in the decompressed data
+
+    while(true) {
+        const impl::deflate::Inflate_status status {impl::deflate::inflate(state, tables, output, bitstream)};
+        if(status == impl::deflate::Inflate_status::done) break;
+        if(status == impl::deflate::Inflate_status::needs_input) throw Exception {Error::unexpected_eof};
+        if(status == impl::deflate::Inflate_status::bad_formed_data) throw Exception {Error::bad_formed_data};
+        if(status == impl::deflate::Inflate_status::needs_output) {
+            window_offset += slide_window(output);
+            continue;
+        }
+
+        const std::uint64_t output_offset {window_offset + output.size};
+        if(output_offset - index.m_checkpoints.back().output_offset < spacing) continue;
+
+        const std::size_t history {std::min(output.size, impl::deflate::window_size)};
+        index.m_checkpoints.push_back({
+            deflate_data.size() * 8u - bitstream.bits_left(),
+            output_offset,
+            static_cast<std::uint32_t>(history),
+            compress_deflate(std::span<const std::uint8_t> {output.data + output.size - history, history}, 1u)
+        });
+    }
+
+    index.m_uncompressed_size = window_offset + output.size;
+    return index;
+}
+
+sel::Deflate_index sel::Deflate_index::deserialize(std::span<const std::uint8_t> serialized_index)
+{
+    impl::Bytestream bytestream {serialized_index};
+    const std::span<const std::uint8_t> signature {bytestream.get_bytes(index_signature.size())};
+    if(not std::equal(signature.begin(), signature.end(), index_signature.begin())) throw Exception {Error::bad_formed_data};
+
+    Deflate_index index;
+    index.m_uncompressed_size = bytestream.get_from_little_endian<std::uint64_t>();
+    const std::uint64_t checkpoint_count {bytestream.get_from_little_endian<std::uint64_t>()};
+    // every checkpoint takes at least 24 bytes, a bad count can't make it allocate more than the index size
+    if(checkpoint_count == 0u or checkpoint_count > serialized_index.size() / 24u) throw Exception {Error::bad_formed_data};
+    index.m_checkpoints.resize(checkpoint_count);
+
+    for(std::size_t i = 0u; i < checkpoint_count; ++i) {
+        Checkpoint& checkpoint {index.m_checkpoints[i]};
+        checkpoint.input_bit_offset = bytestream.get_from_little_endian<std::uint64_t>();
+        checkpoint.output_offset = bytestream.get_from_little_endian<std::uint64_t>();
+        checkpoint.window_size = bytestream.get_from_little_endian<std::uint32_t>();
+        const std::uint32_t compressed_window_size {bytestream.get_from_little_endian<std::uint32_t>()};
+        if(compressed_window_size != 0u) {
+            const std::span<const std::uint8_t> compressed_window {bytestream.get_bytes(compressed_window_size)};
+            checkpoint.compressed_window.assign(compressed_window.begin(), compressed_window.end());
+        }
+
+        if(checkpoint.window_size > impl::deflate::window_size or checkpoint.window_size > checkpoint.output_offset) throw Exception {Error::bad_formed_data};
+        if(i != 0u and checkpoint.output_offset <= index.m_checkpoints[i - 1u].output_offset) throw Exception {Error::bad_formed_data};
+    }
+    if(index.m_checkpoints[0].output_offset != 0u) throw Exception {Error::bad_formed_data};
+
+    return index;
+}
+
+std::vector<std::uint8_t> sel::Deflate_index::serialize() const
+{
+    std::vector<std::uint8_t> serialized_index(index_signature.begin(), index_signature.end());
+    append_little_endian(serialized_index, m_uncompressed_size);
+    append_little_endian(serialized_index, static_cast<std::uint64_t>(m_checkpoints.size()));
+    for(const Checkpoint& checkpoint : m_checkpoints) {
+        append_little_endian(serialized_index, checkpoint.input_bit_offset);
+        append_little_endian(serialized_index, checkpoint.output_offset);
+        append_little_endian(serialized_index, checkpoint.window_size);
+        append_little_endian(serialized_index, static_cast<std::uint32_t>(checkpoint.compressed_window.size()));
+        serialized_index.insert(serialized_index.end(), checkpoint.compressed_window.begin(), checkpoint.compressed_window.end());
+    }
+
+    return serialized_index;
+}
+
+std::size_t sel::Deflate_index::read(std::span<const std::uint8_t> deflate_data, const std::uint64_t offset, std::span<std::uint8_t> output) const
+{
+    if(offset >= m_uncompressed_size or output.empty() or m_checkpoints.empty()) return 0u;
+
+    // the last checkpoint at or before the offset
+    const auto after {std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), offset, [](const std::uint64_t value, const Checkpoint& checkpoint) {
+        return value < checkpoint.output_offset;
+    })};
+    const Checkpoint& checkpoint {*(after - 1)};
+    if(checkpoint.input_bit_offset > deflate_data.size() * 8u) throw Exception {Error::bad_formed_data};
+
+    std::vector<std::uint8_t> window(window_capacity);
+    impl::deflate::Output_buffer window_buffer {window.data(), 0u, window.size()};
+    if(checkpoint.window_size != 0u) {
+        const std::span<std::uint8_t> history {window.data(), checkpoint.window_size};
+        if(decompress_deflate(checkpoint.compressed_window, history) != checkpoint.window_size) throw Exception {Error::bad_formed_data};
+        window_buffer.size = checkpoint.window_size;
+    }
+    std::uint64_t window_offset {checkpoint.output_offset - checkpoint.window_size};
+
+    impl::deflate::Inflate_state state;
+    impl::deflate::Dynamic_tables tables;
+    impl::deflate::Deflate_bitstream bitstream {deflate_data.subspan(static_cast<std::size_t>(checkpoint.input_bit_offset / 8u))};
+    bitstream.skip_bits(static_cast<std::uint32_t>(checkpoint.input_bit_offset % 8u));
+
+    const std::uint64_t end {offset + output.size()};
+    std::uint64_t written_until {offset};
+    while(written_until < end) {
+        const std::size_t new_data_start {window_buffer.size};
+        const impl::deflate::Inflate_status status {impl::deflate::inflate(state, tables, window_buffer, bitstream)};
+
+        // the part of the new data that was asked for
+        const std::uint64_t from {std::max(window_offset + new_data_start, written_until)};
+        const std::uint64_t to {std::min(window_offset + window_buffer.size, end)};
+        if(from < to) {
+            std::memcpy(output.data() + (from - offset), window.data() + (from - window_offset), static_cast<std::size_t>(to - from));
+            written_until = to;
+        }
+
+        if(status == impl::deflate::Inflate_status::done) break;
+        if(status == impl::deflate::Inflate_status::needs_input) throw Exception {Error::unexpected_eof};
+        if(status == impl::deflate::Inflate_status::bad_formed_data) throw Exception {Error::bad_formed_data};
+        window_offset += slide_window(window_buffer);
+    }
+
+    return static_cast<std::size_t>(written_until - offset);
+}
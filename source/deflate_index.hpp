@@ -0,0 +1,41 @@
+#pragma once
+
+#include "shared.hpp"
+#include "deflate.hpp"
+
+#include <vector>
+
+namespace sel {
+    /* points of a deflate stream where the decompression can start, so a piece from the middle of the
+    * decompressed data only costs the decompression from the point before it. The points are block
+    * boundaries at least 'spacing' bytes of decompressed data apart (more if the blocks are bigger) */
+    class Deflate_index {
+    public:
+        struct Checkpoint {
+            std::uint64_t input_bit_offset {0u}; // in the compressed data
+            std::uint64_t output_offset {0u}; // in the decompressed data
+            // the decompressed data before the checkpoint (up to 32KB), compressed to keep the index small
+            std::uint32_t window_size {0u};
+            std::vector<std::uint8_t> compressed_window;
+        };
+
+        // decompresses the whole stream once, the first checkpoint is the start of the stream
+        static Deflate_index build(std::span<const std::uint8_t> deflate_data, const std::size_t spacing = 1u << 20u);
+        // from the data that serialize returned
+        static Deflate_index deserialize(std::span<const std::uint8_t> serialized_index);
+
+        // little-endian integers, the offsets and the sizes of the checkpoints followed by their windows
+        std::vector<std::uint8_t> serialize() const;
+
+        /* decompresses output.size() bytes starting at 'offset' of the decompressed data, and returns the amount
+        * of bytes written (less than output.size() when the stream ends before). 'deflate_data' must be the stream
+        * that the index was built from */
+        std::size_t read(std::span<const std::uint8_t> deflate_data, const std::uint64_t offset, std::span<std::uint8_t> output) const;
+
+        std::uint64_t uncompressed_size() const noexcept { return m_uncompressed_size; }
+        std::span<const Checkpoint> checkpoints() const noexcept { return m_checkpoints; }
+    private:
+        std::vector<Checkpoint> m_checkpoints;
+        std::uint64_t m_uncompressed_size {0u};
+    };
+}
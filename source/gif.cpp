@@ -0,0 +1,307 @@
+#include "gif.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+    using sel::Error;
+    using Gif_bitstream = sel::impl::Bitstream<sel::impl::Bitstream_format::gif>;
+
+    /* the codes of a frame, which go on from a data sub-block to the next one. Each sub-block is read in
+    * place by its own Bitstream, only a code that straddles two sub-blocks is put together bit by bit */
+    class Code_reader {
+    public:
+        explicit Code_reader(std::span<const std::uint8_t> sub_blocks) noexcept : m_sub_blocks {sub_blocks} { next_sub_block(); }
+
+        // false if the sub-blocks end before the code
+        bool read(const std::uint32_t size, std::uint32_t& code) noexcept
+        {
+            if(m_bitstream.buffered_bits() < size) {
+                m_bitstream.refill();
+                if(m_bitstream.buffered_bits() < size) return read_across_sub_blocks(size, code);
+            }
+            code = m_bitstream.peek_bits(size);
+            m_bitstream.consume_bits(size);
+            return true;
+        }
+    private:
+        bool next_sub_block() noexcept
+        {
+            if(m_position >= m_sub_blocks.size() or m_sub_blocks[m_position] == 0u) return false;
+            const std::size_t size {std::min<std::size_t>(m_sub_blocks[m_position], m_sub_blocks.size() - m_position - 1u)};
+            m_bitstream = Gif_bitstream {m_sub_blocks.subspan(m_position + 1u, size)};
+            m_position += 1u + size;
+            m_bitstream.refill();
+            return true;
+        }
+
+        bool read_across_sub_blocks(const std::uint32_t size, std::uint32_t& code) noexcept
+        {
+            code = 0u;
+            std::uint32_t bits_read {0u};
+            while(true) {
+                const std::uint32_t amount {std::min(size - bits_read, m_bitstream.buffered_bits())};
+                code |= m_bitstream.peek_bits(amount) << bits_read;
+                m_bitstream.consume_bits(amount);
+                bits_read += amount;
+                if(bits_read == size) return true;
+                if(not next_sub_block()) return false;
+            }
+        }
+
+        std::span<const std::uint8_t> m_sub_blocks;
+        std::size_t m_position {0u}; // of the size byte of the next sub-block
+        Gif_bitstream m_bitstream {std::span<const std::uint8_t> {}};
+    };
+
+    /* copies a string of the dictionary from where it was output before. The source ends before the destination,
+    * so every 8 bytes are read before they can be overwritten. Writes up to max_copy_overrun bytes past the end */
+    inline void copy_string(std::uint8_t* destination, const std::uint8_t* source, const std::size_t length) noexcept
+    {
+        std::size_t i {0u};
+        do {
+            std::uint64_t bytes;
+            std::memcpy(&bytes, source + i, sizeof(bytes));
+            std::memcpy(destination + i, &bytes, sizeof(bytes));
+            i += sizeof(bytes);
+        } while(i < length);
+    }
+
+    // moves 'position' past the sub-blocks that start there and the empty one that ends them, false if the data ends before
+    bool skip_sub_blocks(std::span<const std::uint8_t> data, std::size_t& position) noexcept
+    {
+        while(position < data.size()) {
+            const std::size_t size {data[position]};
+            ++position;
+            if(size == 0u) return true;
+            position += size;
+        }
+        return false;
+    }
+
+    std::uint16_t read_little_endian_16(std::span<const std::uint8_t> bytes, const std::size_t position) noexcept
+    {
+        return static_cast<std::uint16_t>(bytes[position] | (bytes[position + 1u] << 8u));
+    }
+
+    // the rows of an interlaced frame come in 4 passes: every 8th row from row 0, every 8th from row 4, every 4th from row 2 and every 2nd from row 1
+    void deinterlace(std::span<const std::uint8_t> rows, sel::Gif_frame& frame)
+    {
+        constexpr std::array<std::uint32_t, 4> first_rows {0u, 4u, 2u, 1u};
+        constexpr std::array<std::uint32_t, 4> steps {8u, 8u, 4u, 2u};
+
+        frame.indices.resize(rows.size());
+        const std::uint8_t* source {rows.data()};
+        for(std::size_t pass = 0u; pass < first_rows.size(); ++pass) {
+            for(std::uint32_t y = first_rows[pass]; y < frame.height; y += steps[pass]) {
+                std::memcpy(frame.indices.data() + std::size_t {y} * frame.width, source, frame.width);
+                source += frame.width;
+            }
+        }
+    }
+
+    // where the LZW data of a frame is, it's decoded once the whole file has been parsed
+    struct Frame_data {
+        std::span<const std::uint8_t> sub_blocks;
+        std::size_t offset {0u};
+        std::uint32_t min_code_size {0u};
+        bool interlaced {false};
+    };
+}
+
+sel::Gif_image sel::decode_gif(std::span<const std::uint8_t> gif_data, const std::uint32_t threads)
+{
+    return impl::gif::decode(gif_data, threads).value();
+}
+
+sel::Expected<sel::Gif_image> sel::try_decode_gif(std::span<const std::uint8_t> gif_data, const std::uint32_t threads) noexcept
+{
+    try {
+        return impl::gif::decode(gif_data, threads);
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
+
+sel::Error sel::impl::gif::decode_lzw(std::span<const std::uint8_t> sub_blocks, const std::uint32_t min_code_size, const std::size_t pixel_count, std::vector<std::uint8_t>& pixels)
+{
+    // the last string can go past the last pixel
+    pixels.resize(pixel_count + max_string_length + max_copy_overrun);
+    std::uint8_t* const output {pixels.data()};
+
+    const std::uint32_t clear_code {1u << min_code_size};
+    const std::uint32_t end_code {clear_code + 1u};
+    std::uint32_t code_size {min_code_size + 1u};
+    std::uint32_t next_code {clear_code + 2u};
+
+    /* the string of every code after end_code was output before, so the dictionary is where it was output and
+    * its length: a new string is the previous one followed by the first symbol of the current one, which is
+    * where the previous string was output with one more symbol. Only the entries below next_code are read */
+    std::array<std::uint32_t, max_codes> offsets;
+    std::array<std::uint16_t, max_codes> lengths;
+
+    Code_reader reader {sub_blocks};
+    std::size_t position {0u};
+    std::size_t previous_position {0u};
+    std::uint32_t previous_length {0u}; // 0: no code since the last clear code
+    while(position < pixel_count) {
+        std::uint32_t code;
+        if(not reader.read(code_size, code)) return Error::unexpected_eof;
+
+        if(code == clear_code) {
+            code_size = min_code_size + 1u;
+            next_code = clear_code + 2u;
+            previous_length = 0u;
+            continue;
+        }
+        if(code == end_code) break;
+
+        std::uint32_t length;
+        if(code < clear_code) {
+            output[position] = static_cast<std::uint8_t>(code);
+            length = 1u;
+        }
+        else if(code < next_code) {
+            length = lengths[code];
+            copy_string(output + position, output + offsets[code], length);
+        }
+        else if(code == next_code and previous_length != 0u) {
+            // the code that is being defined: the previous string and its own first symbol
+            length = previous_length + 1u;
+            copy_string(output + position, output + previous_position, previous_length);
+            output[position + previous_length] = output[previous_position];
+        }
+        else return Error::bad_formed_data;
+
+        // once the dictionary is full, it stays as it is until a clear code
+        if(previous_length != 0u and next_code < max_codes) {
+            offsets[next_code] = static_cast<std::uint32_t>(previous_position);
+            lengths[next_code] = static_cast<std::uint16_t>(previous_length + 1u);
+            ++next_code;
+        }
+        /* checked after every code and not only when an entry is added, like giflib does. It only matters with a
+        * minimum code size of 1, where next_code needs one more bit right after the first code following a clear code */
+        if(next_code == (1u << code_size) and code_size < max_code_size) { ++code_size; }
+
+        previous_position = position;
+        previous_length = length;
+        position += length;
+    }
+
+    if(position < pixel_count) return Error::unexpected_eof;
+    pixels.resize(pixel_count);
+    return Error::none;
+}
+
+sel::Expected<sel::Gif_image> sel::impl::gif::decode(std::span<const std::uint8_t> gif_data, const std::uint32_t threads)
+{
+    const auto error_at = [](const Error error, const std::size_t position) { return Decode_error {error, position * 8u}; };
+    const auto eof = [&] { return error_at(Error::unexpected_eof, gif_data.size()); };
+
+    // the header and the logical screen descriptor
+    constexpr std::size_t header_size {13u};
+    if(gif_data.size() < header_size) return eof();
+    if(std::memcmp(gif_data.data(), "GIF87a", 6u) != 0 and std::memcmp(gif_data.data(), "GIF89a", 6u) != 0) return error_at(Error::bad_formed_data, 0u);
+
+    Gif_image result;
+    result.width = read_little_endian_16(gif_data, 6u);
+    result.height = read_little_endian_16(gif_data, 8u);
+    const std::uint8_t screen_flags {gif_data[10]};
+    result.background_index = gif_data[11];
+
+    // a color table has 2^(size + 1) RGB triples
+    std::size_t position {header_size};
+    const auto read_color_table = [&](const std::uint8_t flags, std::vector<std::uint8_t>& palette) {
+        if((flags & 0x80u) == 0u) return true;
+        const std::size_t size {std::size_t {3u} << ((flags & 0x07u) + 1u)};
+        if(gif_data.size() - position < size) return false;
+        palette.assign(gif_data.begin() + position, gif_data.begin() + position + size);
+        position += size;
+        return true;
+    };
+    if(not read_color_table(screen_flags, result.palette)) return eof();
+
+    // the Graphic Control Extension applies to the next frame
+    Gif_frame control;
+    std::vector<Frame_data> frames_data;
+    // some encoders leave out the trailer, the file can end after any block
+    while(position < gif_data.size()) {
+        const std::size_t block_position {position};
+        const std::uint8_t introducer {gif_data[position]};
+        ++position;
+
+        if(introducer == 0x3Bu) break; // trailer
+
+        if(introducer == 0x21u) {
+            if(position >= gif_data.size()) return eof();
+            const std::uint8_t label {gif_data[position]};
+            ++position;
+            if(label == 0xF9u and gif_data.size() - position >= 6u and gif_data[position] == 4u) {
+                const std::uint8_t flags {gif_data[position + 1u]};
+                control.disposal = static_cast<std::uint8_t>((flags >> 2u) & 0x07u);
+                control.delay = read_little_endian_16(gif_data, position + 2u);
+                control.transparent_index = (flags & 0x01u) != 0u ? gif_data[position + 4u] : -1;
+            }
+            if(not skip_sub_blocks(gif_data, position)) return eof();
+            continue;
+        }
+
+        if(introducer != 0x2Cu) return error_at(Error::bad_formed_data, block_position);
+
+        // the image descriptor, an optional local color table and the LZW data
+        if(gif_data.size() - position < 9u) return eof();
+        Gif_frame& frame {result.frames.emplace_back(std::move(control))};
+        control = Gif_frame {};
+        frame.left = read_little_endian_16(gif_data, position);
+        frame.top = read_little_endian_16(gif_data, position + 2u);
+        frame.width = read_little_endian_16(gif_data, position + 4u);
+        frame.height = read_little_endian_16(gif_data, position + 6u);
+        const std::uint8_t frame_flags {gif_data[position + 8u]};
+        position += 9u;
+        if(not read_color_table(frame_flags, frame.palette)) return eof();
+
+        if(position >= gif_data.size()) return eof();
+        const std::uint32_t min_code_size {gif_data[position]};
+        if(min_code_size == 0u or min_code_size > 8u) return error_at(Error::bad_formed_data, position);
+        ++position;
+
+        const std::size_t sub_blocks_position {position};
+        if(not skip_sub_blocks(gif_data, position)) return eof();
+        frames_data.push_back(Frame_data {gif_data.subspan(sub_blocks_position, position - sub_blocks_position), sub_blocks_position,
+            min_code_size, (frame_flags & 0x40u) != 0u});
+    }
+
+    std::size_t lzw_size {0u};
+    for(const Frame_data& frame_data : frames_data) { lzw_size += frame_data.sub_blocks.size(); }
+
+    std::vector<Error> errors(frames_data.size(), Error::none);
+    const auto decode_frame = [&](const std::size_t i) {
+        Gif_frame& frame {result.frames[i]};
+        const Frame_data& frame_data {frames_data[i]};
+        const std::size_t pixel_count {std::size_t {frame.width} * frame.height};
+        if(not frame_data.interlaced) {
+            errors[i] = decode_lzw(frame_data.sub_blocks, frame_data.min_code_size, pixel_count, frame.indices);
+            return;
+        }
+
+        std::vector<std::uint8_t> rows;
+        errors[i] = decode_lzw(frame_data.sub_blocks, frame_data.min_code_size, pixel_count, rows);
+        if(errors[i] == Error::none) { deinterlace(rows, frame); }
+    };
+
+    // the frames don't depend on each other, only their composition does
+    const std::uint32_t thread_count {static_cast<std::uint32_t>(std::min({std::size_t {resolve_thread_count(threads)}, frames_data.size(), lzw_size / min_bytes_per_thread}))};
+    if(thread_count < 2u) {
+        for(std::size_t i = 0u; i < frames_data.size(); ++i) { decode_frame(i); }
+    }
+    else {
+        for_each_in_parallel(frames_data.size(), thread_count, [&](std::uint32_t, const std::size_t i) { decode_frame(i); });
+    }
+
+    const auto failed {std::find_if(errors.begin(), errors.end(), [](const Error e) { return e != Error::none; })};
+    if(failed != errors.end()) return error_at(*failed, frames_data[static_cast<std::size_t>(failed - errors.begin())].offset);
+    return result;
+}
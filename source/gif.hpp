@@ -0,0 +1,59 @@
+#pragma once
+
+#include "shared.hpp"
+
+#include <vector>
+
+namespace sel {
+    struct Gif_frame {
+        // where the frame goes in the logical screen
+        std::uint16_t left {0u};
+        std::uint16_t top {0u};
+        std::uint16_t width {0u};
+        std::uint16_t height {0u};
+        // the local color table as RGB triples, empty if the frame uses the global one
+        std::vector<std::uint8_t> palette;
+        // width * height color indices, the rows are in display order even if the frame is interlaced
+        std::vector<std::uint8_t> indices;
+
+        // from the Graphic Control Extension that comes before the frame, if any
+        std::uint16_t delay {0u}; // in hundredths of a second
+        std::uint8_t disposal {0u};
+        std::int32_t transparent_index {-1}; // -1: none
+    };
+
+    struct Gif_image {
+        // the logical screen
+        std::uint16_t width {0u};
+        std::uint16_t height {0u};
+        std::uint8_t background_index {0u};
+        // the global color table as RGB triples, can be empty
+        std::vector<std::uint8_t> palette;
+        std::vector<Gif_frame> frames;
+    };
+
+    /* decodes the frames of a GIF (87a or 89a) to color indices, without composing them. The frames are
+    * independent, so they are decoded by up to 'threads' threads (0: as many as the hardware runs concurrently) */
+    Gif_image decode_gif(std::span<const std::uint8_t> gif_data, const std::uint32_t threads = 0u);
+    /* the same without exceptions, see try_decompress_deflate. The offset of an error in the LZW data of a
+    * frame is the one of the beginning of that data */
+    Expected<Gif_image> try_decode_gif(std::span<const std::uint8_t> gif_data, const std::uint32_t threads = 0u) noexcept;
+}
+
+namespace sel::impl::gif {
+    // no more threads than one per this much LZW data
+    constexpr std::size_t min_bytes_per_thread {1u << 16u}; // 64KB
+
+    constexpr std::uint32_t max_code_size {12u};
+    constexpr std::uint32_t max_codes {1u << max_code_size};
+    // the longest string of the dictionary is a root followed by one symbol for every other code
+    constexpr std::size_t max_string_length {max_codes};
+    // the copies of the strings write up to this many bytes past their end
+    constexpr std::size_t max_copy_overrun {8u};
+
+    /* decodes the LZW data of a frame, from 'sub_blocks' (the data sub-blocks, each with its size byte first,
+    * up to the empty one), into 'pixels'. Extra pixels are ignored */
+    Error decode_lzw(std::span<const std::uint8_t> sub_blocks, const std::uint32_t min_code_size, const std::size_t pixel_count, std::vector<std::uint8_t>& pixels);
+
+    Expected<Gif_image> decode(std::span<const std::uint8_t> gif_data, const std::uint32_t threads);
+}
@@ -0,0 +1,161 @@
+#include "gzip.hpp"
+#include "crc32.hpp"
+
+#include <algorithm>
+
+namespace {
+    // ID1 ID2 CM FLG MTIME(4) XFL OS
+    constexpr std::size_t fixed_header_size {10u};
+    // CRC32 ISIZE
+    constexpr std::size_t trailer_size {8u};
+    // the most data whose CRC-32 is computed at once, it's still in the cache after being decompressed
+    constexpr std::size_t crc32_chunk_size {1u << 16u}; // 64KB
+
+    constexpr std::uint8_t ftext {0x01u};
+    constexpr std::uint8_t fhcrc {0x02u};
+    constexpr std::uint8_t fextra {0x04u};
+    constexpr std::uint8_t fname {0x08u};
+    constexpr std::uint8_t fcomment {0x10u};
+    constexpr std::uint8_t reserved_flags {0xE0u};
+
+    std::uint32_t read_little_endian_16(std::span<const std::uint8_t> bytes) noexcept
+    {
+        return bytes[0] | (static_cast<std::uint32_t>(bytes[1]) << 8u);
+    }
+
+    std::uint32_t read_little_endian_32(std::span<const std::uint8_t> bytes) noexcept
+    {
+        return bytes[0] | (bytes[1] << 8u) | (bytes[2] << 16u) | (static_cast<std::uint32_t>(bytes[3]) << 24u);
+    }
+}
+
+std::vector<std::uint8_t> sel::decompress_gzip(std::span<const std::uint8_t> gzip_data)
+{
+    impl::deflate::Dynamic_tables tables;
+    return impl::gzip::decompress(gzip_data, tables, nullptr).value();
+}
+
+std::vector<std::uint8_t> sel::decompress_gzip(std::span<const std::uint8_t> gzip_data, std::vector<Gzip_header>& headers)
+{
+    impl::deflate::Dynamic_tables tables;
+    headers.clear();
+    return impl::gzip::decompress(gzip_data, tables, &headers).value();
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::try_decompress_gzip(std::span<const std::uint8_t> gzip_data) noexcept
+{
+    try {
+        impl::deflate::Dynamic_tables tables;
+        return impl::gzip::decompress(gzip_data, tables, nullptr);
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
+
+sel::Expected<std::size_t> sel::impl::gzip::read_header(std::span<const std::uint8_t> data, Gzip_header* header)
+{
+    const Decode_error eof {Error::unexpected_eof, data.size() * 8u};
+    if(data.size() < fixed_header_size) return eof;
+
+    // ID1 ID2, CM must be 8 (deflate) and the reserved flags must be zero
+    if(data[0] != 0x1Fu or data[1] != 0x8Bu) return Decode_error {Error::bad_formed_data, 0u};
+    if(data[2] != 8u) return Decode_error {Error::bad_formed_data, 16u};
+    const std::uint8_t flg {data[3]};
+    if((flg & reserved_flags) != 0u) return Decode_error {Error::bad_formed_data, 24u};
+
+    if(header != nullptr) {
+        header->text = (flg & ftext) != 0u;
+        header->modification_time = read_little_endian_32(data.subspan(4u));
+        header->extra_flags = data[8];
+        header->operating_system = data[9];
+    }
+
+    std::size_t position {fixed_header_size};
+    if((flg & fextra) != 0u) {
+        if(data.size() - position < 2u) return eof;
+        const std::size_t xlen {read_little_endian_16(data.subspan(position))};
+        position += 2u;
+        if(data.size() - position < xlen) return eof;
+        if(header != nullptr) { header->extra.assign(data.begin() + position, data.begin() + position + xlen); }
+        position += xlen;
+    }
+
+    // FNAME and FCOMMENT end with a zero byte
+    const auto read_string = [&](std::string* field) {
+        const auto end {std::find(data.begin() + position, data.end(), std::uint8_t {0u})};
+        if(end == data.end()) return false;
+        if(field != nullptr) { field->assign(data.begin() + position, end); }
+        position = static_cast<std::size_t>(end - data.begin()) + 1u;
+        return true;
+    };
+    if((flg & fname) != 0u and not read_string(header != nullptr ? &header->name : nullptr)) return eof;
+    if((flg & fcomment) != 0u and not read_string(header != nullptr ? &header->comment : nullptr)) return eof;
+
+    // CRC16 is the low half of the CRC-32 of the header up to it
+    if((flg & fhcrc) != 0u) {
+        if(data.size() - position < 2u) return eof;
+        const std::uint32_t crc16 {read_little_endian_16(data.subspan(position))};
+        if((crc32(data.first(position)) & 0xFFFFu) != crc16) return Decode_error {Error::checksum_mismatch, position * 8u};
+        position += 2u;
+    }
+
+    return position;
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::impl::gzip::decompress(std::span<const std::uint8_t> gzip_data, deflate::Dynamic_tables& tables, std::vector<Gzip_header>* headers)
+{
+    /* the last 4 bytes are the ISIZE of the last member, the size modulo 2^32 of its data. It's only
+    * trusted as far as the compressed data could expand, a corrupt one can't reserve gigabytes */
+    std::size_t size_hint {5000u}; // 5KB
+    if(gzip_data.size() >= fixed_header_size + trailer_size) {
+        const std::size_t isize {read_little_endian_32(gzip_data.last(4u))};
+        size_hint = std::max(size_hint, std::min(isize, gzip_data.size() * deflate::max_deflate_ratio));
+    }
+
+    std::vector<std::uint8_t> inflated_data;
+    deflate::Output_buffer output {.vector = &inflated_data};
+    output.reserve(size_hint + deflate::max_match_length + deflate::max_lz77_copy_overrun);
+
+    // each member starts right after the trailer of the previous one
+    std::size_t member_start {0u};
+    do {
+        Gzip_header* header {nullptr};
+        if(headers != nullptr) { header = &headers->emplace_back(); }
+        const Expected<std::size_t> header_size {read_header(gzip_data.subspan(member_start), header)};
+        if(not header_size) return Decode_error {header_size.error().error, member_start * 8u + header_size.error().bit_offset};
+
+        // in the whole gzip file
+        deflate::Deflate_bitstream bitstream {gzip_data.subspan(member_start + *header_size)};
+        const auto error_here = [&](const Error error) { return Decode_error {error, gzip_data.size() * 8u - bitstream.bits_left()}; };
+
+        const std::size_t member_output_start {output.size};
+        deflate::Inflate_state state;
+        std::uint32_t crc {0u};
+        while(state.step != deflate::Inflate_state::Step::done) {
+            // inflate stops with needs_output after a chunk, whose CRC-32 is computed while it's in the cache
+            output.reserve(crc32_chunk_size);
+            deflate::Output_buffer chunk {output.data, output.size, std::min(output.capacity, output.size + crc32_chunk_size)};
+            const deflate::Inflate_status status {deflate::inflate(state, tables, chunk, bitstream)};
+            if(status == deflate::Inflate_status::needs_input) return error_here(Error::unexpected_eof);
+            if(status == deflate::Inflate_status::bad_formed_data) return error_here(Error::bad_formed_data);
+            crc = crc32(std::span<const std::uint8_t> {chunk.data + output.size, chunk.size - output.size}, crc);
+            output.size = chunk.size;
+        }
+
+        // CRC32 and ISIZE are in little-endian, after the deflate data
+        bitstream.skip_until_next_byte_boundary();
+        if(bitstream.bits_left() < trailer_size * 8u) return error_here(Error::unexpected_eof);
+        const std::size_t trailer_start {gzip_data.size() - bitstream.bits_left() / 8u};
+        const std::span<const std::uint8_t> trailer {gzip_data.subspan(trailer_start, trailer_size)};
+        const std::uint32_t isize {static_cast<std::uint32_t>(output.size - member_output_start)};
+        if(read_little_endian_32(trailer) != crc or read_little_endian_32(trailer.subspan(4u)) != isize) {
+            return Decode_error {Error::checksum_mismatch, trailer_start * 8u};
+        }
+
+        member_start = trailer_start + trailer_size;
+    } while(member_start < gzip_data.size());
+
+    inflated_data.resize(output.size);
+    return inflated_data;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "shared.hpp"
+#include "deflate.hpp"
+
+#include <string>
+#include <vector>
+
+namespace sel {
+    // the header of a gzip member, without the fields that only matter to decoding (CM, FHCRC)
+    struct Gzip_header {
+        bool text {false}; // FTEXT, the data is probably text
+        std::uint32_t modification_time {0u}; // Unix time, 0 when there is none
+        std::uint8_t extra_flags {0u}; // XFL, 2: slowest compression, 4: fastest
+        std::uint8_t operating_system {255u}; // OS, 255: unknown
+        std::vector<std::uint8_t> extra; // FEXTRA, the subfields as they are
+        std::string name; // FNAME, ISO 8859-1
+        std::string comment; // FCOMMENT, ISO 8859-1
+    };
+
+    /* decompresses a gzip file (RFC 1952): every member one after another, each with its header, its
+    * deflate data and its CRC-32 and size, which are checked. The CRC-32 is computed 64KB at a time while
+    * the data is still in the cache, and the size of the last member (ISIZE) pre-sizes the output, it's
+    * the size of the whole output for the usual files of a single member */
+    std::vector<std::uint8_t> decompress_gzip(std::span<const std::uint8_t> gzip_data);
+    // the same, with the header of each member in 'headers'
+    std::vector<std::uint8_t> decompress_gzip(std::span<const std::uint8_t> gzip_data, std::vector<Gzip_header>& headers);
+    // the same without exceptions, see try_decompress_deflate. The offset of a CRC-32 or size mismatch is the one of the trailer
+    Expected<std::vector<std::uint8_t>> try_decompress_gzip(std::span<const std::uint8_t> gzip_data) noexcept;
+}
+
+namespace sel::impl::gzip {
+    // the size of the header at the beginning of 'data', its fields are only read if 'header' isn't null
+    Expected<std::size_t> read_header(std::span<const std::uint8_t> data, Gzip_header* header);
+
+    // 'headers' can be null
+    Expected<std::vector<std::uint8_t>> decompress(std::span<const std::uint8_t> gzip_data, deflate::Dynamic_tables& tables, std::vector<Gzip_header>* headers);
+}
@@ -0,0 +1,242 @@
+#include "input_file.hpp"
+
+#include <array>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    using sel::Error;
+    using namespace sel::impl::input_file;
+
+    bool should_map(const sel::Input_mode mode, const bool regular_file, const std::uint64_t size) noexcept
+    {
+        // a mapping can't be empty, and only a regular file has a size that won't change while it's read
+        if(mode == sel::Input_mode::read or not regular_file or size == 0u or size > SIZE_MAX) return false;
+        return mode == sel::Input_mode::map or size >= min_mapped_size;
+    }
+
+#ifdef _WIN32
+    // closes the handle when it goes out of scope, the file and the mapping object aren't needed by the view
+    class Handle {
+    public:
+        explicit Handle(HANDLE handle) noexcept : m_handle {handle} {}
+        ~Handle() { if(valid()) CloseHandle(m_handle); }
+        Handle(const Handle&) = delete;
+        Handle& operator=(const Handle&) = delete;
+
+        HANDLE get() const noexcept { return m_handle; }
+        bool valid() const noexcept { return m_handle != nullptr and m_handle != INVALID_HANDLE_VALUE; }
+    private:
+        HANDLE m_handle;
+    };
+
+    const std::uint8_t* map_file(HANDLE file) noexcept
+    {
+        const Handle mapping {CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)};
+        if(not mapping.valid()) return nullptr;
+        return static_cast<const std::uint8_t*>(MapViewOfFile(mapping.get(), FILE_MAP_READ, 0, 0, 0));
+    }
+
+    using Native_file = HANDLE;
+
+    // at most 'room' bytes, zero at the end of the file
+    std::size_t read_some(HANDLE file, std::uint8_t* destination, const std::size_t room)
+    {
+        DWORD amount {0};
+        // a pipe whose writer closed it reports ERROR_BROKEN_PIPE, which is its end
+        if(not ReadFile(file, destination, static_cast<DWORD>(room), &amount, nullptr)) {
+            if(GetLastError() == ERROR_BROKEN_PIPE) return 0u;
+            throw sel::Exception {Error::cant_read_file};
+        }
+        return amount;
+    }
+#else
+    // closes the file descriptor when it goes out of scope, a mapping doesn't need it
+    class File_descriptor {
+    public:
+        explicit File_descriptor(const int descriptor) noexcept : m_descriptor {descriptor} {}
+        ~File_descriptor() { if(m_descriptor >= 0) close(m_descriptor); }
+        File_descriptor(const File_descriptor&) = delete;
+        File_descriptor& operator=(const File_descriptor&) = delete;
+
+        int get() const noexcept { return m_descriptor; }
+    private:
+        int m_descriptor;
+    };
+
+    const std::uint8_t* map_file(const int descriptor, const std::size_t size) noexcept
+    {
+        void* address {MAP_FAILED};
+        if(size >= huge_page_size) {
+            /* address space with room for a huge page boundary, where the file is mapped over it. What's left of
+            * the reservation before and after the file is given back */
+            const std::size_t page_size {static_cast<std::size_t>(sysconf(_SC_PAGESIZE))};
+            const std::size_t reservation_size {size + huge_page_size};
+            void* const reservation {mmap(nullptr, reservation_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+            if(reservation != MAP_FAILED) {
+                const std::uintptr_t start {reinterpret_cast<std::uintptr_t>(reservation)};
+                const std::uintptr_t aligned {(start + huge_page_size - 1u) / huge_page_size * huge_page_size};
+                address = mmap(reinterpret_cast<void*>(aligned), size, PROT_READ, MAP_PRIVATE | MAP_FIXED, descriptor, 0);
+                if(address == MAP_FAILED) { munmap(reservation, reservation_size); }
+                else {
+                    const std::uintptr_t mapping_end {aligned + (size + page_size - 1u) / page_size * page_size};
+                    if(aligned != start) { munmap(reservation, aligned - start); }
+                    if(mapping_end != start + reservation_size) { munmap(reinterpret_cast<void*>(mapping_end), start + reservation_size - mapping_end); }
+                }
+            }
+        }
+        if(address == MAP_FAILED) { address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0); }
+        if(address == MAP_FAILED) return nullptr;
+
+        // the kernel reads further ahead, and drops the pages behind sooner
+        madvise(address, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+        if(size >= huge_page_size) { madvise(address, size, MADV_HUGEPAGE); }
+#endif
+        return static_cast<const std::uint8_t*>(address);
+    }
+
+    using Native_file = int;
+
+    // at most 'room' bytes, zero at the end of the file
+    std::size_t read_some(const int descriptor, std::uint8_t* destination, const std::size_t room)
+    {
+        while(true) {
+            const ssize_t amount {read(descriptor, destination, room)};
+            if(amount >= 0) return static_cast<std::size_t>(amount);
+            if(errno != EINTR) throw sel::Exception {Error::cant_read_file};
+        }
+    }
+#endif
+
+    /* until the end of the file, 'expected_size' is only where to start. The buffer is resized only over
+    * what is read next, so what the growth reserves is neither zeroed nor resident */
+    void read_file(const Native_file file, const std::uint64_t expected_size, std::vector<std::uint8_t>& buffer)
+    {
+        buffer.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(expected_size, buffer.max_size())));
+        std::array<std::uint8_t, eof_probe_size> probe;
+        while(true) {
+            const std::size_t size {buffer.size()};
+            if(size == buffer.capacity()) {
+                // a regular file is read whole by now, a small read finds its end without growing the buffer
+                if(size == expected_size) {
+                    const std::size_t amount {read_some(file, probe.data(), probe.size())};
+                    if(amount == 0u) break;
+                    buffer.insert(buffer.end(), probe.begin(), probe.begin() + amount);
+                    continue;
+                }
+                buffer.reserve(std::max(size * 2u, size + read_size));
+            }
+
+            buffer.resize(size + std::min(buffer.capacity() - size, read_size));
+            const std::size_t amount {read_some(file, buffer.data() + size, buffer.size() - size)};
+            buffer.resize(size + amount);
+            if(amount == 0u) break;
+        }
+        // the room that the growth left after the end, when the file wasn't the size it had
+        buffer.shrink_to_fit();
+    }
+}
+
+sel::Input_file::Input_file(const std::filesystem::path& path, const Input_mode mode)
+{
+#ifdef _WIN32
+    const Handle file {CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)};
+    if(not file.valid()) throw Exception {Error::cant_read_file};
+
+    LARGE_INTEGER file_size {};
+    const bool regular_file {GetFileType(file.get()) == FILE_TYPE_DISK and GetFileSizeEx(file.get(), &file_size)};
+    const std::uint64_t size {regular_file ? static_cast<std::uint64_t>(file_size.QuadPart) : 0u};
+    if(should_map(mode, regular_file, size)) {
+        m_data = map_file(file.get());
+        if(m_data != nullptr) {
+            m_size = static_cast<std::size_t>(size);
+            m_mapped = true;
+            return;
+        }
+    }
+    read_file(file.get(), size, m_buffer);
+#else
+    const File_descriptor file {open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+    if(file.get() < 0) throw Exception {Error::cant_read_file};
+
+    struct stat status {};
+    if(fstat(file.get(), &status) != 0) throw Exception {Error::cant_read_file};
+    const bool regular_file {S_ISREG(status.st_mode)};
+    const std::uint64_t size {regular_file ? static_cast<std::uint64_t>(status.st_size) : 0u};
+    if(should_map(mode, regular_file, size)) {
+        m_data = map_file(file.get(), static_cast<std::size_t>(size));
+        if(m_data != nullptr) {
+            m_size = static_cast<std::size_t>(size);
+            m_mapped = true;
+            return;
+        }
+    }
+    read_file(file.get(), size, m_buffer);
+#endif
+
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+}
+
+sel::Input_file::Input_file(Input_file&& other) noexcept
+{
+    *this = std::move(other);
+}
+
+sel::Input_file& sel::Input_file::operator=(Input_file&& other) noexcept
+{
+    if(this == &other) return *this;
+
+    unmap();
+    // the data of a vector stays where it is when the vector is moved
+    m_buffer = std::move(other.m_buffer);
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0u);
+    m_mapped = std::exchange(other.m_mapped, false);
+    return *this;
+}
+
+sel::Input_file::~Input_file()
+{
+    unmap();
+}
+
+void sel::Input_file::unmap() noexcept
+{
+    if(not m_mapped) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap(const_cast<std::uint8_t*>(m_data), m_size);
+#endif
+    m_mapped = false;
+}
+
+sel::Expected<sel::Input_file> sel::try_open_input_file(const std::filesystem::path& path, const Input_mode mode) noexcept
+{
+    try {
+        return Input_file {path, mode};
+    }
+    catch(const Exception& exception) {
+        return Decode_error {exception.error()};
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "shared.hpp"
+
+#include <filesystem>
+#include <vector>
+
+namespace sel {
+    enum class Input_mode {
+        automatic, // mapped if it's a regular file of at least impl::input_file::min_mapped_size, read otherwise
+        map, // mapped if the file can be, read otherwise
+        read
+    };
+
+    /* the contents of a file as contiguous bytes, which every function that takes a std::span<const std::uint8_t>
+    * (Bytestream and Bitstream too) takes as they are, without a copy. A mapped file is read by the kernel as
+    * the pages are first touched, with a hint that it's read sequentially. Pipes, terminals and the files that
+    * can't be mapped are read into a buffer until their end. Throws Error::cant_read_file if the file can't be
+    * opened or read. The contents of a mapped file that is modified while it's open are undefined */
+    class Input_file {
+    public:
+        // no bytes, like an Input_file that was moved from
+        Input_file() noexcept = default;
+        explicit Input_file(const std::filesystem::path& path, const Input_mode mode = Input_mode::automatic);
+        Input_file(Input_file&& other) noexcept;
+        Input_file& operator=(Input_file&& other) noexcept;
+        Input_file(const Input_file&) = delete;
+        Input_file& operator=(const Input_file&) = delete;
+        ~Input_file();
+
+        const std::uint8_t* data() const noexcept { return m_data; }
+        std::size_t size() const noexcept { return m_size; }
+        const std::uint8_t* begin() const noexcept { return m_data; }
+        const std::uint8_t* end() const noexcept { return m_data + m_size; }
+        bool mapped() const noexcept { return m_mapped; }
+    private:
+        void unmap() noexcept;
+
+        const std::uint8_t* m_data {nullptr};
+        std::size_t m_size {0u};
+        bool m_mapped {false};
+        std::vector<std::uint8_t> m_buffer; // when it's read
+    };
+
+    // the same without exceptions, the error is at offset 0
+    Expected<Input_file> try_open_input_file(const std::filesystem::path& path, const Input_mode mode = Input_mode::automatic) noexcept;
+}
+
+namespace sel::impl::input_file {
+    // below this, reading a file costs no more than mapping it and taking a page fault for every page
+    constexpr std::size_t min_mapped_size {1u << 20u}; // 1MB
+    /* mappings at least this long start at a multiple of it, so that the kernel can back them with huge
+    * pages where it does that for files (Linux with transparent huge pages for the page cache) */
+    constexpr std::size_t huge_page_size {1u << 21u}; // 2MB
+    // what is read at once from a file of unknown size
+    constexpr std::size_t read_size {1u << 20u}; // 1MB
+    // what is read after the size of a regular file, to find that it ends there
+    constexpr std::size_t eof_probe_size {4096u}; // 4KB
+}
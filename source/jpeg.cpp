@@ -0,0 +1,572 @@
+#include "jpeg.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    using sel::Error;
+    using sel::impl::jpeg::Huffman_table;
+
+    // the components of a scan with their tables, and how its MCUs are laid out
+    struct Scan {
+        struct Component {
+            sel::Jpeg_component* component {nullptr};
+            const Huffman_table* dc_table {nullptr};
+            const Huffman_table* ac_table {nullptr};
+        };
+
+        std::array<Component, 4> components {};
+        std::uint32_t component_count {0u};
+        std::uint32_t mcus_per_line {0u};
+        std::uint32_t mcu_count {0u};
+        std::uint32_t restart_interval {0u}; // in MCUs, 0: the scan has no restart markers
+    };
+
+    /* reads the entropy-coded data of a scan straight from the JPEG data, the next bit is the most significant
+    * bit of the buffer like in Bitstream<jpg>. The refill takes 8 bytes at once when none of them is 0xFF,
+    * which is most of the time, and goes byte by byte otherwise: 0xFF00 is a 0xFF byte of the data and any
+    * other marker (RSTn at the end of a restart interval) stops it, the bits after it are zeros */
+    class Entropy_bitstream {
+    public:
+        Entropy_bitstream(std::span<const std::uint8_t> data) noexcept : m_data {data} {}
+
+        // after it, at least 56 bits are buffered unless the data is about to stop
+        void refill() noexcept
+        {
+            if(m_data.size() - m_position < 8u) {
+                refill_byte_by_byte();
+                return;
+            }
+
+            std::uint64_t word;
+            std::memcpy(&word, m_data.data() + m_position, sizeof(word));
+            // the bytes of ~word that are zero are the 0xFF bytes of the data
+            if(((~word - 0x0101010101010101u) & word & 0x8080808080808080u) != 0u) {
+                refill_byte_by_byte();
+                return;
+            }
+            if constexpr(std::endian::native != std::endian::big) { word = sel::impl::byteswap(word); }
+            m_buffer |= word >> m_buffered_bits;
+
+            // only whole bytes are accounted, the bits of the last partial byte are loaded again next time
+            m_position += (63u - m_buffered_bits) >> 3u;
+            m_buffered_bits |= 56u;
+        }
+
+        // the bits beyond the buffered ones are peeked as zeros, or as the ones that follow in the data
+        std::uint32_t peek_bits(const std::uint32_t amount) const noexcept
+        {
+            if(amount == 0u) return 0u;
+            return static_cast<std::uint32_t>(m_buffer >> (64u - amount));
+        }
+
+        // doesn't check that there are enough buffered bits
+        void consume_bits(const std::uint32_t amount) noexcept
+        {
+            m_buffer <<= amount;
+            m_buffered_bits -= amount;
+        }
+
+        std::uint32_t buffered_bits() const noexcept { return m_buffered_bits; }
+        // the next byte that isn't buffered, the one of the marker once it's reached
+        std::size_t position() const noexcept { return m_position; }
+    private:
+        void refill_byte_by_byte() noexcept
+        {
+            while(m_buffered_bits <= 56u and m_position < m_data.size()) {
+                const std::uint8_t byte {m_data[m_position]};
+                if(byte == 0xFFu) {
+                    if(m_position + 1u == m_data.size() or m_data[m_position + 1u] != 0x00u) return;
+                    ++m_position; // the stuffed zero byte
+                }
+                m_buffer |= std::uint64_t {byte} << (56u - m_buffered_bits);
+                ++m_position;
+                m_buffered_bits += 8u;
+            }
+        }
+
+        std::span<const std::uint8_t> m_data;
+        std::size_t m_position {0u};
+        std::uint64_t m_buffer {0u};
+        std::uint32_t m_buffered_bits {0u};
+    };
+
+    std::uint32_t read_big_endian_16(std::span<const std::uint8_t> bytes, const std::size_t position) noexcept
+    {
+        return (static_cast<std::uint32_t>(bytes[position]) << 8u) | bytes[position + 1u];
+    }
+
+    // the value of 'bits', the 'size' bits that follow a symbol, which are the magnitude of a negative value if the first one is zero
+    std::int32_t extend(const std::uint32_t bits, const std::uint32_t size) noexcept
+    {
+        if(size == 0u) return 0;
+        return bits < (1u << (size - 1u)) ? static_cast<std::int32_t>(bits) - static_cast<std::int32_t>((1u << size) - 1u) : static_cast<std::int32_t>(bits);
+    }
+
+    // after a refill, there are enough buffered bits for a symbol unless the interval is about to end
+    Error decode_symbol(Entropy_bitstream& bitstream, const Huffman_table& table, std::uint32_t& symbol) noexcept
+    {
+        const sel::impl::jpeg::Fast_entry fast {table.fast[bitstream.peek_bits(sel::impl::jpeg::fast_bits)]};
+        if(fast.length != 0u) {
+            if(fast.length > bitstream.buffered_bits()) return Error::unexpected_eof;
+            bitstream.consume_bits(fast.length);
+            symbol = fast.symbol;
+            return Error::none;
+        }
+
+        // code_limits[17] is larger than any code, the bits that aren't the prefix of any code end there
+        const std::uint32_t code {bitstream.peek_bits(16u)};
+        std::uint32_t length {sel::impl::jpeg::fast_bits + 1u};
+        while(code >= table.code_limits[length]) { ++length; }
+        if(length > 16u) return Error::bad_formed_data;
+        if(length > bitstream.buffered_bits()) return Error::unexpected_eof;
+
+        bitstream.consume_bits(length);
+        symbol = table.symbols[static_cast<std::size_t>(static_cast<std::int32_t>(code >> (16u - length)) + table.symbol_offsets[length])];
+        return Error::none;
+    }
+
+    Error decode_block(Entropy_bitstream& bitstream, const Scan::Component& component, std::int32_t& dc_predictor, std::int16_t* block) noexcept
+    {
+        using sel::impl::jpeg::natural_order;
+
+        // the DC coefficient is the difference with the one of the previous block of the component
+        bitstream.refill();
+        std::uint32_t size;
+        Error error {decode_symbol(bitstream, *component.dc_table, size)};
+        if(error != Error::none) return error;
+        if(size > 11u) return Error::bad_formed_data;
+        if(size > bitstream.buffered_bits()) return Error::unexpected_eof;
+        dc_predictor += extend(bitstream.peek_bits(size), size);
+        bitstream.consume_bits(size);
+        block[0] = static_cast<std::int16_t>(dc_predictor);
+
+        /* each AC symbol is a run of zeros (high nibble) and the size of the coefficient that follows them
+        * (low nibble). 0x00 ends the block and 0xF0 is a run of 16 zeros. The usual coefficients, a short code
+        * with a few bits, are decoded in one lookup. A symbol and its bits are at most 31 bits */
+        const Huffman_table& ac_table {*component.ac_table};
+        for(std::uint32_t k = 1u; k < 64u;) {
+            if(bitstream.buffered_bits() < 32u) { bitstream.refill(); }
+
+            const sel::impl::jpeg::Fast_ac_entry fast {ac_table.fast_ac[bitstream.peek_bits(sel::impl::jpeg::fast_bits)]};
+            if(fast.length != 0u) {
+                if(fast.length > bitstream.buffered_bits()) return Error::unexpected_eof;
+                bitstream.consume_bits(fast.length);
+                k += fast.run;
+                if(k > 63u) return Error::bad_formed_data;
+                block[natural_order[k]] = fast.value;
+                ++k;
+                continue;
+            }
+
+            std::uint32_t symbol;
+            error = decode_symbol(bitstream, ac_table, symbol);
+            if(error != Error::none) return error;
+            const std::uint32_t run {symbol >> 4u};
+            size = symbol & 0x0Fu;
+            if(size == 0u) {
+                if(run != 15u) break;
+                k += 16u;
+                continue;
+            }
+
+            k += run;
+            if(k > 63u) return Error::bad_formed_data;
+            if(size > bitstream.buffered_bits()) return Error::unexpected_eof;
+            block[natural_order[k]] = static_cast<std::int16_t>(extend(bitstream.peek_bits(size), size));
+            bitstream.consume_bits(size);
+            ++k;
+        }
+
+        return Error::none;
+    }
+
+    std::int16_t* block_at(sel::Jpeg_component& component, const std::uint32_t x, const std::uint32_t y) noexcept
+    {
+        return component.coefficients.data() + (std::size_t {y} * component.blocks_per_line + x) * 64u;
+    }
+
+    // the MCUs [first_mcu, first_mcu + mcu_count) of 'scan', the DC predictors start at zero in each interval
+    Error decode_interval(Entropy_bitstream& bitstream, const Scan& scan, const std::uint32_t first_mcu, const std::uint32_t mcu_count) noexcept
+    {
+        std::array<std::int32_t, 4> dc_predictors {};
+
+        for(std::uint32_t mcu = first_mcu; mcu < first_mcu + mcu_count; ++mcu) {
+            const std::uint32_t mcu_x {mcu % scan.mcus_per_line};
+            const std::uint32_t mcu_y {mcu / scan.mcus_per_line};
+
+            // a scan of a single component isn't interleaved, its MCUs are single blocks
+            if(scan.component_count == 1u) {
+                const Scan::Component& component {scan.components[0]};
+                const Error error {decode_block(bitstream, component, dc_predictors[0], block_at(*component.component, mcu_x, mcu_y))};
+                if(error != Error::none) return error;
+                continue;
+            }
+
+            for(std::uint32_t i = 0u; i < scan.component_count; ++i) {
+                const Scan::Component& component {scan.components[i]};
+                const std::uint32_t horizontal {component.component->horizontal_sampling};
+                const std::uint32_t vertical {component.component->vertical_sampling};
+                for(std::uint32_t y = 0u; y < vertical; ++y) {
+                    for(std::uint32_t x = 0u; x < horizontal; ++x) {
+                        std::int16_t* block {block_at(*component.component, mcu_x * horizontal + x, mcu_y * vertical + y)};
+                        const Error error {decode_block(bitstream, component, dc_predictors[i], block)};
+                        if(error != Error::none) return error;
+                    }
+                }
+            }
+        }
+
+        return Error::none;
+    }
+
+    // the position of the first marker from 'position' on, 0xFF00 isn't one. The size of the data if there is none
+    std::size_t find_marker(std::span<const std::uint8_t> data, std::size_t position) noexcept
+    {
+        while(position < data.size()) {
+            const void* found {std::memchr(data.data() + position, 0xFF, data.size() - position)};
+            if(found == nullptr) break;
+            position = static_cast<std::size_t>(static_cast<const std::uint8_t*>(found) - data.data());
+            if(position + 1u == data.size() or data[position + 1u] != 0x00u) return position;
+            position += 2u;
+        }
+        return data.size();
+    }
+
+    // moves 'position' from a marker to what follows it, false if the marker isn't RST0~RST7
+    bool skip_restart_marker(std::span<const std::uint8_t> data, std::size_t& position) noexcept
+    {
+        // any amount of 0xFF bytes can come before a marker
+        std::size_t end {position};
+        while(end < data.size() and data[end] == 0xFFu) { ++end; }
+        if(end == data.size() or data[end] < 0xD0u or data[end] > 0xD7u) return false;
+
+        position = end + 1u;
+        return true;
+    }
+
+    /* decodes the entropy-coded data of 'scan' that starts at 'position' and returns the position of the marker
+    * that ends it. The restart intervals are read one after another, or by several threads if there are
+    * enough of them and enough data: their starts are found first, the intervals don't share any block */
+    sel::Expected<std::size_t> decode_scan(std::span<const std::uint8_t> data, std::size_t position, const Scan& scan, const std::uint32_t threads)
+    {
+        using sel::Decode_error;
+        const auto error_at = [](const Error error, const std::size_t at) { return Decode_error {error, at * 8u}; };
+
+        const std::size_t interval_count {scan.restart_interval == 0u ? 1u : (scan.mcu_count + scan.restart_interval - 1u) / scan.restart_interval};
+        const std::uint32_t mcus_per_interval {scan.restart_interval == 0u ? scan.mcu_count : scan.restart_interval};
+        const auto decode = [&](const std::size_t i, const std::size_t start, std::size_t& end) {
+            const std::uint32_t first_mcu {static_cast<std::uint32_t>(i) * mcus_per_interval};
+            Entropy_bitstream bitstream {data.subspan(start)};
+            const Error error {decode_interval(bitstream, scan, first_mcu, std::min(mcus_per_interval, scan.mcu_count - first_mcu))};
+            // the bits after the last MCU are padding
+            end = find_marker(data, start + bitstream.position());
+            return error;
+        };
+
+        // the rest of the data is as much as the scan can be
+        const std::uint32_t max_threads {static_cast<std::uint32_t>(std::min({std::size_t {sel::impl::resolve_thread_count(threads)}, interval_count,
+            (data.size() - position) / sel::impl::jpeg::min_bytes_per_thread}))};
+        if(max_threads < 2u) {
+            for(std::size_t i = 0u; i < interval_count; ++i) {
+                const std::size_t start {position};
+                const Error error {decode(i, start, position)};
+                if(error != Error::none) return error_at(error, start);
+                if(position == data.size()) return error_at(Error::unexpected_eof, data.size());
+                if(i + 1u < interval_count and not skip_restart_marker(data, position)) return error_at(Error::bad_formed_data, position);
+            }
+            return position;
+        }
+
+        /* the intervals before a marker that isn't where it should be are decoded anyway, the errors are the
+        * same as the ones of reading them one after another */
+        std::vector<std::size_t> starts;
+        starts.reserve(interval_count);
+        Decode_error marker_error {Error::none};
+        while(starts.size() < interval_count) {
+            starts.push_back(position);
+            position = find_marker(data, position);
+            if(position == data.size()) {
+                marker_error = error_at(Error::unexpected_eof, data.size());
+                break;
+            }
+            if(starts.size() < interval_count and not skip_restart_marker(data, position)) {
+                marker_error = error_at(Error::bad_formed_data, position);
+                break;
+            }
+        }
+
+        const std::uint32_t thread_count {std::max(1u, static_cast<std::uint32_t>(std::min(std::size_t {max_threads}, (position - starts[0]) / sel::impl::jpeg::min_bytes_per_thread)))};
+        std::vector<Error> errors(starts.size(), Error::none);
+        sel::impl::for_each_in_parallel(starts.size(), thread_count, [&](std::uint32_t, const std::size_t i) {
+            std::size_t end;
+            errors[i] = decode(i, starts[i], end);
+        });
+
+        const auto failed {std::find_if(errors.begin(), errors.end(), [](const Error e) { return e != Error::none; })};
+        if(failed != errors.end()) return error_at(*failed, starts[static_cast<std::size_t>(failed - errors.begin())]);
+        if(marker_error.error != Error::none) return marker_error;
+        return position;
+    }
+
+    struct Decoder_state {
+        sel::Jpeg_coefficients result;
+        // a few KB each, they aren't kept on the stack
+        std::vector<Huffman_table> dc_tables {std::vector<Huffman_table>(4u)};
+        std::vector<Huffman_table> ac_tables {std::vector<Huffman_table>(4u)};
+        std::uint32_t restart_interval {0u};
+        std::uint32_t max_horizontal_sampling {1u};
+        std::uint32_t max_vertical_sampling {1u};
+        bool frame_read {false};
+    };
+
+    // SOF0 and SOF1, their components get room for all their blocks
+    Error read_frame(std::span<const std::uint8_t> segment, Decoder_state& state)
+    {
+        if(state.frame_read) return Error::bad_formed_data;
+        if(segment.size() < 6u) return Error::bad_formed_data;
+        if(segment[0] != 8u) return Error::unsupported; // 12 bits samples
+
+        sel::Jpeg_coefficients& result {state.result};
+        result.height = read_big_endian_16(segment, 1u);
+        result.width = read_big_endian_16(segment, 3u);
+        const std::uint32_t component_count {segment[5]};
+        if(result.height == 0u) return Error::unsupported; // the height is in a DNL marker after the scan
+        if(result.width == 0u or component_count == 0u or component_count > 4u) return Error::bad_formed_data;
+        if(segment.size() < 6u + 3u * component_count) return Error::bad_formed_data;
+
+        result.components.resize(component_count);
+        for(std::uint32_t i = 0u; i < component_count; ++i) {
+            sel::Jpeg_component& component {result.components[i]};
+            component.id = segment[6u + 3u * i];
+            component.horizontal_sampling = segment[7u + 3u * i] >> 4u;
+            component.vertical_sampling = segment[7u + 3u * i] & 0x0Fu;
+            component.quantization_table = segment[8u + 3u * i];
+            if(component.horizontal_sampling == 0u or component.horizontal_sampling > 4u) return Error::bad_formed_data;
+            if(component.vertical_sampling == 0u or component.vertical_sampling > 4u) return Error::bad_formed_data;
+            if(component.quantization_table > 3u) return Error::bad_formed_data;
+            state.max_horizontal_sampling = std::max<std::uint32_t>(state.max_horizontal_sampling, component.horizontal_sampling);
+            state.max_vertical_sampling = std::max<std::uint32_t>(state.max_vertical_sampling, component.vertical_sampling);
+        }
+
+        const std::uint32_t mcus_per_line {(result.width + 8u * state.max_horizontal_sampling - 1u) / (8u * state.max_horizontal_sampling)};
+        const std::uint32_t mcu_lines {(result.height + 8u * state.max_vertical_sampling - 1u) / (8u * state.max_vertical_sampling)};
+        for(sel::Jpeg_component& component : result.components) {
+            component.blocks_per_line = mcus_per_line * component.horizontal_sampling;
+            component.block_lines = mcu_lines * component.vertical_sampling;
+            component.coefficients.assign(std::size_t {component.blocks_per_line} * component.block_lines * 64u, 0);
+        }
+
+        state.frame_read = true;
+        return Error::none;
+    }
+
+    // DHT, there can be several tables in one segment
+    Error read_huffman_tables(std::span<const std::uint8_t> segment, Decoder_state& state) noexcept
+    {
+        while(not segment.empty()) {
+            if(segment.size() < 17u) return Error::bad_formed_data;
+            const std::uint32_t table_class {static_cast<std::uint32_t>(segment[0] >> 4u)};
+            const std::uint32_t index {segment[0] & 0x0Fu};
+            if(table_class > 1u or index > 3u) return Error::bad_formed_data;
+
+            const std::span<const std::uint8_t, 16> counts {segment.subspan<1u, 16u>()};
+            std::size_t symbol_count {0u};
+            for(const std::uint8_t count : counts) { symbol_count += count; }
+            if(segment.size() - 17u < symbol_count) return Error::bad_formed_data;
+
+            Huffman_table& table {table_class == 0u ? state.dc_tables[index] : state.ac_tables[index]};
+            const Error error {sel::impl::jpeg::make_huffman_table(counts, segment.subspan(17u, symbol_count), table_class == 1u, table)};
+            if(error != Error::none) return error;
+            segment = segment.subspan(17u + symbol_count);
+        }
+
+        return Error::none;
+    }
+
+    // DQT, the tables are in zigzag order in the segment
+    Error read_quantization_tables(std::span<const std::uint8_t> segment, Decoder_state& state) noexcept
+    {
+        while(not segment.empty()) {
+            const std::uint32_t precision {static_cast<std::uint32_t>(segment[0] >> 4u)}; // 0: 8 bits, 1: 16 bits
+            const std::uint32_t index {segment[0] & 0x0Fu};
+            if(precision > 1u or index > 3u) return Error::bad_formed_data;
+            const std::size_t size {1u + 64u * (precision + 1u)};
+            if(segment.size() < size) return Error::bad_formed_data;
+
+            std::array<std::uint16_t, 64>& table {state.result.quantization_tables[index]};
+            for(std::size_t i = 0u; i < 64u; ++i) {
+                table[sel::impl::jpeg::natural_order[i]] = static_cast<std::uint16_t>(precision == 0u ? segment[1u + i] : read_big_endian_16(segment, 1u + 2u * i));
+            }
+            segment = segment.subspan(size);
+        }
+
+        return Error::none;
+    }
+
+    // the header of a SOS segment
+    Error read_scan_header(std::span<const std::uint8_t> segment, Decoder_state& state, Scan& scan) noexcept
+    {
+        if(not state.frame_read or segment.empty()) return Error::bad_formed_data;
+        scan.component_count = segment[0];
+        if(scan.component_count == 0u or scan.component_count > 4u) return Error::bad_formed_data;
+        if(segment.size() < 4u + 2u * scan.component_count) return Error::bad_formed_data;
+
+        std::uint32_t blocks_per_mcu {0u};
+        for(std::uint32_t i = 0u; i < scan.component_count; ++i) {
+            const std::uint8_t id {segment[1u + 2u * i]};
+            const std::uint32_t dc_index {static_cast<std::uint32_t>(segment[2u + 2u * i] >> 4u)};
+            const std::uint32_t ac_index {segment[2u + 2u * i] & 0x0Fu};
+            const auto component {std::find_if(state.result.components.begin(), state.result.components.end(), [&](const sel::Jpeg_component& c) { return c.id == id; })};
+            if(component == state.result.components.end() or dc_index > 3u or ac_index > 3u) return Error::bad_formed_data;
+            if(not state.dc_tables[dc_index].defined or not state.ac_tables[ac_index].defined) return Error::bad_formed_data;
+
+            scan.components[i] = Scan::Component {&*component, &state.dc_tables[dc_index], &state.ac_tables[ac_index]};
+            blocks_per_mcu += component->horizontal_sampling * component->vertical_sampling;
+        }
+        if(scan.component_count > 1u and blocks_per_mcu > 10u) return Error::bad_formed_data;
+
+        // spectral selection and successive approximation are for progressive JPEGs
+        const std::size_t parameters {1u + 2u * scan.component_count};
+        if(segment[parameters] != 0u or segment[parameters + 1u] != 63u or segment[parameters + 2u] != 0u) return Error::bad_formed_data;
+
+        const sel::Jpeg_coefficients& result {state.result};
+        if(scan.component_count == 1u) {
+            // only the blocks that the component needs, not the ones that complete the MCUs of an interleaved scan
+            const sel::Jpeg_component& component {*scan.components[0].component};
+            const std::uint32_t width {(result.width * component.horizontal_sampling + state.max_horizontal_sampling - 1u) / state.max_horizontal_sampling};
+            const std::uint32_t height {(result.height * component.vertical_sampling + state.max_vertical_sampling - 1u) / state.max_vertical_sampling};
+            scan.mcus_per_line = (width + 7u) / 8u;
+            scan.mcu_count = scan.mcus_per_line * ((height + 7u) / 8u);
+        }
+        else {
+            const sel::Jpeg_component& component {*scan.components[0].component};
+            scan.mcus_per_line = component.blocks_per_line / component.horizontal_sampling;
+            scan.mcu_count = scan.mcus_per_line * (component.block_lines / component.vertical_sampling);
+        }
+        scan.restart_interval = state.restart_interval;
+
+        return Error::none;
+    }
+}
+
+sel::Jpeg_coefficients sel::decode_jpeg_coefficients(std::span<const std::uint8_t> jpeg_data, const std::uint32_t threads)
+{
+    return impl::jpeg::decode_coefficients(jpeg_data, threads).value();
+}
+
+sel::Expected<sel::Jpeg_coefficients> sel::try_decode_jpeg_coefficients(std::span<const std::uint8_t> jpeg_data, const std::uint32_t threads) noexcept
+{
+    try {
+        return impl::jpeg::decode_coefficients(jpeg_data, threads);
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
+
+sel::Error sel::impl::jpeg::make_huffman_table(std::span<const std::uint8_t, 16> counts, std::span<const std::uint8_t> symbols, const bool ac, Huffman_table& table) noexcept
+{
+    table = Huffman_table {};
+    if(symbols.size() > table.symbols.size()) return Error::bad_formed_data;
+
+    // the canonical codes: the codes of each length follow the ones of the previous length, shifted by one bit
+    std::uint32_t code {0u};
+    std::size_t symbol_index {0u};
+    for(std::uint32_t length = 1u; length <= 16u; ++length) {
+        const std::uint32_t count {counts[length - 1u]};
+        table.symbol_offsets[length] = static_cast<std::int32_t>(symbol_index) - static_cast<std::int32_t>(code);
+        for(std::uint32_t i = 0u; i < count; ++i, ++code, ++symbol_index) {
+            if(length > fast_bits) continue;
+            const std::uint32_t first {code << (fast_bits - length)};
+            const std::uint32_t last {(code + 1u) << (fast_bits - length)};
+            for(std::uint32_t j = first; j < last; ++j) {
+                table.fast[j] = Fast_entry {symbols[symbol_index], static_cast<std::uint8_t>(length)};
+            }
+        }
+        // the all ones code is never used, so there must be room for one more code of 16 bits
+        if(code >= (1u << length)) return Error::bad_formed_data;
+
+        table.code_limits[length] = code << (16u - length);
+        code <<= 1u;
+    }
+    table.code_limits[17] = 0xFFFFFFFFu;
+    std::copy(symbols.begin(), symbols.end(), table.symbols.begin());
+
+    if(ac) {
+        for(std::uint32_t bits = 0u; bits < table.fast.size(); ++bits) {
+            const Fast_entry entry {table.fast[bits]};
+            const std::uint32_t size {entry.symbol & 0x0Fu};
+            if(entry.length == 0u or size == 0u or entry.length + size > fast_bits) continue;
+
+            const std::uint32_t extra_bits {(bits >> (fast_bits - entry.length - size)) & ((1u << size) - 1u)};
+            table.fast_ac[bits] = Fast_ac_entry {static_cast<std::int16_t>(extend(extra_bits, size)), static_cast<std::uint8_t>(entry.symbol >> 4u),
+                static_cast<std::uint8_t>(entry.length + size)};
+        }
+    }
+
+    table.defined = true;
+    return Error::none;
+}
+
+sel::Expected<sel::Jpeg_coefficients> sel::impl::jpeg::decode_coefficients(std::span<const std::uint8_t> jpeg_data, const std::uint32_t threads)
+{
+    Decoder_state state;
+    const auto error_at = [](const Error error, const std::size_t position) { return Decode_error {error, position * 8u}; };
+
+    // SOI
+    if(jpeg_data.size() < 2u or jpeg_data[0] != 0xFFu or jpeg_data[1] != 0xD8u) return error_at(Error::bad_formed_data, 0u);
+
+    std::size_t position {2u};
+    while(true) {
+        // any amount of 0xFF bytes can come before a marker
+        if(position >= jpeg_data.size()) return error_at(Error::unexpected_eof, jpeg_data.size());
+        if(jpeg_data[position] != 0xFFu) return error_at(Error::bad_formed_data, position);
+        while(position < jpeg_data.size() and jpeg_data[position] == 0xFFu) { ++position; }
+        if(position >= jpeg_data.size()) return error_at(Error::unexpected_eof, jpeg_data.size());
+
+        const std::size_t marker_position {position - 1u};
+        const std::uint8_t marker {jpeg_data[position]};
+        ++position;
+        if(marker == 0xD9u) break; // EOI
+        if((marker >= 0xD0u and marker <= 0xD7u) or marker == 0x01u) continue; // RSTn and TEM have no segment
+
+        if(jpeg_data.size() - position < 2u) return error_at(Error::unexpected_eof, jpeg_data.size());
+        const std::uint32_t length {read_big_endian_16(jpeg_data, position)};
+        if(length < 2u) return error_at(Error::bad_formed_data, position);
+        if(jpeg_data.size() - position < length) return error_at(Error::unexpected_eof, jpeg_data.size());
+        const std::span<const std::uint8_t> segment {jpeg_data.subspan(position + 2u, length - 2u)};
+        position += length;
+
+        Error error {Error::none};
+        switch(marker) {
+            case 0xC0u: case 0xC1u: error = read_frame(segment, state); break; // baseline and extended sequential, Huffman coded
+            case 0xC4u: error = read_huffman_tables(segment, state); break;
+            case 0xDBu: error = read_quantization_tables(segment, state); break;
+            case 0xDDu:
+                if(segment.size() != 2u) { error = Error::bad_formed_data; }
+                else { state.restart_interval = read_big_endian_16(segment, 0u); }
+                break;
+            // progressive, lossless, hierarchical or arithmetic coded
+            case 0xC2u: case 0xC3u: case 0xC5u: case 0xC6u: case 0xC7u: case 0xC9u: case 0xCAu: case 0xCBu: case 0xCDu: case 0xCEu: case 0xCFu:
+                error = Error::unsupported;
+                break;
+            case 0xDAu: {
+                Scan scan;
+                error = read_scan_header(segment, state, scan);
+                if(error != Error::none) break;
+
+                const sel::Expected<std::size_t> scan_end {decode_scan(jpeg_data, position, scan, threads)};
+                if(not scan_end) return scan_end.error();
+                position = *scan_end;
+                break;
+            }
+            default: break; // APPn, COM and the others don't matter to the coefficients
+        }
+        if(error != Error::none) return error_at(error, marker_position);
+    }
+
+    if(not state.frame_read) return error_at(Error::bad_formed_data, position);
+    return std::move(state.result);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "shared.hpp"
+
+#include <array>
+#include <vector>
+
+namespace sel {
+    // a component of a JPEG and the quantized DCT coefficients of its 8x8 blocks
+    struct Jpeg_component {
+        std::uint8_t id {0u};
+        std::uint8_t horizontal_sampling {1u};
+        std::uint8_t vertical_sampling {1u};
+        std::uint8_t quantization_table {0u};
+        // the blocks cover whole MCUs, so there can be more than the image needs on the right and at the bottom
+        std::uint32_t blocks_per_line {0u};
+        std::uint32_t block_lines {0u};
+        /* 64 per block, the blocks in raster order and the coefficients of each in natural order (not zigzag).
+        * Multiplied by the quantization table, they are what the inverse DCT takes */
+        std::vector<std::int16_t> coefficients;
+
+        std::span<const std::int16_t, 64> block(const std::uint32_t x, const std::uint32_t y) const noexcept
+        {
+            return std::span<const std::int16_t, 64> {coefficients.data() + (std::size_t {y} * blocks_per_line + x) * 64u, 64u};
+        }
+    };
+
+    struct Jpeg_coefficients {
+        std::uint32_t width {0u};
+        std::uint32_t height {0u};
+        std::vector<Jpeg_component> components;
+        // in natural order, the components refer to them by index
+        std::array<std::array<std::uint16_t, 64>, 4> quantization_tables {};
+    };
+
+    /* the entropy decoding of a baseline JPEG (sequential, Huffman coded, 8 bits samples), the stage before the
+    * inverse DCT. The restart intervals of a scan are independent, so a scan that has them is decoded by up to
+    * 'threads' threads (0: as many as the hardware runs concurrently), the result doesn't depend on it */
+    Jpeg_coefficients decode_jpeg_coefficients(std::span<const std::uint8_t> jpeg_data, const std::uint32_t threads = 0u);
+    /* the same without exceptions, see try_decompress_deflate. The offset of an error in the entropy-coded data
+    * is the one of the start of its restart interval */
+    Expected<Jpeg_coefficients> try_decode_jpeg_coefficients(std::span<const std::uint8_t> jpeg_data, const std::uint32_t threads = 0u) noexcept;
+}
+
+namespace sel::impl::jpeg {
+    // no more threads than one per this much entropy-coded data
+    constexpr std::size_t min_bytes_per_thread {1u << 16u}; // 64KB
+
+    // the position of the coefficient in an 8x8 block for each index of the zigzag order
+    constexpr std::array<std::uint8_t, 64> natural_order {
+        0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5,
+        12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+        35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+        58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+    };
+
+    /* codes up to 'fast_bits' bits are decoded with a single lookup of the next fast_bits bits, the longer
+    * ones by comparing them with the largest code of each length */
+    constexpr std::uint32_t fast_bits {10u};
+
+    struct Fast_entry {
+        std::uint8_t symbol {0u};
+        std::uint8_t length {0u}; // 0: the code is longer than fast_bits
+    };
+
+    // an AC coefficient whose code and extra bits both fit in fast_bits
+    struct Fast_ac_entry {
+        std::int16_t value {0};
+        std::uint8_t run {0u}; // of zeros before the coefficient
+        std::uint8_t length {0u}; // of the code and the extra bits, 0: not a fast coefficient
+    };
+
+    struct Huffman_table {
+        std::array<Fast_entry, 1u << fast_bits> fast {};
+        std::array<Fast_ac_entry, 1u << fast_bits> fast_ac {}; // only filled for AC tables
+        // by length: one more than the last code of the length, left-aligned to 16 bits
+        std::array<std::uint32_t, 18> code_limits {};
+        // by length: the index in 'symbols' of the first code of the length, minus that code
+        std::array<std::int32_t, 17> symbol_offsets {};
+        std::array<std::uint8_t, 256> symbols {};
+        bool defined {false};
+    };
+
+    // builds 'table' from the 16 counts of codes by length and the symbols of a DHT segment
+    Error make_huffman_table(std::span<const std::uint8_t, 16> counts, std::span<const std::uint8_t> symbols, const bool ac, Huffman_table& table) noexcept;
+
+    Expected<Jpeg_coefficients> decode_coefficients(std::span<const std::uint8_t> jpeg_data, const std::uint32_t threads);
+}
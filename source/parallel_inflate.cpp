@@ -0,0 +1,324 @@
+#include "parallel_inflate.hpp"
+#include "threads.hpp"
+
+#include <algorithm>
+
+namespace {
+    sel::impl::deflate::Deflate_bitstream bitstream_at(std::span<const std::uint8_t> deflate_data, const std::size_t position)
+    {
+        sel::impl::deflate::Deflate_bitstream bitstream {deflate_data.subspan(position / 8u)};
+        bitstream.skip_bits(static_cast<std::uint32_t>(position % 8u));
+        return bitstream;
+    }
+
+    // the bit-stream reads until the end of the data
+    std::size_t position_of(std::span<const std::uint8_t> deflate_data, const sel::impl::deflate::Deflate_bitstream& bitstream) noexcept
+    {
+        return deflate_data.size() * 8u - bitstream.bits_left();
+    }
+
+    /* the symbols of a Huffman block until its end, for chunks that started without their window. Copies
+    * from before the start of the chunk write the markers of the window, 'marker_end' is updated to the
+    * output after the last marker */
+    template<typename Literal_length_table, typename Distance_table>
+    sel::Error decompress_marked_block(std::vector<std::uint16_t>& output, std::size_t& marker_end, sel::impl::deflate::Deflate_bitstream& bitstream, const Literal_length_table& literal_length_alphabet, const Distance_table& distance_alphabet)
+    {
+        using namespace sel::impl;
+
+        while(true) {
+            std::uint32_t symbol {0u};
+            sel::Error error {deflate::fetch_symbol(literal_length_alphabet, bitstream, symbol)};
+            if(error != sel::Error::none) return error;
+            if(symbol < 256u) {
+                output.push_back(static_cast<std::uint16_t>(symbol));
+                continue;
+            }
+            if(symbol == 256u) return sel::Error::none;
+            if(symbol > 285u) return sel::Error::bad_formed_data;
+
+            symbol -= 257u;
+            std::uint32_t length {0u};
+            if(not bitstream.try_read_bits(deflate::length_extra_bits[symbol], length)) return sel::Error::unexpected_eof;
+            length += deflate::length_bases[symbol];
+            std::uint32_t distance_symbol {0u};
+            error = deflate::fetch_symbol(distance_alphabet, bitstream, distance_symbol);
+            if(error != sel::Error::none) return error;
+            if(distance_symbol > 29u) return sel::Error::bad_formed_data;
+            std::uint32_t distance {0u};
+            if(not bitstream.try_read_bits(deflate::distance_extra_bits[distance_symbol], distance)) return sel::Error::unexpected_eof;
+            distance += deflate::distance_bases[distance_symbol];
+            if(distance > output.size() + deflate::window_size) return sel::Error::bad_formed_data;
+
+            for(std::uint32_t i = 0u; i < length; ++i) {
+                const std::size_t size {output.size()};
+                const std::uint16_t value {size >= distance ? output[size - distance] : static_cast<std::uint16_t>(parallel_inflate::first_marker + deflate::window_size - (distance - size))};
+                if(value >= parallel_inflate::first_marker) { marker_end = size + 1u; }
+                output.push_back(value);
+            }
+        }
+    }
+}
+
+std::vector<std::uint8_t> sel::decompress_deflate_parallel(std::span<const std::uint8_t> deflate_data, const std::uint32_t threads)
+{
+    return impl::parallel_inflate::decompress(deflate_data, threads, 0u);
+}
+
+std::vector<std::uint8_t> sel::impl::parallel_inflate::decompress(std::span<const std::uint8_t> deflate_data, std::uint32_t threads, std::size_t chunk_size)
+{
+    threads = resolve_thread_count(threads);
+    if(chunk_size == 0u) { chunk_size = std::max(min_chunk_size, deflate_data.size() / (threads * chunks_per_thread) + 1u); }
+    const std::size_t chunk_count {std::max<std::size_t>(1u, (deflate_data.size() + chunk_size - 1u) / chunk_size)};
+    threads = static_cast<std::uint32_t>(std::min<std::size_t>(threads, chunk_count));
+
+    std::vector<Chunk> chunks(chunk_count);
+    for(std::size_t i = 0u; i < chunk_count; ++i) {
+        chunks[i].search_start = i * chunk_size * 8u;
+        chunks[i].search_end = std::min((i + 1u) * chunk_size, deflate_data.size()) * 8u;
+    }
+
+    // the first chunk starts where the stream does, the others where a block seems to start
+    for_each_in_parallel(chunk_count, threads, [&](std::uint32_t, const std::size_t i) {
+        Chunk& chunk {chunks[i]};
+        if(i == 0u) {
+            chunk.start = 0u;
+            decompress_with_window(deflate_data, chunk, {});
+            return;
+        }
+
+        std::size_t candidate {find_block_candidate(deflate_data, chunk.search_start, chunk.search_end)};
+        while(candidate != no_position) {
+            chunk.start = candidate;
+            if(decompress_speculatively(deflate_data, chunk) == Error::none) return;
+            candidate = find_block_candidate(deflate_data, candidate + 1u, chunk.search_end);
+        }
+
+        chunk.start = no_position;
+        chunk.marked_output = {};
+        chunk.output = {};
+    });
+
+    /* each chunk must start where the one before it ended, the ones that don't are decompressed again from
+    * there. Meanwhile the windows are passed on, which only needs the last 32KB of each chunk resolved */
+    std::vector<std::uint8_t> window;
+    std::size_t position {0u};
+    bool finished {false};
+    std::size_t total_size {0u};
+    for(Chunk& chunk : chunks) {
+        if(finished or position >= chunk.search_end) {
+            chunk.empty = true;
+            chunk.marked_output = {};
+            chunk.output = {};
+            continue;
+        }
+        if(&chunk != &chunks.front() and not starts_at(chunk, position)) {
+            chunk.start = position;
+            decompress_with_window(deflate_data, chunk, window);
+        }
+
+        chunk.window = window;
+        window = next_window(window, chunk);
+        position = chunk.end;
+        finished = chunk.last;
+        total_size += chunk.marked_output.size() + chunk.output.size() - chunk.history;
+    }
+    if(not finished) throw Exception {Error::unexpected_eof};
+
+    std::vector<std::uint8_t> inflated_data(total_size);
+    std::vector<std::size_t> offsets(chunk_count);
+    for(std::size_t i = 1u; i < chunk_count; ++i) {
+        offsets[i] = offsets[i - 1u] + chunks[i - 1u].marked_output.size() + chunks[i - 1u].output.size() - chunks[i - 1u].history;
+    }
+    for_each_in_parallel(chunk_count, threads, [&](std::uint32_t, const std::size_t i) {
+        if(not chunks[i].empty) { write_output(chunks[i], inflated_data.data() + offsets[i]); }
+    });
+
+    return inflated_data;
+}
+
+std::size_t sel::impl::parallel_inflate::find_block_candidate(std::span<const std::uint8_t> deflate_data, const std::size_t first, const std::size_t last)
+{
+    for(std::size_t position = first; position < last; ++position) {
+        if(is_dynamic_block_header(deflate_data, position) or is_stored_block_header(deflate_data, position)) return position;
+    }
+    return no_position;
+}
+
+bool sel::impl::parallel_inflate::is_dynamic_block_header(std::span<const std::uint8_t> deflate_data, const std::size_t position)
+{
+    deflate::Deflate_bitstream bitstream {bitstream_at(deflate_data, position)};
+    // BFINAL = 0, BTYPE = 2, HLIT, HDIST, HCLEN
+    const std::uint32_t bits {bitstream.peek_bits(17u)};
+    if((bits & 0b111u) != 0b100u) return false;
+    if(((bits >> 3u) & 0x1Fu) > 29u or ((bits >> 8u) & 0x1Fu) > 29u) return false;
+    const std::uint32_t hclen {(bits >> 13u) + 4u};
+    if(bitstream.bits_left() < 17u + 3u * hclen) return false;
+    bitstream.skip_bits(17u);
+
+    // the code of the code-length alphabet must be complete, most random bits fail here
+    std::int32_t codes_left {1 << 7};
+    for(std::uint32_t i = 0u; i < hclen; ++i) {
+        const std::uint32_t bit_length {bitstream.read_bits(3u)};
+        if(bit_length != 0u) { codes_left -= 1 << (7u - bit_length); }
+    }
+    return codes_left == 0;
+}
+
+bool sel::impl::parallel_inflate::is_stored_block_header(std::span<const std::uint8_t> deflate_data, const std::size_t position)
+{
+    // BFINAL = 0 and BTYPE = 0, zeros until the byte boundary and then LEN and its complement
+    const std::size_t padding {(8u - (position + 3u) % 8u) % 8u};
+    const std::size_t data_start {(position + 3u + padding) / 8u};
+    if(data_start + 4u > deflate_data.size()) return false;
+
+    deflate::Deflate_bitstream bitstream {bitstream_at(deflate_data, position)};
+    if(bitstream.peek_bits(static_cast<std::uint32_t>(3u + padding)) != 0u) return false;
+
+    const std::uint32_t len {deflate_data[data_start] | (std::uint32_t {deflate_data[data_start + 1u]} << 8u)};
+    const std::uint32_t nlen {deflate_data[data_start + 2u] | (std::uint32_t {deflate_data[data_start + 3u]} << 8u)};
+    return (len ^ 0xFFFFu) == nlen;
+}
+
+sel::Error sel::impl::parallel_inflate::decompress_speculatively(std::span<const std::uint8_t> deflate_data, Chunk& chunk)
+{
+    chunk.marked_output.clear();
+    chunk.output.clear();
+    chunk.history = 0u;
+    chunk.last = false;
+
+    deflate::Deflate_bitstream bitstream {bitstream_at(deflate_data, chunk.start)};
+    deflate::Inflate_state state;
+    deflate::Dynamic_tables tables;
+    std::vector<std::uint16_t>& output {chunk.marked_output};
+    std::size_t marker_end {0u}; // the output after the last marker
+    bool first_block {true};
+    while(true) {
+        Error error {deflate::read_block_header(state, tables, bitstream)};
+        if(error != Error::none) return error;
+        if(first_block) {
+            chunk.starts_with_stored_block = state.step == deflate::Inflate_state::Step::stored_block;
+            first_block = false;
+        }
+
+        if(state.step == deflate::Inflate_state::Step::stored_block) {
+            if(bitstream.bits_left() < std::size_t {state.stored_bytes_left} * 8u) return Error::unexpected_eof;
+            const std::span<const std::uint8_t> bytes {bitstream.read_bytes(state.stored_bytes_left)};
+            output.insert(output.end(), bytes.begin(), bytes.end());
+        }
+        else {
+            error = state.fixed_block
+                ? decompress_marked_block(output, marker_end, bitstream, deflate::fixed_literal_length_alphabet, deflate::fixed_distance_alphabet)
+                : decompress_marked_block(output, marker_end, bitstream, tables.literal_length_alphabet(), tables.distance_alphabet());
+            if(error != Error::none) return error;
+        }
+
+        chunk.end = position_of(deflate_data, bitstream);
+        if(state.last_block or chunk.end >= chunk.search_end) {
+            chunk.last = state.last_block;
+            return Error::none;
+        }
+
+        /* once the last 32KB have no markers, nothing after them can refer to the window: they become
+        * the start of the byte output and the rest is decompressed like any other stream */
+        if(output.size() - marker_end >= deflate::window_size) {
+            const std::size_t bytes_start {output.size() - deflate::window_size};
+            chunk.output.resize(deflate::window_size);
+            std::transform(output.begin() + bytes_start, output.end(), chunk.output.begin(), [](const std::uint16_t value) {
+                return static_cast<std::uint8_t>(value);
+            });
+            output.resize(bytes_start);
+            return decompress_bytes(deflate_data, bitstream, chunk);
+        }
+    }
+}
+
+void sel::impl::parallel_inflate::decompress_with_window(std::span<const std::uint8_t> deflate_data, Chunk& chunk, std::span<const std::uint8_t> window)
+{
+    chunk.marked_output = {};
+    chunk.output.assign(window.begin(), window.end());
+    chunk.history = window.size();
+    chunk.last = false;
+
+    deflate::Deflate_bitstream bitstream {bitstream_at(deflate_data, chunk.start)};
+    const Error error {decompress_bytes(deflate_data, bitstream, chunk)};
+    if(error != Error::none) throw Exception {error};
+}
+
+sel::Error sel::impl::parallel_inflate::decompress_bytes(std::span<const std::uint8_t> deflate_data, deflate::Deflate_bitstream& bitstream, Chunk& chunk)
+{
+    deflate::Inflate_state state;
+    deflate::Dynamic_tables tables;
+    state.stop_at_block_boundaries = true;
+    deflate::Output_buffer output {chunk.output.data(), chunk.output.size(), chunk.output.size(), &chunk.output};
+    // about three times the compressed data that is left in the chunk
+    output.reserve(std::max<std::size_t>((chunk.search_end - std::min(chunk.search_end, position_of(deflate_data, bitstream))) / 8u * 3u, 5000u));
+
+    while(true) {
+        const deflate::Inflate_status status {deflate::inflate(state, tables, output, bitstream)};
+        chunk.end = position_of(deflate_data, bitstream);
+        if(status == deflate::Inflate_status::done) {
+            chunk.last = true;
+            break;
+        }
+        if(status == deflate::Inflate_status::bad_formed_data) return Error::bad_formed_data;
+        // the bit-stream has the rest of the data, and the vector grows
+        if(status != deflate::Inflate_status::block_boundary) return Error::unexpected_eof;
+        if(chunk.end >= chunk.search_end) break;
+    }
+
+    chunk.output.resize(output.size);
+    return Error::none;
+}
+
+bool sel::impl::parallel_inflate::starts_at(const Chunk& chunk, const std::size_t position) noexcept
+{
+    if(chunk.start == no_position) return false;
+    if(chunk.start == position) return true;
+
+    /* a stored block header can be found at any of the zeros before its byte boundary, all of them
+    * decompress the same if the real block starts after the one that was found */
+    const auto header_end {[](const std::size_t header_start) { return (header_start + 3u + 7u) / 8u; }};
+    return chunk.starts_with_stored_block and position > chunk.start and header_end(position) == header_end(chunk.start);
+}
+
+std::vector<std::uint8_t> sel::impl::parallel_inflate::next_window(std::span<const std::uint8_t> window, const Chunk& chunk)
+{
+    const std::size_t bytes_size {chunk.output.size() - chunk.history};
+    const std::size_t chunk_size {chunk.marked_output.size() + bytes_size};
+
+    std::vector<std::uint8_t> next;
+    next.reserve(deflate::window_size);
+    if(chunk_size < deflate::window_size) {
+        const std::size_t kept {std::min(window.size(), deflate::window_size - chunk_size)};
+        next.insert(next.end(), window.end() - kept, window.end());
+    }
+
+    const std::size_t first {chunk_size - std::min(chunk_size, deflate::window_size)}; // in the output of the chunk
+    for(std::size_t i = first; i < chunk.marked_output.size(); ++i) {
+        next.push_back(resolve_marker(chunk.marked_output[i], window));
+    }
+    const std::size_t first_byte {first > chunk.marked_output.size() ? first - chunk.marked_output.size() : 0u};
+    next.insert(next.end(), chunk.output.begin() + chunk.history + first_byte, chunk.output.end());
+
+    return next;
+}
+
+void sel::impl::parallel_inflate::write_output(const Chunk& chunk, std::uint8_t* output)
+{
+    for(const std::uint16_t value : chunk.marked_output) {
+        *output = resolve_marker(value, chunk.window);
+        ++output;
+    }
+    if(chunk.output.size() != chunk.history) { std::memcpy(output, chunk.output.data() + chunk.history, chunk.output.size() - chunk.history); }
+}
+
+std::uint8_t sel::impl::parallel_inflate::resolve_marker(const std::uint16_t value, std::span<const std::uint8_t> window)
+{
+    if(value < first_marker) return static_cast<std::uint8_t>(value);
+
+    // the window is shorter than 32KB at the beginning of the stream, before it there's nothing to refer to
+    const std::size_t window_start {deflate::window_size - window.size()};
+    const std::size_t index {value - first_marker};
+    if(index < window_start) throw Exception {Error::bad_formed_data};
+    return window[index - window_start];
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "shared.hpp"
+#include "deflate.hpp"
+
+#include <vector>
+#include <limits>
+
+namespace sel {
+    /* decompresses a single deflate stream with 'threads' threads (0: as many as the hardware runs concurrently),
+    * the output is the same as the one of decompress_deflate. The compressed data is split into chunks, and
+    * each thread looks for the first block that starts in its chunk and decompresses from there without the
+    * 32KB before it, which are resolved once the chunks before it are done. A chunk where the block was
+    * guessed wrong is decompressed again after the chunk before it, so the worst case is about the speed
+    * of decompress_deflate */
+    std::vector<std::uint8_t> decompress_deflate_parallel(std::span<const std::uint8_t> deflate_data, const std::uint32_t threads = 0u);
+}
+
+namespace sel::impl::parallel_inflate {
+    /* of compressed data. More chunks balance the work better, but every chunk starts with a search and
+    * with a slower decompression until the data stops referring to the window before it */
+    constexpr std::size_t min_chunk_size {1u << 20u}; // 1MB
+    constexpr std::size_t chunks_per_thread {4u};
+    constexpr std::size_t no_position {std::numeric_limits<std::size_t>::max()};
+
+    /* a chunk that is decompressed without the data before it writes markers for the bytes of that window:
+    * first_marker is the first of the 32KB before the chunk, first_marker + 32767 the last one */
+    constexpr std::uint32_t first_marker {256u};
+
+    // the positions are bit offsets in the compressed data
+    struct Chunk {
+        std::size_t search_start {0u};
+        std::size_t search_end {0u}; // the chunk ends at the first block boundary from here
+        std::size_t start {no_position}; // the block boundary where the decompression started
+        bool starts_with_stored_block {false};
+        std::size_t end {0u};
+        bool last {false}; // it ends with the last block of the stream
+        bool empty {false}; // the chunk before it already reached search_end
+
+        // the decompressed data is 'marked_output' followed by 'output' after its first 'history' bytes
+        std::vector<std::uint16_t> marked_output; // while the data may refer to the window, with markers
+        std::vector<std::uint8_t> output;
+        std::size_t history {0u};
+        std::vector<std::uint8_t> window; // the (up to) 32KB before the chunk, known once the chunks before it are joined
+    };
+
+    // 'chunk_size' zero means that it depends on the size of the data and on the threads
+    std::vector<std::uint8_t> decompress(std::span<const std::uint8_t> deflate_data, std::uint32_t threads, std::size_t chunk_size);
+
+    /* the first position in [first, last) that has the header of a dynamic or stored block which isn't the last one,
+    * no_position if there isn't. Fixed blocks have no header to tell them from other data */
+    std::size_t find_block_candidate(std::span<const std::uint8_t> deflate_data, const std::size_t first, const std::size_t last);
+    bool is_dynamic_block_header(std::span<const std::uint8_t> deflate_data, const std::size_t position);
+    bool is_stored_block_header(std::span<const std::uint8_t> deflate_data, const std::size_t position);
+
+    /* from chunk.start without the window, an error if the start wasn't really a block boundary (most of the time).
+    * Wrong candidates are common, so they are rejected without throwing */
+    Error decompress_speculatively(std::span<const std::uint8_t> deflate_data, Chunk& chunk);
+    // from chunk.start with the window, throws if the data is malformed
+    void decompress_with_window(std::span<const std::uint8_t> deflate_data, Chunk& chunk, std::span<const std::uint8_t> window);
+    // continues into chunk.output, which already has the history
+    Error decompress_bytes(std::span<const std::uint8_t> deflate_data, deflate::Deflate_bitstream& bitstream, Chunk& chunk);
+
+    // the chunk decompressed from the end of the chunk before it, or from where that is the same
+    bool starts_at(const Chunk& chunk, const std::size_t position) noexcept;
+    // the last 32KB of 'window' followed by the output of 'chunk'
+    std::vector<std::uint8_t> next_window(std::span<const std::uint8_t> window, const Chunk& chunk);
+    // writes the whole output of the chunk, which must have its window
+    void write_output(const Chunk& chunk, std::uint8_t* output);
+    std::uint8_t resolve_marker(const std::uint16_t value, std::span<const std::uint8_t> window);
+}
@@ -0,0 +1,578 @@
+#include "png.hpp"
+#include "adler32.hpp"
+#include "crc32.hpp"
+#include "deflate.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef SELEBITS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    using sel::Error;
+    using sel::impl::png::Filter;
+
+    constexpr std::array<std::uint8_t, 8> signature {137u, 80u, 78u, 71u, 13u, 10u, 26u, 10u};
+
+    constexpr std::uint32_t chunk_type(const char (&name)[5]) noexcept
+    {
+        return (static_cast<std::uint32_t>(name[0]) << 24u) | (static_cast<std::uint32_t>(name[1]) << 16u) |
+            (static_cast<std::uint32_t>(name[2]) << 8u) | static_cast<std::uint32_t>(name[3]);
+    }
+
+    // a decoder that doesn't know an ancillary chunk (lowercase first letter) can skip it, not a critical one
+    constexpr bool is_critical(const std::uint32_t type) noexcept { return (type & 0x20000000u) == 0u; }
+
+    // the passes of Adam7 interlacing: where their first pixel is and how far apart their pixels are
+    struct Pass {
+        std::uint32_t x {0u};
+        std::uint32_t y {0u};
+        std::uint32_t x_step {1u};
+        std::uint32_t y_step {1u};
+    };
+
+    constexpr std::array<Pass, 7> adam7_passes {{
+        {0u, 0u, 8u, 8u}, {4u, 0u, 8u, 8u}, {0u, 4u, 4u, 8u}, {2u, 0u, 4u, 4u}, {0u, 2u, 2u, 4u}, {1u, 0u, 2u, 2u}, {0u, 1u, 1u, 2u}
+    }};
+    constexpr std::array<Pass, 1> no_passes {{{0u, 0u, 1u, 1u}}};
+
+    // the size of a reduced image, 0 if a pass has no pixels
+    struct Pass_size {
+        std::uint32_t width {0u};
+        std::uint32_t height {0u};
+        std::size_t row_size {0u}; // without the filter byte
+    };
+
+    std::uint8_t paeth_predictor(const std::int32_t a, const std::int32_t b, const std::int32_t c) noexcept
+    {
+        const std::int32_t pa {std::abs(b - c)};
+        const std::int32_t pb {std::abs(a - c)};
+        const std::int32_t pc {std::abs(a + b - 2 * c)};
+        return static_cast<std::uint8_t>(pa <= pb and pa <= pc ? a : pb <= pc ? b : c);
+    }
+
+    void unfilter_row_scalar(const Filter filter, const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size, const std::uint32_t bytes_per_pixel) noexcept
+    {
+        // the pixels of the first column have zeros on their left
+        const std::size_t first {std::min<std::size_t>(bytes_per_pixel, size)};
+        switch(filter) {
+        case Filter::none:
+            std::memcpy(row, filtered, size);
+            break;
+        case Filter::sub:
+            std::memcpy(row, filtered, first);
+            for(std::size_t i = first; i < size; ++i) { row[i] = static_cast<std::uint8_t>(filtered[i] + row[i - bytes_per_pixel]); }
+            break;
+        case Filter::up:
+            for(std::size_t i = 0u; i < size; ++i) { row[i] = static_cast<std::uint8_t>(filtered[i] + previous[i]); }
+            break;
+        case Filter::average:
+            for(std::size_t i = 0u; i < first; ++i) { row[i] = static_cast<std::uint8_t>(filtered[i] + previous[i] / 2u); }
+            for(std::size_t i = first; i < size; ++i) {
+                row[i] = static_cast<std::uint8_t>(filtered[i] + (row[i - bytes_per_pixel] + previous[i]) / 2u);
+            }
+            break;
+        case Filter::paeth:
+            // the predictor of (0, b, 0) is b
+            for(std::size_t i = 0u; i < first; ++i) { row[i] = static_cast<std::uint8_t>(filtered[i] + previous[i]); }
+            for(std::size_t i = first; i < size; ++i) {
+                row[i] = static_cast<std::uint8_t>(filtered[i] + paeth_predictor(row[i - bytes_per_pixel], previous[i], previous[i - bytes_per_pixel]));
+            }
+            break;
+        }
+    }
+
+#ifdef SELEBITS_X86
+    /* Sub, Average and Paeth depend on the pixel on the left, so the bytes of a row can't be done 16 at a time,
+    * but the bytes of a pixel can be done at once. A pixel is in the low bytes of a vector */
+    template<std::uint32_t bytes_per_pixel>
+    SELEBITS_TARGET("ssse3")
+    inline __m128i load_pixel(const std::uint8_t* source) noexcept
+    {
+        // put together in a general purpose register, through memory the wide load would stall on the narrow stores
+        if constexpr(bytes_per_pixel == 8u) { return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source)); }
+        else if constexpr(bytes_per_pixel == 6u) {
+            std::uint32_t low;
+            std::uint16_t high;
+            std::memcpy(&low, source, sizeof(low));
+            std::memcpy(&high, source + sizeof(low), sizeof(high));
+            return _mm_unpacklo_epi32(_mm_cvtsi32_si128(static_cast<int>(low)), _mm_cvtsi32_si128(high));
+        }
+        else if constexpr(bytes_per_pixel == 4u) {
+            std::uint32_t bytes;
+            std::memcpy(&bytes, source, sizeof(bytes));
+            return _mm_cvtsi32_si128(static_cast<int>(bytes));
+        }
+        else {
+            std::uint16_t low;
+            std::memcpy(&low, source, sizeof(low));
+            return _mm_cvtsi32_si128(static_cast<int>(low | (std::uint32_t {source[2]} << 16u)));
+        }
+    }
+
+    template<std::uint32_t bytes_per_pixel>
+    SELEBITS_TARGET("ssse3")
+    inline void store_pixel(std::uint8_t* destination, const __m128i pixel) noexcept
+    {
+        if constexpr(bytes_per_pixel == 8u) { _mm_storel_epi64(reinterpret_cast<__m128i*>(destination), pixel); }
+        else if constexpr(bytes_per_pixel == 6u) {
+            const std::uint32_t low {static_cast<std::uint32_t>(_mm_cvtsi128_si32(pixel))};
+            const std::uint16_t high {static_cast<std::uint16_t>(_mm_extract_epi16(pixel, 2))};
+            std::memcpy(destination, &low, sizeof(low));
+            std::memcpy(destination + sizeof(low), &high, sizeof(high));
+        }
+        else if constexpr(bytes_per_pixel == 4u) {
+            const std::uint32_t bytes {static_cast<std::uint32_t>(_mm_cvtsi128_si32(pixel))};
+            std::memcpy(destination, &bytes, sizeof(bytes));
+        }
+        else {
+            const std::uint32_t bytes {static_cast<std::uint32_t>(_mm_cvtsi128_si32(pixel))};
+            const std::uint16_t low {static_cast<std::uint16_t>(bytes)};
+            std::memcpy(destination, &low, sizeof(low));
+            destination[2] = static_cast<std::uint8_t>(bytes >> 16u);
+        }
+    }
+
+    template<std::uint32_t bytes_per_pixel>
+    SELEBITS_TARGET("ssse3")
+    void unfilter_sub_ssse3(const std::uint8_t* filtered, std::uint8_t* row, const std::size_t size) noexcept
+    {
+        __m128i left {_mm_setzero_si128()};
+        for(std::size_t i = 0u; i < size; i += bytes_per_pixel) {
+            left = _mm_add_epi8(left, load_pixel<bytes_per_pixel>(filtered + i));
+            store_pixel<bytes_per_pixel>(row + i, left);
+        }
+    }
+
+    template<std::uint32_t bytes_per_pixel>
+    SELEBITS_TARGET("ssse3")
+    void unfilter_average_ssse3(const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size) noexcept
+    {
+        // _mm_avg_epu8 rounds up, the low bit of a ^ b is the one that it shouldn't have added
+        const __m128i ones {_mm_set1_epi8(1)};
+        __m128i left {_mm_setzero_si128()};
+        for(std::size_t i = 0u; i < size; i += bytes_per_pixel) {
+            const __m128i above {load_pixel<bytes_per_pixel>(previous + i)};
+            const __m128i average {_mm_sub_epi8(_mm_avg_epu8(left, above), _mm_and_si128(_mm_xor_si128(left, above), ones))};
+            left = _mm_add_epi8(average, load_pixel<bytes_per_pixel>(filtered + i));
+            store_pixel<bytes_per_pixel>(row + i, left);
+        }
+    }
+
+    // the lanes of 'a' where 'mask' is set and the ones of 'b' elsewhere, without SSE4.1's blend
+    SELEBITS_TARGET("ssse3")
+    inline __m128i select(const __m128i mask, const __m128i a, const __m128i b) noexcept
+    {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    }
+
+    // the predictor in 16 bits lanes, where the differences fit
+    template<std::uint32_t bytes_per_pixel>
+    SELEBITS_TARGET("ssse3")
+    void unfilter_paeth_ssse3(const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size) noexcept
+    {
+        const __m128i zero {_mm_setzero_si128()};
+        __m128i left {zero};
+        __m128i upper_left {zero};
+        for(std::size_t i = 0u; i < size; i += bytes_per_pixel) {
+            const __m128i above {_mm_unpacklo_epi8(load_pixel<bytes_per_pixel>(previous + i), zero)};
+
+            // p = left + above - upper_left, the distances of p to left, above and upper_left
+            const __m128i signed_pa {_mm_sub_epi16(above, upper_left)};
+            const __m128i signed_pb {_mm_sub_epi16(left, upper_left)};
+            const __m128i pa {_mm_abs_epi16(signed_pa)};
+            const __m128i pb {_mm_abs_epi16(signed_pb)};
+            const __m128i pc {_mm_abs_epi16(_mm_add_epi16(signed_pa, signed_pb))};
+            const __m128i smallest {_mm_min_epi16(pc, _mm_min_epi16(pa, pb))};
+
+            // ties go to left, then to above
+            const __m128i b_or_c {select(_mm_cmpeq_epi16(pb, smallest), above, upper_left)};
+            const __m128i predictor {select(_mm_cmpeq_epi16(pa, smallest), left, b_or_c)};
+
+            const __m128i pixel {_mm_add_epi8(_mm_packus_epi16(predictor, predictor), load_pixel<bytes_per_pixel>(filtered + i))};
+            store_pixel<bytes_per_pixel>(row + i, pixel);
+            left = _mm_unpacklo_epi8(pixel, zero);
+            upper_left = above;
+        }
+    }
+
+    SELEBITS_TARGET("ssse3")
+    void unfilter_up_ssse3(const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size) noexcept
+    {
+        std::size_t i {0u};
+        for(; i + 16u <= size; i += 16u) {
+            const __m128i bytes {_mm_loadu_si128(reinterpret_cast<const __m128i*>(filtered + i))};
+            const __m128i above {_mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i))};
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i), _mm_add_epi8(bytes, above));
+        }
+        for(; i < size; ++i) { row[i] = static_cast<std::uint8_t>(filtered[i] + previous[i]); }
+    }
+
+    template<std::uint32_t bytes_per_pixel>
+    SELEBITS_TARGET("ssse3")
+    void unfilter_pixels_ssse3(const Filter filter, const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size) noexcept
+    {
+        if(filter == Filter::sub) { unfilter_sub_ssse3<bytes_per_pixel>(filtered, row, size); }
+        else if(filter == Filter::average) { unfilter_average_ssse3<bytes_per_pixel>(filtered, row, previous, size); }
+        else { unfilter_paeth_ssse3<bytes_per_pixel>(filtered, row, previous, size); }
+    }
+
+    /* the pixels of 3 and 4 bytes (8 bits RGB and RGBA, 16 bits gray and alpha) and of 6 and 8 bytes (16 bits
+    * RGB and RGBA) fit in the low 8 bytes of a vector, the smaller ones are left to the scalar code */
+    SELEBITS_TARGET("ssse3")
+    void unfilter_row_ssse3(const Filter filter, const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size, const std::uint32_t bytes_per_pixel) noexcept
+    {
+        if(filter == Filter::none) { std::memcpy(row, filtered, size); }
+        else if(filter == Filter::up) { unfilter_up_ssse3(filtered, row, previous, size); }
+        else if(bytes_per_pixel == 3u) { unfilter_pixels_ssse3<3u>(filter, filtered, row, previous, size); }
+        else if(bytes_per_pixel == 4u) { unfilter_pixels_ssse3<4u>(filter, filtered, row, previous, size); }
+        else if(bytes_per_pixel == 6u) { unfilter_pixels_ssse3<6u>(filter, filtered, row, previous, size); }
+        else if(bytes_per_pixel == 8u) { unfilter_pixels_ssse3<8u>(filter, filtered, row, previous, size); }
+        else { unfilter_row_scalar(filter, filtered, row, previous, size, bytes_per_pixel); }
+    }
+#endif
+
+    using Unfilter_function = void (*)(const Filter, const std::uint8_t*, std::uint8_t*, const std::uint8_t*, const std::size_t, const std::uint32_t) noexcept;
+
+    Unfilter_function choose_unfilter_function() noexcept
+    {
+#ifdef SELEBITS_X86
+        if(sel::impl::cpu_features().ssse3) return unfilter_row_ssse3;
+#endif
+        return unfilter_row_scalar;
+    }
+
+    // the pixels of a row of a pass go every x_step pixels of a row of the image, starting at 'x'
+    void deinterlace_row(const std::uint8_t* pass_row, std::uint8_t* image_row, const Pass& pass, const std::uint32_t width, const std::uint32_t bits_per_pixel) noexcept
+    {
+        if(bits_per_pixel >= 8u) {
+            const std::uint32_t bytes_per_pixel {bits_per_pixel / 8u};
+            for(std::uint32_t i = 0u; i < width; ++i) {
+                std::memcpy(image_row + (std::size_t {pass.x} + std::size_t {i} * pass.x_step) * bytes_per_pixel, pass_row + std::size_t {i} * bytes_per_pixel, bytes_per_pixel);
+            }
+            return;
+        }
+
+        // the pixels are packed from the most significant bit, the image starts with zeros
+        const std::uint32_t mask {(1u << bits_per_pixel) - 1u};
+        for(std::uint32_t i = 0u; i < width; ++i) {
+            const std::size_t source_bit {std::size_t {i} * bits_per_pixel};
+            const std::uint32_t pixel {(pass_row[source_bit / 8u] >> (8u - bits_per_pixel - source_bit % 8u)) & mask};
+            const std::size_t destination_bit {(std::size_t {pass.x} + std::size_t {i} * pass.x_step) * bits_per_pixel};
+            image_row[destination_bit / 8u] |= static_cast<std::uint8_t>(pixel << (8u - bits_per_pixel - destination_bit % 8u));
+        }
+    }
+
+    /* the zlib stream of the IDAT chunks, which is split among them anywhere. The stream is inflated where it
+    * is, a row at a time, and each row is unfiltered (and put in its place if the image is interlaced) as soon
+    * as it's complete. The Adler-32 is computed on each row while it's in the cache */
+    class Image_data_decoder {
+    public:
+        Image_data_decoder(sel::Png_image& image, std::span<const Pass> passes, std::span<const Pass_size> pass_sizes) :
+            m_image {image},
+            m_passes {passes},
+            m_pass_sizes {pass_sizes},
+            m_bits_per_pixel {image.channels() * image.bit_depth},
+            m_bytes_per_pixel {std::max(1u, m_bits_per_pixel / 8u)},
+            m_filtered(1u + image.row_size()),
+            m_zeros(image.row_size()),
+            m_pass_rows(image.interlaced ? 2u * image.row_size() : 0u)
+        {
+            next_pass();
+        }
+
+        // the data of the next IDAT chunk
+        Error feed(std::span<const std::uint8_t> data);
+        // after the last IDAT chunk
+        Error finish();
+    private:
+        enum class Step { zlib_header, image_data, trailer };
+
+        Error read_zlib_header() noexcept;
+        Error finish_row() noexcept;
+        void next_pass() noexcept;
+
+        sel::Png_image& m_image;
+        std::span<const Pass> m_passes;
+        std::span<const Pass_size> m_pass_sizes;
+        const std::uint32_t m_bits_per_pixel;
+        const std::uint32_t m_bytes_per_pixel;
+
+        Step m_step {Step::zlib_header};
+        std::array<std::uint8_t, 4> m_header_bytes {}; // CMF and FLG, then ADLER32
+        std::size_t m_header_size {0u};
+
+        sel::Inflater m_inflater;
+        std::uint32_t m_adler {1u};
+        std::vector<std::uint8_t> m_filtered; // the filter and the row, as they come out of the inflater
+        std::size_t m_filtered_size {0u};
+        std::vector<std::uint8_t> m_zeros; // the row above the first one of each pass
+        std::vector<std::uint8_t> m_pass_rows; // the current and the previous row of a pass, when interlaced
+        std::size_t m_pass {0u}; // m_passes.size() once the rows are all read
+        std::uint32_t m_row {0u}; // in the pass
+    };
+
+    Error Image_data_decoder::feed(std::span<const std::uint8_t> data)
+    {
+        while(true) {
+            if(m_step == Step::zlib_header) {
+                const std::size_t amount {std::min(data.size(), 2u - m_header_size)};
+                std::copy_n(data.data(), amount, m_header_bytes.data() + m_header_size);
+                m_header_size += amount;
+                data = data.subspan(amount);
+                if(m_header_size < 2u) return Error::none;
+
+                const Error error {read_zlib_header()};
+                if(error != Error::none) return error;
+                m_step = Step::image_data;
+                m_header_size = 0u;
+            }
+
+            if(m_step == Step::trailer) {
+                // what follows ADLER32 is ignored
+                const std::size_t amount {std::min(data.size(), 4u - m_header_size)};
+                std::copy_n(data.data(), amount, m_header_bytes.data() + m_header_size);
+                m_header_size += amount;
+                return Error::none;
+            }
+
+            // the data after the last row, if any, is only checked
+            const bool rows_left {m_pass < m_passes.size()};
+            const std::size_t row_end {rows_left ? 1u + m_pass_sizes[m_pass].row_size : 0u};
+            const std::span<std::uint8_t> output {rows_left ? std::span<std::uint8_t> {m_filtered.data() + m_filtered_size, row_end - m_filtered_size} :
+                std::span<std::uint8_t> {m_filtered}};
+            const sel::Expected<sel::Inflater::Result> inflated {m_inflater.try_inflate(data, output)};
+            if(not inflated) return inflated.error().error;
+            const sel::Inflater::Result& result {*inflated};
+            data = data.subspan(result.bytes_read);
+
+            if(rows_left) {
+                m_filtered_size += result.bytes_written;
+                if(m_filtered_size == row_end) {
+                    const Error error {finish_row()};
+                    if(error != Error::none) return error;
+                }
+            }
+            else { m_adler = sel::adler32(output.first(result.bytes_written), m_adler); }
+
+            if(m_inflater.finished()) {
+                // the input that the inflater kept can have the beginning of ADLER32
+                const std::span<const std::uint8_t> after_end {m_inflater.input_after_end()};
+                const std::size_t amount {std::min<std::size_t>(after_end.size(), 4u)};
+                std::copy_n(after_end.data(), amount, m_header_bytes.data());
+                m_header_size = amount;
+                m_step = Step::trailer;
+                continue;
+            }
+            // the inflater can have more output than there was room for, even without input
+            if(data.empty() and result.bytes_written == 0u) return Error::none;
+        }
+    }
+
+    Error Image_data_decoder::finish()
+    {
+        // what the inflater still has
+        if(m_step == Step::image_data) {
+            const Error error {feed({})};
+            if(error != Error::none) return error;
+        }
+        if(m_pass < m_passes.size() or m_step != Step::trailer or m_header_size < 4u) return Error::unexpected_eof;
+
+        sel::impl::Bytestream trailer {m_header_bytes};
+        if(trailer.get_from_big_endian<std::uint32_t>() != m_adler) return Error::checksum_mismatch;
+        return Error::none;
+    }
+
+    // the same checks as zlib's, PNG doesn't allow a preset dictionary
+    Error Image_data_decoder::read_zlib_header() noexcept
+    {
+        const std::uint32_t cmf {m_header_bytes[0]};
+        const std::uint32_t flg {m_header_bytes[1]};
+        if((cmf & 0x0Fu) != 8u or (cmf >> 4u) > 7u) return Error::bad_formed_data;
+        if(((cmf << 8u) | flg) % 31u != 0u) return Error::bad_formed_data;
+        if((flg & 0x20u) != 0u) return Error::bad_formed_data;
+        return Error::none;
+    }
+
+    Error Image_data_decoder::finish_row() noexcept
+    {
+        const Pass_size& size {m_pass_sizes[m_pass]};
+        m_adler = sel::adler32(std::span<const std::uint8_t> {m_filtered.data(), m_filtered_size}, m_adler);
+        m_filtered_size = 0u;
+
+        const std::uint8_t filter {m_filtered[0]};
+        if(filter > static_cast<std::uint8_t>(Filter::paeth)) return Error::bad_formed_data;
+
+        const std::size_t image_row_size {m_image.row_size()};
+        if(not m_image.interlaced) {
+            // unfiltered straight into the image, where the row above is too
+            std::uint8_t* const row {m_image.pixels.data() + std::size_t {m_row} * image_row_size};
+            const std::uint8_t* const previous {m_row == 0u ? m_zeros.data() : row - image_row_size};
+            sel::impl::png::unfilter_row(static_cast<Filter>(filter), m_filtered.data() + 1u, row, previous, size.row_size, m_bytes_per_pixel);
+        }
+        else {
+            std::uint8_t* const row {m_pass_rows.data() + (m_row % 2u) * image_row_size};
+            const std::uint8_t* const previous {m_row == 0u ? m_zeros.data() : m_pass_rows.data() + ((m_row + 1u) % 2u) * image_row_size};
+            sel::impl::png::unfilter_row(static_cast<Filter>(filter), m_filtered.data() + 1u, row, previous, size.row_size, m_bytes_per_pixel);
+
+            const Pass& pass {m_passes[m_pass]};
+            const std::size_t image_y {pass.y + std::size_t {m_row} * pass.y_step};
+            deinterlace_row(row, m_image.pixels.data() + image_y * image_row_size, pass, size.width, m_bits_per_pixel);
+        }
+
+        ++m_row;
+        if(m_row == size.height) {
+            ++m_pass;
+            next_pass();
+        }
+        return Error::none;
+    }
+
+    // a pass without pixels has no rows at all, not even their filter byte
+    void Image_data_decoder::next_pass() noexcept
+    {
+        while(m_pass < m_passes.size() and (m_pass_sizes[m_pass].width == 0u or m_pass_sizes[m_pass].height == 0u)) { ++m_pass; }
+        m_row = 0u;
+    }
+
+    // where the data of an IDAT chunk is and where the chunk starts
+    struct Image_data_chunk {
+        std::span<const std::uint8_t> data;
+        std::size_t offset {0u};
+    };
+}
+
+sel::Png_image sel::decode_png(std::span<const std::uint8_t> png_data)
+{
+    return impl::png::decode(png_data).value();
+}
+
+sel::Expected<sel::Png_image> sel::try_decode_png(std::span<const std::uint8_t> png_data) noexcept
+{
+    try {
+        return impl::png::decode(png_data);
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
+
+void sel::impl::png::unfilter_row(const Filter filter, const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size, const std::uint32_t bytes_per_pixel) noexcept
+{
+    static const Unfilter_function function {choose_unfilter_function()};
+    function(filter, filtered, row, previous, size, bytes_per_pixel);
+}
+
+sel::Expected<sel::Png_image> sel::impl::png::decode(std::span<const std::uint8_t> png_data)
+{
+    const auto error_at = [](const Error error, const std::size_t position) { return Decode_error {error, position * 8u}; };
+    const auto eof = [&] { return error_at(Error::unexpected_eof, png_data.size()); };
+
+    if(png_data.size() < signature.size()) return eof();
+    if(not std::equal(signature.begin(), signature.end(), png_data.begin())) return error_at(Error::bad_formed_data, 0u);
+
+    /* the chunks are all walked first: the IDAT chunks are only found, and their total size bounds the size
+    * of the image before anything is allocated for it */
+    Png_image image;
+    bool header_read {false};
+    std::vector<Image_data_chunk> image_data_chunks;
+    std::size_t image_data_size {0u};
+    std::size_t position {signature.size()};
+    // some encoders leave out IEND, the data can end after any chunk
+    while(position < png_data.size()) {
+        // length, type, data, CRC
+        if(png_data.size() - position < 12u) return eof();
+        Bytestream chunk_header {png_data.subspan(position, 8u)};
+        const std::uint32_t length {chunk_header.get_from_big_endian<std::uint32_t>()};
+        const std::uint32_t type {chunk_header.get_from_big_endian<std::uint32_t>()};
+        if(length > max_chunk_size) return error_at(Error::bad_formed_data, position);
+        if(png_data.size() - position - 12u < length) return eof();
+        const std::span<const std::uint8_t> data {png_data.subspan(position + 8u, length)};
+
+        if(not header_read and type != chunk_type("IHDR")) return error_at(Error::bad_formed_data, position);
+
+        // the CRC covers the type and the data, it's only checked for the chunks that are read
+        const bool known {type == chunk_type("IHDR") or type == chunk_type("PLTE") or type == chunk_type("tRNS") or type == chunk_type("IDAT") or type == chunk_type("IEND")};
+        if(not known and is_critical(type)) return error_at(Error::unsupported, position);
+        if(known) {
+            Bytestream crc {png_data.subspan(position + 8u + length, 4u)};
+            if(crc.get_from_big_endian<std::uint32_t>() != crc32(png_data.subspan(position + 4u, 4u + length))) return error_at(Error::checksum_mismatch, position);
+        }
+
+        if(type == chunk_type("IHDR")) {
+            if(header_read or length != 13u) return error_at(Error::bad_formed_data, position);
+            Bytestream fields {data};
+            image.width = fields.get_from_big_endian<std::uint32_t>();
+            image.height = fields.get_from_big_endian<std::uint32_t>();
+            image.bit_depth = fields.get_from_big_endian<std::uint8_t>();
+            image.color_type = fields.get_from_big_endian<std::uint8_t>();
+            const std::uint8_t compression_method {fields.get_from_big_endian<std::uint8_t>()};
+            const std::uint8_t filter_method {fields.get_from_big_endian<std::uint8_t>()};
+            const std::uint8_t interlace_method {fields.get_from_big_endian<std::uint8_t>()};
+
+            // the bit depths that each color type allows
+            const std::uint32_t depth {image.bit_depth};
+            const bool valid_depth {depth == 1u or depth == 2u or depth == 4u or depth == 8u or depth == 16u};
+            bool valid_combination {false};
+            switch(image.color_type) {
+            case 0u: valid_combination = valid_depth; break;
+            case 3u: valid_combination = valid_depth and depth != 16u; break;
+            case 2u: case 4u: case 6u: valid_combination = depth == 8u or depth == 16u; break;
+            default: break;
+            }
+            if(image.width == 0u or image.width > max_dimension or image.height == 0u or image.height > max_dimension or not valid_combination or
+                compression_method != 0u or filter_method != 0u or interlace_method > 1u) {
+                return error_at(Error::bad_formed_data, position);
+            }
+            image.interlaced = interlace_method == 1u;
+            header_read = true;
+        }
+        else if(type == chunk_type("PLTE")) {
+            if(length % 3u != 0u or length > 256u * 3u) return error_at(Error::bad_formed_data, position);
+            image.palette.assign(data.begin(), data.end());
+        }
+        else if(type == chunk_type("tRNS")) { image.transparency.assign(data.begin(), data.end()); }
+        else if(type == chunk_type("IDAT")) {
+            image_data_chunks.push_back(Image_data_chunk {data, position});
+            image_data_size += length;
+        }
+
+        position += 12u + length;
+        if(type == chunk_type("IEND")) break;
+    }
+    if(not header_read or image_data_chunks.empty()) return eof();
+    if(image.color_type == 3u and image.palette.empty()) return error_at(Error::bad_formed_data, signature.size());
+
+    // the reduced images, which hold more data than the IDAT chunks could inflate to if the file is truncated
+    const std::span<const Pass> passes {image.interlaced ? std::span<const Pass> {adam7_passes} : std::span<const Pass> {no_passes}};
+    std::array<Pass_size, adam7_passes.size()> pass_sizes {};
+    const std::uint32_t bits_per_pixel {image.channels() * image.bit_depth};
+    const std::size_t max_filtered_size {image_data_size * impl::deflate::max_deflate_ratio};
+    std::size_t filtered_size {0u};
+    for(std::size_t i = 0u; i < passes.size(); ++i) {
+        const Pass& pass {passes[i]};
+        Pass_size& size {pass_sizes[i]};
+        size.width = image.width > pass.x ? (image.width - pass.x + pass.x_step - 1u) / pass.x_step : 0u;
+        size.height = image.height > pass.y ? (image.height - pass.y + pass.y_step - 1u) / pass.y_step : 0u;
+        if(size.width == 0u or size.height == 0u) continue;
+
+        size.row_size = (std::size_t {size.width} * bits_per_pixel + 7u) / 8u;
+        if(size.row_size + 1u > (max_filtered_size - filtered_size) / size.height) return eof();
+        filtered_size += (size.row_size + 1u) * size.height;
+    }
+
+    image.pixels.resize(image.row_size() * image.height);
+    Image_data_decoder decoder {image, passes, std::span<const Pass_size> {pass_sizes.data(), passes.size()}};
+    for(const Image_data_chunk& chunk : image_data_chunks) {
+        const Error error {decoder.feed(chunk.data)};
+        if(error != Error::none) return error_at(error, chunk.offset);
+    }
+    const Error error {decoder.finish()};
+    if(error != Error::none) return error_at(error, image_data_chunks.back().offset);
+
+    return image;
+}
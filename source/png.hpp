@@ -0,0 +1,56 @@
+#pragma once
+
+#include "shared.hpp"
+
+#include <vector>
+
+namespace sel {
+    struct Png_image {
+        std::uint32_t width {0u};
+        std::uint32_t height {0u};
+        std::uint8_t bit_depth {0u}; // of a sample: 1, 2, 4, 8 or 16
+        std::uint8_t color_type {0u}; // 0: gray, 2: RGB, 3: palette, 4: gray and alpha, 6: RGBA
+        bool interlaced {false};
+        // the PLTE chunk as RGB triples, can be empty
+        std::vector<std::uint8_t> palette;
+        // the tRNS chunk as it is: alpha by palette index, or the transparent gray or RGB as 16 bits samples
+        std::vector<std::uint8_t> transparency;
+        /* the rows without their filter byte, 'row_size()' bytes each, even if the image is interlaced. The
+        * samples are as in the file: 16 bits ones in big-endian, the ones of less than 8 bits packed from the
+        * most significant bit, a row padded to a whole byte */
+        std::vector<std::uint8_t> pixels;
+
+        std::uint32_t channels() const noexcept
+        {
+            return color_type == 2u ? 3u : color_type == 4u ? 2u : color_type == 6u ? 4u : 1u;
+        }
+
+        std::size_t row_size() const noexcept
+        {
+            return (std::size_t {width} * channels() * bit_depth + 7u) / 8u;
+        }
+    };
+
+    /* decodes a PNG to its samples, without converting them. The IDAT chunks are inflated where they are, one
+    * row at a time, and each row is unfiltered as soon as it's complete, so besides the image, the memory is
+    * two rows and the history of the inflater */
+    Png_image decode_png(std::span<const std::uint8_t> png_data);
+    /* the same without exceptions, see try_decompress_deflate. The offset of an error in the image data is
+    * the one of the IDAT chunk where it was found */
+    Expected<Png_image> try_decode_png(std::span<const std::uint8_t> png_data) noexcept;
+}
+
+namespace sel::impl::png {
+    // the four bytes integers of PNG go up to 2^31 - 1
+    constexpr std::uint32_t max_dimension {0x7FFFFFFFu};
+    // the data of a chunk can't be longer either
+    constexpr std::uint32_t max_chunk_size {0x7FFFFFFFu};
+
+    enum class Filter : std::uint8_t { none, sub, up, average, paeth };
+
+    /* 'row' is 'filtered' without the filter, 'previous' is the row above (unfiltered, all zeros for the first
+    * row of an image or of a pass), 'bytes_per_pixel' rounds up to 1 below 8 bits per pixel */
+    void unfilter_row(const Filter filter, const std::uint8_t* filtered, std::uint8_t* row, const std::uint8_t* previous, const std::size_t size, const std::uint32_t bytes_per_pixel) noexcept;
+
+    Expected<Png_image> decode(std::span<const std::uint8_t> png_data);
+}
@@ -1,6 +1,10 @@
 #include "shared.hpp"
 #include <sstream>
 
+#if defined(SELEBITS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 sel::Exception::Exception(Error error, std::source_location sl)
     : m_error {error}, m_source_location {sl}
 {
@@ -14,6 +18,36 @@ sel::Exception::Exception(Error error, std::source_location sl)
     m_message = ostr.str();
 }
 
+const sel::impl::Cpu_features& sel::impl::cpu_features() noexcept
+{
+    static const Cpu_features features {[] {
+        Cpu_features result;
+#if defined(SELEBITS_X86) && defined(_MSC_VER)
+        int registers[4];
+        __cpuid(registers, 0);
+        const int highest_leaf {registers[0]};
+
+        __cpuid(registers, 1);
+        result.ssse3 = (registers[2] & (1 << 9)) != 0;
+        result.pclmul = (registers[2] & (1 << 1)) != 0;
+        // AVX2 also needs the OS to save the YMM registers (OSXSAVE and XCR0)
+        const bool os_saves_ymm {(registers[2] & (1 << 27)) != 0 and (_xgetbv(0) & 0x6u) == 0x6u};
+        if(highest_leaf >= 7 and os_saves_ymm) {
+            __cpuidex(registers, 7, 0);
+            result.avx2 = (registers[1] & (1 << 5)) != 0;
+        }
+#elif defined(SELEBITS_X86)
+        __builtin_cpu_init();
+        result.ssse3 = __builtin_cpu_supports("ssse3");
+        result.avx2 = __builtin_cpu_supports("avx2");
+        result.pclmul = __builtin_cpu_supports("pclmul");
+#endif
+        return result;
+    }()};
+
+    return features;
+}
+
 std::span<const std::uint8_t> sel::impl::Bytestream::get_bytes(const std::size_t amount)
 {
     if(m_current_byte_index > (m_source.size() - 1u)) {
@@ -30,117 +64,55 @@ std::span<const std::uint8_t> sel::impl::Bytestream::get_bytes(const std::size_t
 }
 
 template<sel::impl::Bitstream_format format>
-std::uint32_t sel::impl::Bitstream<format>::read_bits(const std::uint32_t amount)
+void sel::impl::Bitstream<format>::refill_byte_by_byte() noexcept
 {
-    if(amount == 0u) return 0u;
-
-    std::uint32_t bits_taken {0u};
-    std::uint32_t result {0u};
-
-    while(bits_taken < amount) {
-        if(m_useful_bits_in_current_byte == 0u) {
-            // go to the next byte
-            ++m_current_byte_index;
-            if(m_current_byte_index > (m_source.size() - 1u)) {
-                throw Exception {Error::unexpected_eof};
-            }
-            m_useful_bits_in_current_byte = 8u;
-        }
-
-        std::uint32_t bits_to_take {amount - bits_taken};
-        if(bits_to_take > m_useful_bits_in_current_byte) { bits_to_take = m_useful_bits_in_current_byte; }
-
-        // to move outside/discard the bits that are not useful anymore
-        const std::uint32_t discard_rotation {8u - m_useful_bits_in_current_byte};
-
+    while(m_bits_in_buffer < 56u and m_current_byte_index < m_source.size()) {
+        const std::uint64_t byte {m_source[m_current_byte_index]};
         if constexpr(format == Bitstream_format::gif) {
-            const std::uint32_t mask {(1u << bits_to_take) - 1u};
-            std::uint32_t temp {(m_source[m_current_byte_index] >> discard_rotation) & mask};
-            temp <<= bits_taken;
-            result |= temp;    
+            m_bit_buffer |= byte << m_bits_in_buffer;
         }
         else {
-            const std::uint32_t mask {0xFFu << (8u - bits_to_take)};
-            std::uint32_t temp {(m_source[m_current_byte_index] << discard_rotation) & mask};
-            temp >>= (8u - bits_to_take);
-            result = (result << bits_taken) | temp;
+            m_bit_buffer |= byte << (56u - m_bits_in_buffer);
         }
 
-        // book-keep
-        bits_taken += bits_to_take;
-        m_useful_bits_in_current_byte -= bits_to_take;
+        ++m_current_byte_index;
+        m_bits_in_buffer += 8u;
     }
-
-    return result;
 }
 
 template<sel::impl::Bitstream_format format>
-std::uint32_t sel::impl::Bitstream<format>::peek_bits(const std::uint32_t amount)
+void sel::impl::Bitstream<format>::skip_until_next_byte_boundary() noexcept
 {
-    const std::size_t copy1 {m_current_byte_index};
-    const std::uint32_t copy2 {m_useful_bits_in_current_byte};
-
-    const std::uint32_t result {read_bits(amount)};
-    m_current_byte_index = copy1;
-    m_useful_bits_in_current_byte = copy2;
-
-    return result;
+    // the buffer always starts at a byte boundary of the source
+    consume_bits(m_bits_in_buffer % 8u);
 }
 
 template<sel::impl::Bitstream_format format>
-void sel::impl::Bitstream<format>::skip_bits(const std::uint32_t amount)
+std::size_t sel::impl::Bitstream<format>::bits_left() const noexcept
 {
-    if(amount == 0u) return;
-
-    std::uint32_t bits_skipped {0};
-    while(bits_skipped < amount) {
-        if(m_useful_bits_in_current_byte == 0u) {
-            // go to the next byte
-            ++m_current_byte_index;
-            if(m_current_byte_index > (m_source.size() - 1u)) {
-                throw Exception {Error::unexpected_eof};
-            }
-            m_useful_bits_in_current_byte = 8u;
-        }
-
-        std::uint32_t bits_to_skip {amount - bits_skipped};
-        if(bits_to_skip > m_useful_bits_in_current_byte) { bits_to_skip = m_useful_bits_in_current_byte; }
-
-        // book-keep
-        bits_skipped += bits_to_skip;
-        m_useful_bits_in_current_byte -= bits_to_skip;
-    }
-}
-
-template<sel::impl::Bitstream_format format>
-void sel::impl::Bitstream<format>::skip_until_next_byte_boundary()
-{
-    if(m_useful_bits_in_current_byte == 8u) return;
-    
-    ++m_current_byte_index;
-    if(m_current_byte_index > (m_source.size() - 1u)) {
-        throw Exception {Error::unexpected_eof};
-    }
-    m_useful_bits_in_current_byte = 8u;
+    return (m_source.size() - m_current_byte_index) * 8u + m_bits_in_buffer;
 }
 
 template<sel::impl::Bitstream_format format>
 std::span<const std::uint8_t> sel::impl::Bitstream<format>::read_bytes(const std::uint32_t amount)
 {
-    if(amount == 0u) return {};
+    if(amount == 0u) {
+        skip_until_next_byte_boundary();
+        return {};
+    }
 
-    if(m_current_byte_index + amount > m_source.size()) {
+    // give back the whole bytes that are in the buffer
+    const std::size_t byte_index {m_current_byte_index - m_bits_in_buffer / 8u};
+    if(byte_index + amount > m_source.size()) {
         throw Exception {Error::unexpected_eof};
     }
 
-    std::span<const std::uint8_t> result {m_source.begin() + m_current_byte_index, amount};
+    std::span<const std::uint8_t> result {m_source.begin() + byte_index, amount};
 
     // book-keeping
-    m_current_byte_index += amount;
-    if(m_current_byte_index == m_source.size()) {
-        m_useful_bits_in_current_byte = 0u;
-    }
-    else { m_useful_bits_in_current_byte = 8u; }
+    m_current_byte_index = byte_index + amount;
+    m_bit_buffer = 0u;
+    m_bits_in_buffer = 0u;
 
     return result;
 }
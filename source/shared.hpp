@@ -6,16 +6,34 @@
 #include <source_location>
 #include <type_traits>
 #include <concepts>
+#include <utility>
 #include <span>
 #include <bit>
 #include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SELEBITS_X86
+#endif
+
+// functions that use instructions beyond the baseline of the target, MSVC doesn't need it
+#if defined(__GNUC__) || defined(__clang__)
+#define SELEBITS_TARGET(features) __attribute__((target(features)))
+#else
+#define SELEBITS_TARGET(features)
+#endif
 
 namespace sel {
     enum class Error {
         none,
         bug,
         bad_formed_data,
-        unexpected_eof
+        unexpected_eof,
+        checksum_mismatch,
+        output_too_small,
+        unsupported, // well formed data that needs a feature this library doesn't have
+        cant_read_file, // it couldn't be opened or read, see Input_file
+        out_of_memory // only reported by the functions that don't throw, the others let std::bad_alloc through
     };
 
     class Exception : public std::exception {
@@ -30,9 +48,58 @@ namespace sel {
         std::source_location m_source_location;
         Error m_error;
     };
+
+    // where a decoding that doesn't throw failed
+    struct Decode_error {
+        Error error {Error::none};
+        std::size_t bit_offset {0u}; // in the input, where the decoder was when it found the error
+    };
+
+    /* the result of the functions that report errors instead of throwing them, like C++23's std::expected:
+    * a value, or the Decode_error that prevented it */
+    template<typename T>
+    class Expected {
+    public:
+        Expected(T value) noexcept(std::is_nothrow_move_constructible_v<T>) : m_value {std::move(value)} {}
+        Expected(const Decode_error error) noexcept : m_error {error} {}
+
+        bool has_value() const noexcept { return m_error.error == Error::none; }
+        explicit operator bool() const noexcept { return has_value(); }
+
+        // throws the error as an Exception if there is no value
+        T& value() &
+        {
+            if(not has_value()) throw Exception {m_error.error};
+            return m_value;
+        }
+        T&& value() &&
+        {
+            if(not has_value()) throw Exception {m_error.error};
+            return std::move(m_value);
+        }
+
+        // without checking
+        T& operator*() noexcept { return m_value; }
+        const T& operator*() const noexcept { return m_value; }
+        T* operator->() noexcept { return &m_value; }
+        const T* operator->() const noexcept { return &m_value; }
+        const Decode_error& error() const noexcept { return m_error; }
+    private:
+        T m_value {};
+        Decode_error m_error;
+    };
 }
 
 namespace sel::impl {
+    // what the CPU that runs the program supports, to choose between implementations at runtime
+    struct Cpu_features {
+        bool ssse3 {false};
+        bool avx2 {false};
+        bool pclmul {false};
+    };
+
+    const Cpu_features& cpu_features() noexcept;
+
     template<std::integral T>
     constexpr T byteswap(const T value) noexcept
     {
@@ -139,23 +206,123 @@ namespace sel::impl {
         jpg // byte 0: aaaaaaaa (98765432), byte 1: aabbbbbb (10543210)
     };
 
+    /* the bits are kept in a 64 bits buffer that is refilled 8 bytes at a time, near the end of the source
+    * the buffer is refilled byte by byte. For gif, the next bit is the less significant bit of the buffer,
+    * for jpg, it's the most significant bit. The bits of the buffer beyond the buffered ones are either
+    * zero or the bits that follow in the source, so they never have to be cleared */
     template<Bitstream_format format>
     class Bitstream {
     public:
         Bitstream(std::span<const std::uint8_t> source) noexcept : m_source {source} {}
 
         std::uint32_t read_bits(const std::uint32_t amount);
-        std::uint32_t peek_bits(const std::uint32_t amount);
+        // the same without throwing: false, with nothing read, if the bit-stream doesn't have enough bits
+        bool try_read_bits(const std::uint32_t amount, std::uint32_t& bits) noexcept;
+        // the bits past the end of the source are peeked as zeros
+        std::uint32_t peek_bits(const std::uint32_t amount) noexcept;
         void skip_bits(const std::uint32_t amount);
-        void skip_until_next_byte_boundary();
+        void skip_until_next_byte_boundary() noexcept;
+        std::size_t bits_left() const noexcept;
 
+        // reading bytes starts at the next byte boundary
         std::span<const std::uint8_t> read_bytes(const std::uint32_t amount);
+
+        /* for hot loops: after refill(), at least 56 bits are buffered unless the source is about to end,
+        * consume_bits doesn't check that there are enough buffered bits */
+        void refill() noexcept;
+        std::uint32_t buffered_bits() const noexcept { return m_bits_in_buffer; }
+        void consume_bits(const std::uint32_t amount) noexcept;
     private:
-        // [verb]_bits_FORMAT
-        //std::uint32_t read_bits_lsbit(const std::uint32_t amount);
+        void refill_byte_by_byte() noexcept;
 
         std::span<const std::uint8_t> m_source;
-        std::size_t m_current_byte_index {0u};
-        std::uint32_t m_useful_bits_in_current_byte {8u};
+        std::size_t m_current_byte_index {0u}; // the next byte to go into the buffer
+        std::uint64_t m_bit_buffer {0u};
+        std::uint32_t m_bits_in_buffer {0u};
     };
-}
+
+    template<Bitstream_format format>
+    inline void Bitstream<format>::refill() noexcept
+    {
+        if(m_source.size() - m_current_byte_index < 8u) {
+            refill_byte_by_byte();
+            return;
+        }
+
+        std::uint64_t word;
+        std::memcpy(&word, m_source.data() + m_current_byte_index, sizeof(word));
+        if constexpr(format == Bitstream_format::gif) {
+            if constexpr(std::endian::native != std::endian::little) { word = byteswap(word); }
+            m_bit_buffer |= word << m_bits_in_buffer;
+        }
+        else {
+            if constexpr(std::endian::native != std::endian::big) { word = byteswap(word); }
+            m_bit_buffer |= word >> m_bits_in_buffer;
+        }
+
+        // only whole bytes are accounted, the bits of the last partial byte are loaded again next time
+        m_current_byte_index += (63u - m_bits_in_buffer) >> 3u;
+        m_bits_in_buffer |= 56u;
+    }
+
+    template<Bitstream_format format>
+    inline void Bitstream<format>::consume_bits(const std::uint32_t amount) noexcept
+    {
+        if constexpr(format == Bitstream_format::gif) { m_bit_buffer >>= amount; }
+        else { m_bit_buffer <<= amount; }
+        m_bits_in_buffer -= amount;
+    }
+
+    template<Bitstream_format format>
+    inline std::uint32_t Bitstream<format>::peek_bits(const std::uint32_t amount) noexcept
+    {
+        if(m_bits_in_buffer < amount) { refill(); }
+
+        if constexpr(format == Bitstream_format::gif) {
+            return static_cast<std::uint32_t>(m_bit_buffer & ((std::uint64_t {1u} << amount) - 1u));
+        }
+        else {
+            if(amount == 0u) return 0u;
+            return static_cast<std::uint32_t>(m_bit_buffer >> (64u - amount));
+        }
+    }
+
+    template<Bitstream_format format>
+    inline void Bitstream<format>::skip_bits(const std::uint32_t amount)
+    {
+        if(m_bits_in_buffer >= amount) {
+            consume_bits(amount);
+            return;
+        }
+
+        std::uint32_t bits_to_skip {amount};
+        while(bits_to_skip != 0u) {
+            refill();
+            if(m_bits_in_buffer == 0u) throw Exception {Error::unexpected_eof};
+
+            const std::uint32_t bits {std::min({bits_to_skip, m_bits_in_buffer, 32u})};
+            consume_bits(bits);
+            bits_to_skip -= bits;
+        }
+    }
+
+    template<Bitstream_format format>
+    inline bool Bitstream<format>::try_read_bits(const std::uint32_t amount, std::uint32_t& bits) noexcept
+    {
+        bits = peek_bits(amount);
+        if(m_bits_in_buffer < amount) return false;
+        consume_bits(amount);
+
+        return true;
+    }
+
+    template<Bitstream_format format>
+    inline std::uint32_t Bitstream<format>::read_bits(const std::uint32_t amount)
+    {
+        const std::uint32_t result {peek_bits(amount)};
+        if(m_bits_in_buffer < amount) throw Exception {Error::unexpected_eof};
+        consume_bits(amount);
+
+        return result;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "deflate.hpp"
+
+#ifdef SELEBITS_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <chrono>
+#endif
+
+namespace sel::impl {
+    // the time-stamp counter on x86, which counts at a constant rate close to the nominal frequency, nanoseconds elsewhere
+    inline std::uint64_t read_cycle_counter() noexcept
+    {
+#ifdef SELEBITS_X86
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+}
+
+namespace sel::impl::deflate {
+    // the one of set_inflate_statistics_callback, if there is one
+    bool has_statistics_callback() noexcept;
+    void report_statistics(const Inflate_statistics& statistics);
+}
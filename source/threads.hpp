@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <exception>
+
+namespace sel::impl {
+    // 0 means as many threads as the hardware runs concurrently
+    inline std::uint32_t resolve_thread_count(const std::uint32_t threads) noexcept
+    {
+        return threads != 0u ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    /* calls function(worker, i) for every i in [0, count) from 'threads' threads, which take the next i as
+    * they finish the previous one. The calling thread is worker 0. The first exception is rethrown once
+    * all the threads are done */
+    template<typename Function>
+    void for_each_in_parallel(const std::size_t count, const std::uint32_t threads, const Function& function)
+    {
+        std::vector<std::exception_ptr> exceptions(threads);
+        std::atomic<std::size_t> next {0u};
+        auto work {[&](const std::uint32_t worker) {
+            try {
+                for(std::size_t i = next.fetch_add(1u); i < count; i = next.fetch_add(1u)) { function(worker, i); }
+            }
+            catch(...) { exceptions[worker] = std::current_exception(); }
+        }};
+
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(threads - 1u);
+            for(std::uint32_t i = 1u; i < threads; ++i) { workers.emplace_back(work, i); }
+            work(0u);
+        }
+        for(const std::exception_ptr& exception : exceptions) {
+            if(exception) std::rethrow_exception(exception);
+        }
+    }
+}
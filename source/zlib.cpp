@@ -0,0 +1,138 @@
+#include "zlib.hpp"
+#include "adler32.hpp"
+#include "compressor.hpp"
+
+namespace {
+    // the most data whose Adler-32 is computed at once, it's still in the cache after being decompressed
+    constexpr std::size_t adler32_chunk_size {1u << 16u}; // 64KB
+}
+
+std::vector<std::uint8_t> sel::decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary)
+{
+    impl::deflate::Dynamic_tables tables;
+    return impl::zlib::decompress(zlib_data, dictionary, tables).value();
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::try_decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary) noexcept
+{
+    try {
+        impl::deflate::Dynamic_tables tables;
+        return impl::zlib::decompress(zlib_data, dictionary, tables);
+    }
+    catch(const std::bad_alloc&) {
+        return Decode_error {Error::out_of_memory};
+    }
+}
+
+sel::Expected<std::vector<std::uint8_t>> sel::impl::zlib::decompress(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary, deflate::Dynamic_tables& tables)
+{
+    if(zlib_data.size() < 2u) return Decode_error {Error::unexpected_eof, zlib_data.size() * 8u};
+    const std::uint8_t cmf {zlib_data[0]};
+    const std::uint8_t flg {zlib_data[1]};
+
+    // CM must be 8 (deflate) with a window (CINFO) of 32KB or less, and CMF-FLG must be a multiple of 31
+    if((cmf & 0x0Fu) != 8u or (cmf >> 4u) > 7u) return Decode_error {Error::bad_formed_data, 0u};
+    if(((cmf << 8u) | flg) % 31u != 0u) return Decode_error {Error::bad_formed_data, 8u};
+
+    std::size_t header_size {2u};
+    const bool fdict {(flg & 0x20u) != 0u};
+    if(fdict) {
+        if(zlib_data.size() < 6u) return Decode_error {Error::unexpected_eof, zlib_data.size() * 8u};
+        Bytestream bytestream {zlib_data.subspan(2u, 4u)};
+        const std::uint32_t dictid {bytestream.get_from_big_endian<std::uint32_t>()};
+        if(dictionary.empty() or adler32(dictionary) != dictid) return Decode_error {Error::bad_formed_data, 16u};
+        header_size += 4u;
+    }
+
+    /* with a dictionary, the first chunk is decompressed in a scratch buffer after the last 32KB of the
+    * dictionary, the history that its distances can reach. The distances after the first chunk only reach
+    * the decompressed data, so the chunk becomes the start of the output and the rest follows it there */
+    std::vector<std::uint8_t> inflated_data;
+    std::vector<std::uint8_t> first_chunk;
+    const std::size_t history_size {fdict ? std::min(dictionary.size(), deflate::window_size) : 0u};
+    deflate::Output_buffer output {.vector = history_size != 0u ? &first_chunk : &inflated_data};
+    output.reserve(history_size + 5000u); // 5KB
+    std::copy(dictionary.end() - history_size, dictionary.end(), output.data);
+    output.size = history_size;
+
+    deflate::Deflate_bitstream bitstream {zlib_data.subspan(header_size)};
+    // in the whole zlib stream
+    const auto error_here = [&](const Error error) { return Decode_error {error, zlib_data.size() * 8u - bitstream.bits_left()}; };
+
+    deflate::Inflate_state state;
+    std::uint32_t adler {1u};
+    while(state.step != deflate::Inflate_state::Step::done) {
+        // inflate stops with needs_output after a chunk, whose Adler-32 is computed while it's in the cache
+        output.reserve(adler32_chunk_size);
+        deflate::Output_buffer chunk {output.data, output.size, std::min(output.capacity, output.size + adler32_chunk_size)};
+        const deflate::Inflate_status status {deflate::inflate(state, tables, chunk, bitstream)};
+        if(status == deflate::Inflate_status::needs_input) return error_here(Error::unexpected_eof);
+        if(status == deflate::Inflate_status::bad_formed_data) return error_here(Error::bad_formed_data);
+        adler = adler32(std::span<const std::uint8_t> {chunk.data + output.size, chunk.size - output.size}, adler);
+        output.size = chunk.size;
+
+        if(output.vector == &first_chunk) {
+            inflated_data.assign(first_chunk.begin() + history_size, first_chunk.begin() + output.size);
+            output = {inflated_data.data(), inflated_data.size(), inflated_data.size(), &inflated_data};
+        }
+    }
+
+    // ADLER32 is in big-endian, after the deflate data
+    bitstream.skip_until_next_byte_boundary();
+    if(bitstream.bits_left() < 32u) return error_here(Error::unexpected_eof);
+    const Decode_error mismatch {error_here(Error::checksum_mismatch)};
+    Bytestream trailer {bitstream.read_bytes(4u)};
+    if(trailer.get_from_big_endian<std::uint32_t>() != adler) return mismatch;
+
+    inflated_data.resize(output.size);
+    return inflated_data;
+}
+
+namespace {
+    // deflate with a 32KB window, FLEVEL tells how hard the compressor tried (0: fastest, 3: slowest)
+    void write_zlib_header(std::vector<std::uint8_t>& output, const std::uint32_t level)
+    {
+        const std::uint32_t cmf {0x78u};
+        const std::uint32_t flevel {level < 2u ? 0u : level < 6u ? 1u : level == 6u ? 2u : 3u};
+        std::uint32_t flg {flevel << 6u};
+        flg += 31u - ((cmf << 8u) | flg) % 31u;
+        output.push_back(static_cast<std::uint8_t>(cmf));
+        output.push_back(static_cast<std::uint8_t>(flg));
+    }
+
+    // ADLER32 in big-endian
+    void write_zlib_trailer(std::vector<std::uint8_t>& output, const std::uint32_t adler)
+    {
+        for(std::uint32_t i = 0u; i < 4u; ++i) {
+            output.push_back(static_cast<std::uint8_t>(adler >> (24u - 8u * i)));
+        }
+    }
+}
+
+std::vector<std::uint8_t> sel::compress_zlib(std::span<const std::uint8_t> data, const std::uint32_t level)
+{
+    if(level > impl::compressor::max_level) throw Exception {Error::bug};
+
+    std::vector<std::uint8_t> compressed_data;
+    compressed_data.reserve(data.size() / 2u + 64u);
+    write_zlib_header(compressed_data, level);
+
+    impl::compressor::Bit_writer writer {compressed_data};
+    impl::compressor::compress(data, 0u, impl::compressor::level_parameters[level], true, writer);
+    writer.flush();
+
+    write_zlib_trailer(compressed_data, adler32(data));
+    return compressed_data;
+}
+
+std::vector<std::uint8_t> sel::compress_zlib_parallel(std::span<const std::uint8_t> data, const std::uint32_t level, const std::uint32_t threads)
+{
+    if(level > impl::compressor::max_level) throw Exception {Error::bug};
+
+    std::vector<std::uint8_t> compressed_data;
+    write_zlib_header(compressed_data, level);
+    // the Adler-32 of each chunk is computed by its thread and they are combined
+    const std::uint32_t adler {impl::compressor::compress_parallel(data, impl::compressor::level_parameters[level], threads, compressed_data)};
+    write_zlib_trailer(compressed_data, adler);
+    return compressed_data;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "shared.hpp"
+#include "deflate.hpp"
+
+#include <vector>
+
+namespace sel {
+    /* decompresses a zlib stream (RFC 1950): the header, the deflate data and the Adler-32 of the
+    * decompressed data, which is computed 64KB at a time while the data is still in the cache.
+    * 'dictionary' is only used by streams that have a preset dictionary (FDICT), it must be the
+    * one whose Adler-32 is in the header */
+    std::vector<std::uint8_t> decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary = {});
+    // the same without exceptions, see try_decompress_deflate. The offset of a checksum mismatch is the one of the Adler-32
+    Expected<std::vector<std::uint8_t>> try_decompress_zlib(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary = {}) noexcept;
+
+    // compresses 'data' into a zlib stream, 'level' is the same as in compress_deflate
+    std::vector<std::uint8_t> compress_zlib(std::span<const std::uint8_t> data, const std::uint32_t level = 6u);
+    // see compress_deflate_parallel
+    std::vector<std::uint8_t> compress_zlib_parallel(std::span<const std::uint8_t> data, const std::uint32_t level = 6u, const std::uint32_t threads = 0u);
+}
+
+namespace sel::impl::zlib {
+    Expected<std::vector<std::uint8_t>> decompress(std::span<const std::uint8_t> zlib_data, std::span<const std::uint8_t> dictionary, deflate::Dynamic_tables& tables);
+}